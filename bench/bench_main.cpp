@@ -0,0 +1,285 @@
+//
+// Created by Shaunik Musukula on 7/12/25.
+//
+
+#include "traffic_gen.h"
+#include "pcap_helpers.h"
+#include "rendering.h"
+#include "capture.h"
+#include "offline.h"
+#include "pcapng.h"
+#include "options.h"
+#include "state.h"
+#include "util.h"
+
+#include <getopt.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+
+static std::atomic<std::size_t> gAllocs{0};
+
+void* operator new(const std::size_t n) {
+    gAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept                     { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept        { std::free(p); }
+void* operator new[](const std::size_t n)                  { return operator new(n); }
+void operator delete[](void* p) noexcept                   { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept      { std::free(p); }
+
+namespace {
+    // Hardware cache-miss counter for the calling thread; reads -1 where
+    // perf_event_open isn't available (non-Linux, containers, paranoid kernels).
+    class CacheMissCounter {
+    public:
+        CacheMissCounter() {
+#ifdef __linux__
+            perf_event_attr attr{};
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof(attr);
+            attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+        ~CacheMissCounter() { if (fd_ >= 0) close(fd_); }
+
+        void start() const {
+#ifdef __linux__
+            if (fd_ < 0) return;
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        [[nodiscard]] long long stop() const {
+            if (fd_ < 0) return -1;
+            long long v = 0;
+#ifdef __linux__
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &v, sizeof(v)) != sizeof(v)) return -1;
+#endif
+            return v;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    struct Stage {
+        const char*                       name;
+        std::function<void(std::size_t)>  run;            // processes item i
+        const char*                       unit = "pkt";
+    };
+
+    void report(const Stage& s, const std::size_t n, const double ns, const std::size_t allocs,
+                const long long misses) {
+        const auto per = static_cast<double>(n);
+        std::printf("%-14s %10.1f ns/%-5s %8.3f allocs/%-5s", s.name, ns / per, s.unit,
+                    static_cast<double>(allocs) / per, s.unit);
+        if (misses >= 0) std::printf(" %8.3f misses/%s\n", static_cast<double>(misses) / per, s.unit);
+        else             std::printf(" %8s\n", "n/a");
+    }
+
+    void run_stage(const Stage& s, const std::size_t n, const int iters, const CacheMissCounter& cm) {
+        for (std::size_t i = 0; i < std::min<std::size_t>(n, 10'000); ++i) s.run(i);   // warm up
+
+        double      ns     = 0;
+        std::size_t allocs = 0;
+        long long   misses = 0;
+        for (int it = 0; it < iters; ++it) {
+            const std::size_t a0 = gAllocs.load(std::memory_order_relaxed);
+            cm.start();
+            const auto t0 = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < n; ++i) s.run(i);
+            const auto t1 = std::chrono::steady_clock::now();
+            const long long m = cm.stop();
+            allocs += gAllocs.load(std::memory_order_relaxed) - a0;
+            ns     += std::chrono::duration<double, std::nano>(t1 - t0).count();
+            misses  = (m < 0 || misses < 0) ? -1 : misses + m;
+        }
+        report(s, n * iters, ns, allocs, misses);
+    }
+
+    void usage(const char* prog) {
+        std::fprintf(stderr,
+                     "usage: %s [options]\n"
+                     "  --packets <n>        frames to generate (default 1000000)\n"
+                     "  --flows <n>          distinct flows (default 1024)\n"
+                     "  --size <dist>        fixed:<n>, uniform:<min>-<max> or imix (default)\n"
+                     "  --mix <t,u,i>        relative TCP,UDP,ICMP weights (default 6,3,1)\n"
+                     "  --ipv6 <share>       fraction of IPv6 flows (default 0.2)\n"
+                     "  --iters <n>          timed passes per stage (default 3)\n"
+                     "  --write <file>       also save the generated traffic as a pcap\n",
+                     prog);
+    }
+
+    void parse_size_dist(const char* s, TrafficSpec& spec) {
+        if (std::strcmp(s, "imix") == 0) { spec.sizes = SizeDist::kImix; return; }
+        if (std::sscanf(s, "fixed:%zu", &spec.min_size) == 1) { spec.sizes = SizeDist::kFixed; return; }
+        if (std::sscanf(s, "uniform:%zu-%zu", &spec.min_size, &spec.max_size) == 2 && spec.min_size <= spec.max_size) {
+            spec.sizes = SizeDist::kUniform;
+            return;
+        }
+        std::fprintf(stderr, "bad size distribution: %s\n", s);
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char** argv) {
+    TrafficSpec spec;
+    int         iters = 3;
+    const char* out   = nullptr;
+
+    enum { kPackets = 256, kFlows, kSize, kMix, kIpv6, kIters, kWrite };
+    static const option longopts[] = {
+        {"packets", required_argument, nullptr, kPackets},
+        {"flows",   required_argument, nullptr, kFlows},
+        {"size",    required_argument, nullptr, kSize},
+        {"mix",     required_argument, nullptr, kMix},
+        {"ipv6",    required_argument, nullptr, kIpv6},
+        {"iters",   required_argument, nullptr, kIters},
+        {"write",   required_argument, nullptr, kWrite},
+        {"help",    no_argument,       nullptr, 'h'},
+        {nullptr,   0,                 nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longopts, nullptr)) != -1) {
+        switch (opt) {
+            case kPackets: spec.packets    = std::strtoull(optarg, nullptr, 10); break;
+            case kFlows:   spec.flows      = std::strtoull(optarg, nullptr, 10); break;
+            case kSize:    parse_size_dist(optarg, spec);                        break;
+            case kMix:
+                if (std::sscanf(optarg, "%lf,%lf,%lf", &spec.tcp_share, &spec.udp_share, &spec.icmp_share) != 3) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case kIpv6:    spec.ipv6_share = std::strtod(optarg, nullptr);       break;
+            case kIters:   iters           = std::atoi(optarg);                  break;
+            case kWrite:   out             = optarg;                             break;
+            case 'h':      usage(argv[0]); return EXIT_SUCCESS;
+            default:       usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (spec.packets == 0 || iters < 1) { usage(argv[0]); return EXIT_FAILURE; }
+
+    const Traffic t = generate_traffic(spec);
+    const std::size_t n = t.hdrs.size();
+    std::printf("%zu frames, %zu flows, %.1f MB\n\n", n, spec.flows, static_cast<double>(t.bytes.size()) / (1 << 20));
+    if (out && !write_pcap(t, out)) std::fprintf(stderr, "couldn't write %s\n", out);
+
+    gShards.emplace_back(std::make_unique<CaptureShard>(gCfg.payload_mem, DUMP_RING_BYTES,
+                                                     gCfg.flow_slots, gCfg.flow_timeout, gCfg.reasm_bytes,
+                                                     gCfg.dns_slots, gCfg.dns_timeout,
+                                                     gCfg.sketch_width, gCfg.hll_bits));
+    CaptureShard& shard = *gShards.front();
+    auto*         user  = reinterpret_cast<std::uint8_t* >(&shard);
+
+    // the writer thread drains into /dev/null while the stages run
+    gWriter.configure("/dev/null", RotatePolicy{});
+    gWriter.start({&shard.dump}, {0}, {"bench"}, {DLT_EN10MB}, 65'535, false);
+
+    // pcapng blocks go to /dev/null too, compressed on the file's own thread;
+    // a compressor that falls behind shows up here as time spent waiting
+    PcapngFile               ng;
+    std::atomic<std::size_t> ng_written{0};
+    std::size_t              ng_raw = 0;
+    ng.open("/dev/null", {"bench"}, {DLT_EN10MB}, 65'535, false, COMPRESS_DEFAULT, &ng_written);
+
+    PacketRecord      rec{};
+    Decoded           dec;
+    const std::uint8_t* dec_pkt = nullptr;
+    std::size_t       sink = 0;
+    char              buf[64];
+    const CacheMissCounter cm;
+
+    const Stage stages[] = {
+        {"decode",      [&](std::size_t i) {
+            decode_packet(&t.hdrs[i], t.frame(i), DLT_EN10MB, rec, dec);
+            dec_pkt = t.frame(i);
+            sink   += dec.pl_off;
+        }},
+        {"bookkeeping", [&](std::size_t i) {
+            shard.cnt.count(rec.proto, rec.len);
+            shard.flows.update(rec, dec, dec_pkt, ts_to_ns(rec.ts, false));
+            shard.sketch.add(rec);
+            PacketRecord r = rec;
+            shard.queue.push(std::move(r));
+            if (i % OFFLINE_DRAIN_EVERY == 0) drain_captured();
+        }},
+        {"dump",        [&](std::size_t i) { shard.dump.push(&t.hdrs[i], t.frame(i)); }},
+        {"pcapng",      [&](std::size_t i) {
+            const pcap_pkthdr&  h      = t.hdrs[i];
+            const std::uint32_t r[4]   = {static_cast<std::uint32_t>(h.ts.tv_sec), static_cast<std::uint32_t>(h.ts.tv_usec),
+                                          h.caplen, h.len};
+            ng.add(0, r, t.frame(i), h.caplen, nullptr, 0);
+            ng_raw += 32 + ((h.caplen + 3) & ~3u);
+        }},
+        {"packet_cb",   [&](std::size_t i) {
+            packet_cb(user, &t.hdrs[i], t.frame(i));
+            if (i % OFFLINE_DRAIN_EVERY == 0) drain_captured();
+        }},
+        {"format_row",  [&](std::size_t i) {
+            decode_packet(&t.hdrs[i], t.frame(i), DLT_EN10MB, rec, dec);
+            format_ts(rec.ts, false, buf, sizeof(buf));
+            format_addr(rec.family, rec.src, buf, sizeof(buf));
+            format_addr(rec.family, rec.dst, buf, sizeof(buf));
+            sink += static_cast<std::size_t>(buf[0]);
+        }},
+        {"human_bytes", [&](std::size_t i) { sink += human_bytes(t.hdrs[i].len * i).size(); }},
+    };
+
+    std::printf("%-14s %18s %20s %15s\n", "stage", "time", "allocations", "cache misses");
+    for (const auto& s : stages) run_stage(s, n, iters, cm);
+    ng.close();
+    std::printf("%-14s %s of packet blocks written as %s (%.1fx)\n", "", human_bytes(ng_raw).c_str(),
+                human_bytes(ng_written.load()).c_str(),
+                static_cast<double>(ng_raw) / static_cast<double>(std::max<std::size_t>(ng_written.load(), 1)));
+
+    // Rendering is per frame, not per packet; it is timed against a terminal
+    // that writes to /dev/null with the history filled from the run above.
+    if (FILE* devnull = std::fopen("/dev/null", "w")) {
+        setenv("TERM", "xterm", 0);
+        if (SCREEN* scr = newterm(nullptr, devnull, stdin)) {
+            set_term(scr);
+            gCfg.read_file = "<synthetic>";
+            init_windows(50, 160);
+            gShowHex = true;
+            const Stage render{"refresh_render", [](std::size_t) { refresh_render(); }, "frame"};
+            run_stage(render, 1'000, iters, cm);
+            // a live frame: a few new rows at the top, counters moved, hex follows the newest row
+            const Stage live{"render_live", [&](std::size_t i) {
+                for (std::size_t k = 0; k < 4; ++k) gRows.push(gRows.recent((i * 4 + k) % gRows.size()));
+                refresh_render(DAMAGE_STATS | DAMAGE_TABLE | DAMAGE_HEX);
+            }, "frame"};
+            run_stage(live, 1'000, iters, cm);
+            endwin();
+            delscreen(scr);
+        }
+        std::fclose(devnull);
+    }
+
+    gWriter.close();
+    std::printf("\n(sink %zu)\n", sink);
+    return 0;
+}
@@ -0,0 +1,156 @@
+//
+// Created by Shaunik Musukula on 7/12/25.
+//
+
+#include "traffic_gen.h"
+#include "net_types.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+    struct Flow {
+        bool          v6;
+        std::uint8_t  proto;
+        std::uint8_t  src[16];
+        std::uint8_t  dst[16];
+        std::uint16_t sport;
+        std::uint16_t dport;
+    };
+
+    // Simple IMIX: 7 x 64, 4 x 594, 1 x 1514.
+    std::size_t imix(std::mt19937& rng) {
+        const auto r = rng() % 12;
+        return r < 7 ? 64 : r < 11 ? 594 : 1'514;
+    }
+
+    void put16(std::uint8_t* p, const std::uint16_t v) { const auto n = htons(v); std::memcpy(p, &n, 2); }
+    void put32(std::uint8_t* p, const std::uint32_t v) { const auto n = htonl(v); std::memcpy(p, &n, 4); }
+
+    std::vector<Flow> make_flows(const TrafficSpec& spec, std::mt19937& rng) {
+        const double total = spec.tcp_share + spec.udp_share + spec.icmp_share;
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+
+        std::vector<Flow> flows(std::max<std::size_t>(spec.flows, 1));
+        for (auto& f : flows) {
+            f.v6 = u(rng) < spec.ipv6_share;
+            const double p = u(rng) * total;
+            f.proto = static_cast<std::uint8_t>(
+                      p < spec.tcp_share                  ? static_cast<int>(IPPROTO_TCP)
+                    : p < spec.tcp_share + spec.udp_share ? static_cast<int>(IPPROTO_UDP)
+                    : f.v6                                ? static_cast<int>(IPPROTO_ICMPV6)
+                                                          : static_cast<int>(IPPROTO_ICMP));
+            for (auto& b : f.src) b = static_cast<std::uint8_t>(rng());
+            for (auto& b : f.dst) b = static_cast<std::uint8_t>(rng());
+            f.sport = static_cast<std::uint16_t>(1'024 + rng() % 60'000);
+            f.dport = static_cast<std::uint16_t>(rng() % 4 == 0 ? 443 : 1 + rng() % 1'024);
+        }
+        return flows;
+    }
+
+    // Writes one frame of exactly `size` bytes (or the smallest valid size).
+    std::size_t build_frame(const Flow& f, std::size_t size, std::uint32_t seq, std::uint8_t* out) {
+        const std::size_t l3 = f.v6 ? 40 : 20;
+        const std::size_t l4 = f.proto == IPPROTO_TCP ? 20 : 8;
+        size = std::max(size, SIZE_ETHERNET + l3 + l4);
+        std::memset(out, 0, size);
+
+        put16(out + 12, f.v6 ? 0x86DD : 0x0800);
+        std::uint8_t* ip = out + SIZE_ETHERNET;
+        const auto    l3_len = static_cast<std::uint16_t>(size - SIZE_ETHERNET);
+        if (f.v6) {
+            ip[0] = 0x60;
+            put16(ip + 4, static_cast<std::uint16_t>(l3_len - 40));
+            ip[6] = f.proto;
+            ip[7] = 64;
+            std::memcpy(ip + 8,  f.src, 16);
+            std::memcpy(ip + 24, f.dst, 16);
+        } else {
+            ip[0] = 0x45;
+            put16(ip + 2, l3_len);
+            put16(ip + 4, static_cast<std::uint16_t>(seq));
+            ip[8] = 64;
+            ip[9] = f.proto;
+            std::memcpy(ip + 12, f.src, 4);
+            std::memcpy(ip + 16, f.dst, 4);
+        }
+
+        std::uint8_t* th = ip + l3;
+        if (f.proto == IPPROTO_TCP || f.proto == IPPROTO_UDP) {
+            put16(th,     f.sport);
+            put16(th + 2, f.dport);
+        }
+        if (f.proto == IPPROTO_TCP) {
+            put32(th + 4, seq * 1'448);
+            th[12] = 5 << 4;
+            th[13] = TH_ACK | TH_PUSH;
+            put16(th + 14, 65'535);
+        } else if (f.proto == IPPROTO_UDP) {
+            put16(th + 4, static_cast<std::uint16_t>(size - SIZE_ETHERNET - l3));
+        } else {
+            th[0] = f.v6 ? 128 : 8;   // echo request
+        }
+        return size;
+    }
+}
+
+Traffic generate_traffic(const TrafficSpec& spec) {
+    std::mt19937 rng(spec.seed);
+    const auto   flows = make_flows(spec, rng);
+
+    Traffic t;
+    t.hdrs.reserve(spec.packets);
+    t.offs.reserve(spec.packets);
+    t.bytes.reserve(spec.packets * (spec.sizes == SizeDist::kFixed ? spec.min_size : 400));
+
+    timeval ts{1'700'000'000, 0};
+    std::uint8_t frame[9'000];
+    for (std::size_t i = 0; i < spec.packets; ++i) {
+        std::size_t size = spec.min_size;
+        if (spec.sizes == SizeDist::kUniform) size = spec.min_size + rng() % (spec.max_size - spec.min_size + 1);
+        if (spec.sizes == SizeDist::kImix)    size = imix(rng);
+        size = std::min(size, sizeof(frame));
+
+        const Flow&       f   = flows[rng() % flows.size()];
+        const std::size_t len = build_frame(f, size, static_cast<std::uint32_t>(i), frame);
+
+        ts.tv_usec += 1;
+        if (ts.tv_usec == 1'000'000) { ts.tv_usec = 0; ++ts.tv_sec; }
+
+        pcap_pkthdr h{};
+        h.ts     = ts;
+        h.caplen = static_cast<bpf_u_int32>(len);
+        h.len    = static_cast<bpf_u_int32>(len);
+        t.offs.push_back(t.bytes.size());
+        t.hdrs.push_back(h);
+        t.bytes.insert(t.bytes.end(), frame, frame + len);
+    }
+    return t;
+}
+
+bool write_pcap(const Traffic& t, const char* path) {
+    FILE* fp = std::fopen(path, "wb");
+    if (!fp) return false;
+
+    pcap_file_header fh{};
+    fh.magic         = 0xA1B2C3D4;
+    fh.version_major = 2;
+    fh.version_minor = 4;
+    fh.snaplen       = 65'535;
+    fh.linktype      = DLT_EN10MB;
+    std::fwrite(&fh, sizeof(fh), 1, fp);
+
+    for (std::size_t i = 0; i < t.hdrs.size(); ++i) {
+        const std::uint32_t rec[4] = {
+            static_cast<std::uint32_t>(t.hdrs[i].ts.tv_sec), static_cast<std::uint32_t>(t.hdrs[i].ts.tv_usec),
+            t.hdrs[i].caplen, t.hdrs[i].len,
+        };
+        std::fwrite(rec, sizeof(rec), 1, fp);
+        std::fwrite(t.frame(i), 1, t.hdrs[i].caplen, fp);
+    }
+    return std::fclose(fp) == 0;
+}
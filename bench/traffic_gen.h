@@ -0,0 +1,48 @@
+//
+// Created by Shaunik Musukula on 7/12/25.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+enum class SizeDist { kFixed, kUniform, kImix };
+
+// Shares are relative weights, they don't need to add up to one.
+struct TrafficSpec {
+    std::size_t   packets    = 1'000'000;
+    std::size_t   flows      = 1'024;
+    double        ipv6_share = 0.2;
+    double        tcp_share  = 0.6;
+    double        udp_share  = 0.3;
+    double        icmp_share = 0.1;
+    SizeDist      sizes      = SizeDist::kImix;
+    std::size_t   min_size   = 64;       // frame bytes; kFixed uses min_size
+    std::size_t   max_size   = 1'514;
+    std::uint32_t seed       = 1;
+};
+
+// All frames live back to back in `bytes`; hdrs[i] and offs[i] describe frame i.
+struct Traffic {
+    std::vector<std::uint8_t> bytes;
+    std::vector<pcap_pkthdr>  hdrs;
+    std::vector<std::size_t>  offs;
+
+    [[nodiscard]] const std::uint8_t* frame(const std::size_t i) const { return bytes.data() + offs[i]; }
+};
+
+Traffic generate_traffic(const TrafficSpec& spec);
+
+bool write_pcap(const Traffic& t, const char* path);
@@ -0,0 +1,55 @@
+//
+// Created by Shaunik Musukula on 7/8/25.
+//
+
+#pragma once
+
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr int CAPTURE_POLL_MS = 50;
+constexpr int CAPTURE_BUDGET  = 1'024;    // packets per handle per round of a capture thread
+
+void start_capture();
+
+void stop_capture();
+
+[[nodiscard]] bool capture_running();
+
+CounterTotals total_counters();
+
+// What the kernel reported for all shards; `valid` stays false until one of
+// them has read its counters (never for a file).
+struct KernelDrops {
+    std::uint64_t recv   = 0;
+    std::uint64_t drop   = 0;
+    std::uint64_t ifdrop = 0;
+    bool          valid  = false;
+};
+
+KernelDrops kernel_drops();
+
+// one captured interface's share of the above; `dev` indexes gCapDevs
+CounterTotals device_counters(std::size_t dev);
+KernelDrops   device_drops(std::size_t dev);
+
+// every shard's published top flows, merged and sorted; returns the number of active flows
+std::size_t top_flows(bool by_rate, std::vector<FlowEntry>& flows);
+
+// every shard's DNS matcher, resolvers merged by address
+DnsTotals dns_totals();
+
+enum class DetailState { kPending, kFound, kGone };
+
+// UI side: asks every shard about one flow. The capture threads answer on
+// their next packet or idle sweep, or the UI does while capture is stopped.
+void ask_flow_detail(const FlowKey& k);
+
+// The answer to the last ask from the shard that saw most of the flow; with
+// CPU/LB fanout the rest of it, even one direction, may be on other shards.
+DetailState flow_detail(FlowDetail& out);
+
+std::size_t drain_captured();
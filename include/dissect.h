@@ -0,0 +1,72 @@
+//
+// Created by Shaunik Musukula on 7/17/25.
+//
+
+#pragma once
+
+#include "packet_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <cstdint>
+
+constexpr int MAX_VLAN_TAGS   = 2;      // 802.1Q, or QinQ outer + inner
+constexpr int MAX_IP6_EXT_HDR = 8;
+
+constexpr std::uint16_t ETHERTYPE_IP4      = 0x0800;
+constexpr std::uint16_t ETHERTYPE_ARP      = 0x0806;
+constexpr std::uint16_t ETHERTYPE_VLAN     = 0x8100;
+constexpr std::uint16_t ETHERTYPE_IP6      = 0x86DD;
+constexpr std::uint16_t ETHERTYPE_QINQ     = 0x88A8;
+constexpr std::uint16_t ETHERTYPE_QINQ_OLD = 0x9100;
+
+// Decoded flags
+constexpr std::uint8_t DF_TRUNCATED  = 0x01;    // a header ran past caplen
+constexpr std::uint8_t DF_MALFORMED  = 0x02;    // a length or version field made no sense
+constexpr std::uint8_t DF_FRAGMENT   = 0x04;    // part of a fragmented datagram
+constexpr std::uint8_t DF_LATER_FRAG = 0x08;    // not the first fragment: no L4 header
+constexpr std::uint8_t DF_IP_OPTIONS = 0x10;    // IPv4 options or IPv6 extension headers present
+
+// Everything the rest of the packet path needs from the headers, as offsets
+// into the captured frame plus a few decoded fields. Filling it never copies
+// the packet or allocates.
+struct Decoded {
+    IpAddr        src;
+    IpAddr        dst;
+    std::uint32_t seq;
+    std::uint32_t ack;
+    std::uint32_t l3_off;
+    std::uint32_t l4_off;
+    std::uint32_t pl_off;       // application payload
+    std::uint32_t pl_end;       // end of the IP datagram within caplen (drops Ethernet padding)
+    std::uint32_t ip_end;       // end of the IP datagram by its length field, possibly past caplen
+    std::uint32_t tcp_len;      // TCP payload bytes on the wire, captured or not
+    std::uint16_t ether_type;   // innermost
+    std::uint16_t vlan[MAX_VLAN_TAGS];
+    std::uint16_t sport;
+    std::uint16_t dport;
+    std::uint16_t win;
+    std::uint16_t arp_op;
+    std::uint8_t  vlans;
+    std::uint8_t  family;       // AF_INET, AF_INET6, or 0 without an IP layer
+    std::uint8_t  ip_proto;     // after IPv6 extension headers
+    std::uint8_t  ttl;
+    std::uint8_t  tcp_flags;
+    std::uint8_t  icmp_type;
+    std::uint8_t  icmp_code;
+    std::uint8_t  flags;        // DF_*
+    Proto         proto;
+};
+
+// Decodes one frame of the given DLT_* link type. Each layer checks its
+// header against caplen before reading it and stops at the first one that
+// doesn't fit; the fields decoded up to that point stay valid.
+void dissect(const std::uint8_t* pkt, std::uint32_t caplen, int linktype, Decoded& d);
@@ -0,0 +1,144 @@
+//
+// Created by Shaunik Musukula on 7/25/25.
+//
+
+#pragma once
+
+#include "dissect.h"
+#include "instrument.h"
+#include "packet_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+constexpr std::uint16_t DNS_PORT           = 53;
+constexpr std::size_t   DNS_RESOLVERS      = 16;      // per shard; answers from any more share one "other" entry
+constexpr std::size_t   DNS_RCODES         = 7;       // NOERROR..REFUSED, then everything else
+constexpr std::size_t   DNS_SWEEP_PER_PKT  = 4;
+constexpr std::size_t   DNS_SWEEP_IDLE     = 1 << 12;
+constexpr std::size_t   DNS_EVICT_WINDOW   = 16;
+
+extern const char* const DNS_RCODE_NAMES[DNS_RCODES];
+
+inline bool is_dns(const PacketRecord& r) {
+    return r.proto == Proto::kUdp && (r.sport == DNS_PORT || r.dport == DNS_PORT);
+}
+
+// The fixed 12-byte header at the start of every DNS message.
+struct DnsHeader {
+    std::uint16_t id;
+    bool          response;
+    std::uint8_t  rcode;
+    std::uint16_t questions;
+};
+
+// false if the payload is too short or doesn't look like a query or response
+bool parse_dns(const std::uint8_t* p, std::size_t len, DnsHeader& h);
+
+// A query waiting for its response, keyed by both ends and the transaction ID.
+struct DnsKey {
+    IpAddr        client;
+    IpAddr        server;
+    std::uint16_t client_port;
+    std::uint16_t server_port;
+    std::uint16_t id;
+    std::uint8_t  family;
+    std::uint8_t  pad;          // keeps the key free of padding for hashing/memcmp
+};
+
+struct DnsPending {
+    DnsKey        key;
+    std::uint32_t hash;
+    std::int64_t  sent_ns;
+    std::uint8_t  resolver;     // index into the tracker's resolvers
+    bool          used;
+};
+
+// One server that queries went to. `addr` and `family` are set once, before
+// the tracker's resolver count is published.
+struct DnsResolver {
+    IpAddr                   addr{};
+    std::uint8_t             family = 0;
+    std::atomic<std::size_t> queries{0};
+    std::atomic<std::size_t> answered{0};
+    std::atomic<std::size_t> unanswered{0};
+    Histogram                latency;       // ns from query to response
+};
+
+// Matches one capture shard's DNS queries to their responses in a
+// fixed-size open-addressing table, with the same incremental sweep and
+// backward-shift deletion as FlowTable. Queries that outlive the timeout are
+// counted as unanswered; a full table forgets the oldest of a few nearby ones.
+// Counters and histograms are bumped with relaxed stores, so any thread may
+// read them.
+class DnsTracker {
+public:
+    DnsTracker(std::size_t slots, int timeout_s);
+
+    [[nodiscard]] bool enabled() const { return mask_ != 0; }
+
+    // capture side; `d` must be a UDP packet to or from DNS_PORT
+    void update(const PacketRecord& r, const Decoded& d, const std::uint8_t* pkt, std::int64_t now_ns);
+    void sweep(std::size_t n, std::int64_t now_ns);
+
+    // any thread
+    [[nodiscard]] std::size_t resolvers() const { return n_resolvers_.load(std::memory_order_acquire); }
+    [[nodiscard]] const DnsResolver& resolver(const std::size_t i) const { return resolvers_[i]; }
+    [[nodiscard]] const DnsResolver& other() const { return resolvers_[DNS_RESOLVERS]; }
+    [[nodiscard]] const Histogram&   by_rcode(const std::size_t i) const { return by_rcode_[i]; }
+
+    std::atomic<std::size_t> queries{0};
+    std::atomic<std::size_t> responses{0};
+    std::atomic<std::size_t> unmatched{0};      // responses to no query we saw
+    std::atomic<std::size_t> unanswered{0};     // timed out
+    std::atomic<std::size_t> forgotten{0};      // pushed out of a full table
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> rcodes[DNS_RCODES]{};
+
+private:
+    using PendingSlots = std::unique_ptr<DnsPending[], decltype(&std::free)>;
+
+    [[nodiscard]] std::size_t home(const std::uint32_t h) const { return h & mask_; }
+    [[nodiscard]] std::uint8_t resolver_of(const IpAddr& a, std::uint8_t family);
+    void erase(std::size_t i);
+
+    std::size_t              mask_;
+    std::size_t              max_used_;
+    std::int64_t             timeout_ns_;
+    PendingSlots             slots_;
+    std::size_t              used_   = 0;
+    std::size_t              cursor_ = 0;
+
+    DnsResolver              resolvers_[DNS_RESOLVERS + 1];
+    std::atomic<std::size_t> n_resolvers_{0};
+    Histogram                by_rcode_[DNS_RCODES];
+};
+
+// One resolver summed over every shard.
+struct DnsResolverTotals {
+    IpAddr       addr{};
+    std::uint8_t family = 0;            // 0 for the "other" entry
+    std::size_t  queries    = 0;
+    std::size_t  answered   = 0;
+    std::size_t  unanswered = 0;
+    HistSnapshot latency;
+};
+
+// Plain sum of every shard's DnsTracker, taken when somebody wants numbers.
+struct DnsTotals {
+    std::size_t                    queries    = 0;
+    std::size_t                    responses  = 0;
+    std::size_t                    unmatched  = 0;
+    std::size_t                    unanswered = 0;
+    std::size_t                    forgotten  = 0;
+    std::size_t                    pending    = 0;
+    std::size_t                    rcodes[DNS_RCODES]{};
+    HistSnapshot                   by_rcode[DNS_RCODES];
+    std::vector<DnsResolverTotals> resolvers;        // busiest first, "other" (if used) last
+
+    void add(const DnsTracker& t);
+    void sort();
+};
@@ -0,0 +1,29 @@
+//
+// Created by Shaunik Musukula on 7/16/25.
+//
+
+#pragma once
+
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// Compiles `expr` against every open capture handle and attaches it, so the
+// kernel drops what doesn't match before it is copied to us. An empty
+// expression removes the filter. On failure every handle keeps the filter it
+// had and the message is left in gErr. Capture must be stopped.
+bool set_filter(const std::string& expr);
+
+// Refreshes gFilter's seen/kept numbers; the UI calls it once a second.
+void update_filter_stats();
+
+// Same filter for a saved capture, run in userspace on each packet.
+bool compile_offline_filter(const std::string& expr, int linktype, int snaplen, bpf_program& prog);
@@ -0,0 +1,137 @@
+//
+// Created by Shaunik Musukula on 7/14/25.
+//
+
+#pragma once
+
+#include "packet_ring.h"
+#include "seqlock.h"
+#include "tcp_analysis.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+constexpr std::size_t TOP_FLOWS          = 32;
+constexpr std::size_t FLOW_SWEEP_PER_PKT = 8;
+constexpr std::size_t FLOW_SWEEP_IDLE    = 1 << 16;
+constexpr std::size_t FLOW_EVICT_WINDOW  = 16;
+
+// Endpoints are stored in a canonical order so both directions of a
+// connection land on the same entry; `a_is_src` remembers who spoke first.
+struct FlowKey {
+    IpAddr        a;
+    IpAddr        b;
+    std::uint16_t port_a;
+    std::uint16_t port_b;
+    std::uint8_t  family;
+    Proto         proto;
+    std::uint16_t pad;          // keeps the key free of padding for hashing/memcmp
+
+    [[nodiscard]] bool operator==(const FlowKey& o) const {
+        return std::memcmp(this, &o, sizeof(FlowKey)) == 0;
+    }
+};
+
+struct FlowEntry {
+    FlowKey       key;
+    std::uint32_t hash;
+    std::uint64_t packets;
+    std::uint64_t bytes;
+    std::int64_t  first_ns;
+    std::int64_t  last_ns;
+    std::uint32_t tcp;          // TcpTracker handle, 0 = not analysed
+    std::uint8_t  tcp_flags;    // every flag seen so far, OR'd together
+    bool          a_is_src;
+    bool          used;
+
+    // bytes per second over the flow's lifetime
+    [[nodiscard]] double rate() const {
+        const std::int64_t d = last_ns - first_ns;
+        return d > 0 ? static_cast<double>(bytes) * 1e9 / static_cast<double>(d) : static_cast<double>(bytes);
+    }
+};
+
+// Heaviest flows seen over one full sweep of a table.
+struct FlowTop {
+    std::array<FlowEntry, TOP_FLOWS> by_bytes;
+    std::array<FlowEntry, TOP_FLOWS> by_rate;
+    std::size_t                      n_bytes = 0;
+    std::size_t                      n_rate  = 0;
+};
+
+// One flow as the capture thread saw it when the UI asked, with its TCP
+// analysis and the reassembled start of both directions.
+struct FlowDetail {
+    unsigned      gen;          // the ask this answers
+    bool          found;
+    bool          tcp_valid;
+    FlowEntry     flow;
+    TcpStats      tcp;
+    std::size_t   untracked;    // TCP connections the shard had no room for
+    std::uint32_t stream_len[2];
+    std::uint8_t  stream[2][REASM_CHUNK];
+};
+
+// Fixed-size open-addressing (linear probing) flow table, owned by one capture
+// shard. Idle flows are evicted by an incremental sweep that walks a few slots
+// per packet; the same sweep collects the top flows and publishes them for the
+// UI once per full pass. TCP flows also carry a TcpTracker entry. Nothing is
+// allocated after construction.
+class FlowTable {
+public:
+    FlowTable(std::size_t slots, int idle_timeout_s, std::size_t reasm_bytes);
+
+    [[nodiscard]] bool enabled() const { return mask_ != 0; }
+
+    // capture side; returns the segment's TCP_EV_* bits
+    std::uint8_t update(const PacketRecord& r, const Decoded& d, const std::uint8_t* pkt, std::int64_t now_ns);
+    void sweep(std::size_t n, std::int64_t now_ns);
+    void publish();                 // full pass right now, e.g. at the end of a file
+    void answer();                  // also the UI's to call while capture is stopped
+
+    // UI side: the capture thread answers on its next packet or idle sweep,
+    // and detail().gen matches the returned number once it has
+    unsigned ask(const FlowKey& k);
+
+    // any thread
+    [[nodiscard]] std::size_t active()  const { return active_.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t evicted() const { return evicted_.load(std::memory_order_relaxed); }
+    [[nodiscard]] FlowTop     top()     const { return top_.load(); }
+    [[nodiscard]] FlowDetail  detail()  const { return detail_.load(); }
+
+private:
+    using FlowSlots = std::unique_ptr<FlowEntry[], decltype(&std::free)>;
+
+    [[nodiscard]] std::size_t home(const std::uint32_t h) const { return h & mask_; }
+    [[nodiscard]] std::size_t find(const FlowKey& k, std::uint32_t h) const;
+    void erase(std::size_t i);
+    void evict_one();
+    void consider(const FlowEntry& e);
+
+    std::size_t                  mask_;
+    std::size_t                  max_used_;
+    std::int64_t                 timeout_ns_;
+    FlowSlots                    slots_;
+    std::size_t                  used_   = 0;
+    std::size_t                  cursor_ = 0;
+    FlowTop                      building_;
+    TcpTracker                   tcp_;
+    unsigned                     answered_ = 0;
+    std::unique_ptr<FlowDetail>  answer_;      // built here, then published
+
+    std::atomic<std::size_t>     active_{0};
+    std::atomic<std::size_t>     evicted_{0};
+    SeqLocked<FlowTop>           top_;
+    SeqLocked<FlowKey>           ask_key_;
+    std::atomic<unsigned>        ask_gen_{0};
+    SeqLocked<FlowDetail>        detail_;
+};
+
+std::int64_t ts_to_ns(const timeval& ts, bool nano);
+
+// canonical (direction-free) key of the flow a packet belongs to
+FlowKey make_flow_key(const PacketRecord& r, bool& a_is_src);
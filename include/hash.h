@@ -0,0 +1,41 @@
+//
+// Created by Shaunik Musukula on 7/15/25.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Multiply-xorshift over 8-byte words with a final avalanche, so every output
+// bit depends on every input byte. Keys are small fixed-size structs; this is
+// far cheaper than a byte-at-a-time hash and good enough for table indexing
+// and HyperLogLog.
+inline std::uint64_t hash64(const void* data, const std::size_t len) {
+    const auto*   p = static_cast<const std::uint8_t*>(data);
+    std::uint64_t h = 0x9E37'79B9'7F4A'7C15ull ^ len;
+    std::size_t   i = 0;
+    for (; i + 8 <= len; i += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h  = (h ^ w) * 0xBF58'476D'1CE4'E5B9ull;
+        h ^= h >> 31;
+    }
+    if (i < len) {
+        std::uint64_t w = 0;
+        std::memcpy(&w, p + i, len - i);
+        h  = (h ^ w) * 0xBF58'476D'1CE4'E5B9ull;
+        h ^= h >> 31;
+    }
+    h *= 0x94D0'49BB'1331'11EBull;
+    h ^= h >> 29;
+    return h;
+}
+
+// table sizes: the smallest power of two at or above n, so a mask can stand in for %
+inline std::size_t round_pow2(const std::size_t n) {
+    std::size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
@@ -0,0 +1,112 @@
+//
+// Created by Shaunik Musukula on 7/21/25.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Log-linear buckets in the style of HdrHistogram: values below 2^HIST_SUB_BITS
+// are exact, above that every power of two is split into 2^HIST_SUB_BITS
+// buckets, so anything is recorded within 1/16 of its value. Values past
+// 2^HIST_MAX_BITS (about 18 minutes in ns) share the last bucket.
+constexpr unsigned    HIST_SUB_BITS = 4;
+constexpr std::size_t HIST_SUB      = std::size_t{1} << HIST_SUB_BITS;
+constexpr unsigned    HIST_MAX_BITS = 40;
+constexpr std::size_t HIST_BUCKETS  = (HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB;
+
+constexpr std::uint32_t INSTR_SAMPLE   = 16;     // one packet in this many is timed, a power of two
+constexpr int           KSTATS_POLL_MS = 1'000;  // how often capture threads ask the kernel for drops
+
+inline std::size_t hist_bucket(const std::uint64_t v) {
+    if (v >= std::uint64_t{1} << HIST_MAX_BITS) return HIST_BUCKETS - 1;
+    if (v < HIST_SUB) return v;
+    const unsigned e = 63 - __builtin_clzll(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + ((v >> (e - HIST_SUB_BITS)) - HIST_SUB);
+}
+
+// the largest value recorded in bucket b
+inline std::uint64_t hist_upper(const std::size_t b) {
+    if (b < HIST_SUB) return b;
+    const std::size_t shift = b / HIST_SUB - 1;
+    return ((HIST_SUB + b % HIST_SUB + 1) << shift) - 1;
+}
+
+// Written by one thread and read by any, with the same relaxed load-and-store
+// bumps as Counters.
+class Histogram {
+public:
+    void record(const std::uint64_t v) {
+        auto& c = counts_[hist_bucket(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+private:
+    friend struct HistSnapshot;
+
+    std::atomic<std::uint64_t> counts_[HIST_BUCKETS]{};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+// Plain copy of one or more histograms, taken when somebody wants numbers.
+struct HistSnapshot {
+    std::uint64_t counts[HIST_BUCKETS]{};
+    std::uint64_t total = 0;
+    std::uint64_t sum   = 0;       // of the recorded values, for prometheus summaries
+    std::uint64_t max   = 0;
+
+    void add(const Histogram& h);
+
+    // smallest recorded value that q of the samples are at or below (within 1/16)
+    [[nodiscard]] std::uint64_t percentile(double q) const;
+
+    // "p50 120ns  p99 800ns  p99.9 2.1us  max 40us", or plain counts unless `ns`
+    [[nodiscard]] std::string summary(bool ns) const;
+};
+
+// What a capture shard measures about itself. The capture thread also fetches
+// the kernel's counters for its handle, since pcap_stats() must not run
+// alongside pcap_dispatch() on the same handle.
+struct ShardInstruments {
+    Histogram decode;           // ns per timed packet: dissecting the headers
+    Histogram dump;             // copying into the pcap writer's ring
+    Histogram book;             // counters, flows, sketches, live match, payload arena, row queue
+    Histogram batch;            // packets per pcap_dispatch() call that returned any
+    Histogram depth;            // UI side: rows waiting in the queue at each drain
+
+    std::atomic<std::uint64_t> k_recv{0};
+    std::atomic<std::uint64_t> k_drop{0};       // no room in the kernel's buffer
+    std::atomic<std::uint64_t> k_ifdrop{0};     // dropped by the interface or its driver
+    std::atomic<bool>          k_valid{false};  // pcap_stats() has worked at least once
+
+    std::uint32_t                         tick = 0;        // capture thread only
+    std::chrono::steady_clock::time_point next_kstats{};
+
+    [[nodiscard]] bool timed() { return (++tick & (INSTR_SAMPLE - 1)) == 0; }
+};
+
+// Times consecutive stages of one packet, or does nothing for untimed packets.
+class StageTimer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit StageTimer(const bool on) : on_(on) { if (on_) last_ = clock::now(); }
+
+    // the time since the previous lap (or the start) goes into `h`
+    void lap(Histogram& h) {
+        if (!on_) return;
+        const auto now = clock::now();
+        h.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count()));
+        last_ = now;
+    }
+
+private:
+    bool              on_;
+    clock::time_point last_{};
+};
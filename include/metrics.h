@@ -0,0 +1,76 @@
+//
+// Created by Shaunik Musukula on 7/22/25.
+//
+
+#pragma once
+
+#include "capture.h"
+#include "stats.h"
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr std::size_t METRICS_TOP_FLOWS = 10;
+constexpr int         METRICS_POLL_MS   = 200;        // how often the server looks at its stop flag
+constexpr int         METRICS_IO_MS     = 1'000;      // a client gets this long to send its request
+constexpr std::size_t METRICS_REQ_MAX   = 4'096;
+
+// One captured interface's share of a snapshot.
+struct DeviceMetrics {
+    const char*   name = "";
+    CounterTotals c;
+    KernelDrops   kernel;
+};
+
+// Numbers for one interval, gathered by the main thread from the relaxed
+// counters and the seqlock-published flow tops. Nothing in here waits on a
+// capture thread or touches its private state.
+struct MetricsSnapshot {
+    std::time_t                at = 0;
+    CounterTotals              c;
+    RateSample                 rate{};        // the last interval; secs is 0 before the first one
+    KernelDrops                kernel;
+    std::size_t                flows_active = 0;
+    std::vector<FlowEntry>     top;           // by bytes, at most METRICS_TOP_FLOWS
+    std::vector<DeviceMetrics> devs;          // in gCapDevs order
+    DnsTotals                  dns;
+
+    void take();
+};
+
+// Prometheus text exposition format, version 0.0.4
+std::string prometheus_text(const MetricsSnapshot& m);
+
+// one line of JSON, newline included
+std::string json_line(const MetricsSnapshot& m);
+
+// Serves the latest published text on GET /metrics from its own thread. The
+// text is rebuilt by the main loop once per interval, so a scrape only copies
+// a string and never reaches the capture path.
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+    ~MetricsServer() { stop(); }
+
+    // "[addr:]port", addr an IPv4 address or a bracketed IPv6 one; false with gErr set
+    bool start(const char* spec);
+    void publish(std::string text);
+    void stop();
+
+private:
+    void run();
+    void serve(int fd);
+
+    int                                listen_fd_ = -1;
+    std::thread                        thread_;
+    std::atomic<bool>                  stop_{false};
+    std::mutex                         mu_;           // guards text_, shared with the main thread only
+    std::shared_ptr<const std::string> text_;
+};
@@ -5,7 +5,7 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,9 +17,58 @@ extern "C" {
 }
 #endif
 
+// What the system says about an interface. On Linux it comes from sysfs and
+// the ethtool ioctl; elsewhere only `description` is filled in.
+struct IfaceInfo {
+    std::string driver;             // "" when unknown
+    std::string operstate;          // "up", "down", "dormant", ...
+    int         mtu        = 0;
+    int         speed_mbps = 0;     // 0 when unknown or not applicable
+    int         rx_queues  = 0;
+    int         tx_queues  = 0;
+    bool        physical   = false; // backed by a device rather than software
+};
+
+// One capturable interface. Only the name is known up front; the rest is read
+// the first time somebody asks for it, so listing hundreds of interfaces costs
+// no more than their names.
 struct DeviceMapping {
-    pcap_if_t* iface{};
+    std::string name;
+    std::string pcap_desc;          // libpcap's own description, if any
+    bool        present = true;     // false once the interface went away
+    bool        loaded  = false;
+    IfaceInfo   info;
     std::string description;
 };
 
-DeviceMapping match_iface_pcap(pcap_if_t* iface);
+DeviceMapping match_iface_pcap(const pcap_if_t* iface);
+
+// loads the device's info on first use, or after it changed
+const std::string& describe(DeviceMapping& dev);
+const IfaceInfo&   iface_info(DeviceMapping& dev);
+
+// Interfaces appearing, disappearing or changing, as announced on a
+// non-blocking rtnetlink socket. Only Linux has one; elsewhere open() fails
+// and the device list stays what it was at startup.
+struct LinkEvent {
+    std::string name;
+    bool        gone;
+};
+
+class LinkWatcher {
+public:
+    LinkWatcher() = default;
+    LinkWatcher(const LinkWatcher&) = delete;
+    LinkWatcher& operator=(const LinkWatcher&) = delete;
+    ~LinkWatcher() { close(); }
+
+    bool open();
+    void close();
+
+    // appends what arrived since the last call, never blocks; false if events
+    // were lost and the interfaces should be listed again
+    bool poll(std::vector<LinkEvent>& out);
+
+private:
+    int fd_ = -1;
+};
@@ -0,0 +1,31 @@
+//
+// Created by Shaunik Musukula on 7/11/25.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr std::size_t OFFLINE_DRAIN_EVERY = 4'096;
+constexpr std::size_t OFFLINE_TOP_FLOWS   = 5;
+
+constexpr std::uint32_t PCAP_MAGIC_USEC = 0xA1B2C3D4;
+constexpr std::uint32_t PCAP_MAGIC_NSEC = 0xA1B23C4D;
+constexpr int           LINKTYPE_RAW    = 101;
+
+struct OfflineResult {
+    std::size_t packets     = 0;
+    std::size_t file_bytes  = 0;         // read from disk
+    std::size_t blocks      = 0;         // in a --pcapng file's index
+    std::size_t blocks_read = 0;
+    double      seconds     = 0;
+};
+
+// Runs every packet of a saved capture through packet_cb as fast as possible.
+// Files from --pcapng are read by the blocks their index says overlap
+// --since/--until; classic pcap files are read straight out of an mmap;
+// anything else (other pcapng, compressed) goes through pcap_open_offline.
+OfflineResult run_offline(const char* path);
+
+void print_offline_summary(const char* path, const OfflineResult& res);
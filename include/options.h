@@ -0,0 +1,94 @@
+//
+// Created by Shaunik Musukula on 7/10/25.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+constexpr int SNAPLEN_DEFAULT      = 65'535;
+constexpr int SNAPLEN_HEADERS      = 128;
+constexpr int READ_TIMEOUT_MS      = 100;
+constexpr int MAX_WORKERS          = 64;
+constexpr int FLOW_SLOTS_DEFAULT   = 1 << 20;
+constexpr int FLOW_TIMEOUT_S       = 120;
+constexpr int DNS_SLOTS_DEFAULT    = 1 << 16;
+constexpr int DNS_TIMEOUT_S        = 5;
+constexpr int SKETCH_WIDTH_DEFAULT = 2'048;
+constexpr int HLL_BITS_DEFAULT     = 14;
+constexpr int HLL_BITS_MIN         = 4;
+constexpr int HLL_BITS_MAX         = 18;
+constexpr int INTERVAL_DEFAULT_S   = 1;
+constexpr int POST_SECONDS_DEFAULT = 10;
+constexpr int COMPRESS_DEFAULT     = 1;          // deflate's fastest; higher levels rarely pay for their cpu here
+
+constexpr std::size_t PAYLOAD_MEM_DEFAULT = std::size_t{256} << 20;
+constexpr std::size_t PAYLOAD_MEM_MIN     = std::size_t{1} << 20;      // per worker and interface
+constexpr std::size_t SPOOL_BYTES_DEFAULT = std::size_t{1} << 30;
+constexpr std::size_t SPOOL_BYTES_MIN     = std::size_t{16} << 20;
+constexpr std::size_t RECORD_BYTES_MIN    = std::size_t{1} << 20;      // per worker and interface
+constexpr std::size_t FLOW_SLOTS_MIN      = 64;                        // per worker and interface
+constexpr std::size_t DNS_SLOTS_MIN       = 64;                        // per worker and interface
+
+enum class FanoutMode { kHash, kCpu, kLoadBalance };
+
+// One end of the --since/--until window: seconds since the epoch, or since
+// the file's first packet when `relative`.
+struct TimeBound {
+    bool   set      = false;
+    bool   relative = false;
+    double secs     = 0;
+};
+
+struct CaptureConfig {
+    bool        nano_ts        = false;
+    int         tstamp_type    = -1;                  // PCAP_TSTAMP_*, -1 keeps the driver default
+    int         snaplen        = SNAPLEN_DEFAULT;
+    int         buffer_bytes   = 0;                   // kernel ring size, 0 keeps the libpcap default
+    int         timeout_ms     = READ_TIMEOUT_MS;
+    bool        immediate      = false;
+    int         workers        = 1;                   // >1 opens a PACKET_FANOUT group (Linux only)
+    FanoutMode  fanout         = FanoutMode::kHash;
+    const char* read_file      = nullptr;             // offline analysis instead of live capture
+    const char* filter         = nullptr;             // BPF expression, applied in the kernel when live
+    TimeBound   since;                                // with read_file: only packets in [since, until)
+    TimeBound   until;
+    bool        tui            = false;               // browse offline results in the UI
+    const char* write_file     = "capture.pcap";      // file name template, nullptr disables writing
+    std::size_t rotate_bytes   = 0;
+    std::size_t rotate_packets = 0;
+    int         rotate_seconds = 0;
+    int         max_files      = 0;
+    bool        pcapng         = false;               // compressed, indexed pcapng instead of classic pcap
+    int         compress_level = -1;                  // deflate level for pcapng, -1 until set
+    std::size_t flow_slots     = FLOW_SLOTS_DEFAULT;  // shared by all workers, 0 disables flows
+    int         flow_timeout   = FLOW_TIMEOUT_S;
+    std::size_t reasm_bytes    = 0;                   // TCP stream starts kept for the flow detail, shared by all workers
+    std::size_t dns_slots      = DNS_SLOTS_DEFAULT;   // outstanding DNS queries, shared by all workers; 0 = off
+    int         dns_timeout    = DNS_TIMEOUT_S;       // a query unanswered this long counts as lost
+    std::size_t sketch_width   = SKETCH_WIDTH_DEFAULT;  // counters per heavy-hitter sketch row, 0 disables them
+    int         hll_bits       = HLL_BITS_DEFAULT;    // distinct counts use 2^bits registers, 0 disables them
+    std::size_t payload_mem    = PAYLOAD_MEM_DEFAULT; // packet bytes kept for the hex pane, shared by all workers
+    std::size_t spool_bytes    = SPOOL_BYTES_DEFAULT; // scrollback file behind the in-memory rows, 0 disables it
+    const char* spool_dir      = nullptr;             // nullptr: $TMPDIR, else /var/tmp
+    const char* match          = nullptr;             // payload pattern to count and highlight from the start
+    std::vector<const char*> devices;                 // -i, once per interface; empty: the first one found
+    bool        headless       = false;               // no UI: capture until a stop condition or a signal
+    std::size_t stop_packets   = 0;                   // at most one of the three is set
+    std::size_t stop_bytes     = 0;
+    std::size_t stop_seconds   = 0;
+    const char* metrics        = nullptr;             // "[addr:]port" for the Prometheus endpoint
+    const char* json           = nullptr;             // JSON lines file, "-" for stdout
+    int         interval       = INTERVAL_DEFAULT_S;  // seconds between metric updates and JSON lines
+    std::size_t record_bytes   = 0;                   // flight recorder ring, shared by all workers; 0 = plain writing
+    int         record_seconds = 0;                   // how far back a dump reaches, 0 = whatever the ring holds
+    int         post_seconds   = POST_SECONDS_DEFAULT;  // traffic written after a trigger
+    const char* trigger_filter = nullptr;             // BPF expression whose first match dumps
+    std::size_t trigger_pps    = 0;                   // 0 = off
+    std::size_t trigger_rst    = 0;                   // TCP RSTs per second, 0 = off
+};
+
+extern CaptureConfig gCfg;
+
+void parse_args(int argc, char** argv);
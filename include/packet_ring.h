@@ -0,0 +1,117 @@
+//
+// Created by Shaunik Musukula on 7/9/25.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <sys/time.h>
+
+enum class Proto : std::uint8_t { kTcp, kUdp, kIcmp, kOther, kIcmp6, kArp };
+
+union IpAddr {
+    std::uint32_t v4;
+    std::uint8_t  v6[16];
+};
+
+// Everything the table needs about a packet, kept binary; text is produced only
+// for the rows that are on screen.
+struct PacketRecord {
+    timeval       ts;
+    IpAddr        src;
+    IpAddr        dst;
+    std::uint64_t pl_off;
+    std::uint32_t len;
+    std::uint32_t pl_len;
+    std::uint16_t sport;
+    std::uint16_t dport;
+    std::uint8_t  family;
+    Proto         proto;
+    std::uint8_t  shard;        // capture shard holding the payload bytes
+    std::uint8_t  tcp_flags;
+};
+
+// Preallocated history of the last N records. push() overwrites the oldest entry
+// once full, so inserts are O(1) at any size. Pages are only touched as rows arrive.
+class PacketRing {
+public:
+    explicit PacketRing(const std::size_t cap) : cap_(cap), buf_(new PacketRecord[cap]) {}
+
+    void push(const PacketRecord& r) {
+        buf_[head_ % cap_] = r;
+        ++head_;
+    }
+
+    // i-th newest record, 0 is the latest
+    [[nodiscard]] const PacketRecord& recent(const std::size_t i) const {
+        return buf_[(head_ - 1 - i) % cap_];
+    }
+
+    // records ever pushed; recent(i) is record number pushed() - 1 - i
+    [[nodiscard]] std::size_t pushed() const { return head_; }
+    [[nodiscard]] std::size_t size()  const { return head_ < cap_ ? head_ : cap_; }
+    [[nodiscard]] bool        empty() const { return head_ == 0; }
+    void                      clear()       { head_ = 0; }
+
+private:
+    std::size_t                     cap_;
+    std::size_t                     head_ = 0;
+    std::unique_ptr<PacketRecord[]> buf_;
+};
+
+// Byte arena for payload copies, one per capture shard, sized by the memory
+// budget. The capture thread appends and records the absolute offset in the
+// PacketRecord, so there is no allocation per packet; the oldest bytes are
+// overwritten once the budget is used up. The UI copies a payload out and then
+// checks it wasn't overwritten while it was reading. Pages are only touched as
+// bytes arrive, so a budget that is never filled costs nothing.
+class PayloadRing {
+public:
+    static constexpr std::size_t MAX_APPEND = 1 << 16;
+
+    explicit PayloadRing(const std::size_t cap) : cap_(cap), buf_(new std::uint8_t[cap]) {}
+
+    // producer side
+    std::uint64_t append(const std::uint8_t* d, std::size_t len) {
+        if (len > MAX_APPEND) len = MAX_APPEND;
+        const std::uint64_t off = head_.load(std::memory_order_relaxed);
+        const std::size_t   at  = off % cap_;
+        const std::size_t   n1  = std::min(len, cap_ - at);
+        std::memcpy(buf_.get() + at, d, n1);
+        std::memcpy(buf_.get(), d + n1, len - n1);
+        head_.store(off + len, std::memory_order_release);
+        return off;
+    }
+
+    // consumer side, false if the bytes have been recycled
+    bool copy_out(const std::uint64_t off, const std::size_t len, std::uint8_t* out) const {
+        if (!still_valid(off, len)) return false;
+        const std::size_t at = off % cap_;
+        const std::size_t n1 = std::min(len, cap_ - at);
+        std::memcpy(out, buf_.get() + at, n1);
+        std::memcpy(out + n1, buf_.get(), len - n1);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return still_valid(off, len);
+    }
+
+    // only valid while the producer is stopped
+    void clear() { head_.store(0, std::memory_order_relaxed); }
+
+    [[nodiscard]] bool        enabled()  const { return cap_ > 0; }
+    [[nodiscard]] std::size_t capacity() const { return cap_; }
+
+private:
+    // leaves room for one append that may be in flight past the published head
+    [[nodiscard]] bool still_valid(const std::uint64_t off, const std::size_t len) const {
+        return len <= cap_ && head_.load(std::memory_order_acquire) - off + MAX_APPEND <= cap_;
+    }
+
+    std::size_t                     cap_;
+    std::atomic<std::uint64_t>      head_{0};
+    std::unique_ptr<std::uint8_t[]> buf_;
+};
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include "dissect.h"
+#include "state.h"
+
 #include <cstdint>
 #include <cstdio>
 
@@ -17,8 +20,16 @@ extern "C" {
 }
 #endif
 
-void open_device(std::size_t idx);
+// (Re)opens capture on every interface in gCapDevs and starts it, clearing
+// the stop limit if asked. False, with the reason in gErr and the current
+// capture left running, if the interfaces can't be opened.
+bool open_devices(bool clear_limit = false);
+
+void close_devices();
+
+void maintain_selection(std::size_t added);
 
-void maintain_selection();
+// Dissects the frame into d and fills the binary fields of r from it.
+void decode_packet(const pcap_pkthdr* h, const std::uint8_t* pkt, int linktype, PacketRecord& r, Decoded& d);
 
 void packet_cb(std::uint8_t* user, const pcap_pkthdr* h, const std::uint8_t* pkt);
\ No newline at end of file
@@ -0,0 +1,169 @@
+//
+// Created by Shaunik Musukula on 7/13/25.
+//
+
+#pragma once
+
+#include "pcapng.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+constexpr std::size_t DUMP_RING_BYTES   = 64 << 20;   // shared by all shards
+constexpr std::size_t DUMP_MAX_WRITE    = 4 << 20;
+constexpr int         WRITER_IDLE_MS    = 10;
+constexpr std::size_t PCAP_RECORD_BYTES = 16;
+
+struct RotatePolicy {
+    std::size_t max_bytes   = 0;    // 0 = no limit
+    std::size_t max_packets = 0;
+    int         max_seconds = 0;
+    int         max_files   = 0;    // oldest files are deleted past this, 0 keeps all
+};
+
+// Byte ring carrying pcap records (on-disk record header + captured bytes) from
+// one capture shard to the writer thread. push() never waits: if the writer is
+// behind, the packet is left out of the file and counted, capture goes on.
+//
+// In overwrite mode (the flight recorder) nobody consumes: a full ring makes
+// room by forgetting its oldest records, and the producer owns the tail. The
+// writer asks for a mode change and the producer takes it up in sync(),
+// between batches, so the tail only ever has one writer.
+class DumpRing {
+public:
+    explicit DumpRing(std::size_t cap) : cap_(cap), buf_(new std::uint8_t[cap]) {}
+
+    // producer side
+    bool push(const pcap_pkthdr* h, const std::uint8_t* pkt);
+    void sync() {
+        if (const bool want = overwrite_.load(std::memory_order_acquire); want != mode_) {
+            mode_ = want;
+            acked_.store(want, std::memory_order_release);
+        }
+    }
+
+    // consumer side
+    void set_overwrite(const bool on) { overwrite_.store(on, std::memory_order_release); }
+    [[nodiscard]] bool synced() const {
+        return acked_.load(std::memory_order_acquire) == overwrite_.load(std::memory_order_relaxed);
+    }
+
+    // consumer side
+    [[nodiscard]] std::size_t readable() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] std::size_t   capacity() const { return cap_; }
+    [[nodiscard]] std::uint64_t tail() const { return tail_.load(std::memory_order_relaxed); }
+    void copy(std::uint64_t at, void* out, std::size_t len) const;
+    void segments(std::uint64_t at, std::size_t len, const std::uint8_t*& a, std::size_t& a_len,
+                  const std::uint8_t*& b, std::size_t& b_len) const;
+    void consume(const std::size_t n) { tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+    std::atomic<std::size_t> dropped{0};
+
+private:
+    void put(std::uint64_t at, const void* src, std::size_t len);
+
+    std::size_t                                    cap_;
+    std::unique_ptr<std::uint8_t[]>                buf_;
+    alignas(CACHE_LINE) std::atomic<std::uint64_t> head_{0};
+    std::uint64_t                                  tail_cache_{0};
+    bool                                           mode_ = false;     // producer's view of overwrite_
+    alignas(CACHE_LINE) std::atomic<std::uint64_t> tail_{0};
+    std::atomic<bool>                              overwrite_{false};
+    std::atomic<bool>                              acked_{false};
+};
+
+// Background thread that drains every shard's DumpRing with large sequential
+// writes and rotates files by size, age or packet count. Files are classic
+// pcap, or with configure_pcapng() compressed pcapng (see PcapngFile) with an
+// interface block per captured device. As a flight recorder
+// it writes nothing until trigger(): then what the rings hold (back to
+// `pre_seconds` before the trigger, 0 for all of it) and the next
+// `post_seconds` of traffic go to a new file, and recording resumes.
+class PcapWriter {
+public:
+    void configure(std::string name_template, const RotatePolicy& policy);
+    void configure_recorder(int pre_seconds, int post_seconds);
+    void configure_pcapng(int level);
+
+    // (re)starts draining `rings`, ring i holding packets from ifaces[ring_ifaces[i]],
+    // whose link type is linktypes[ring_ifaces[i]]; classic pcap needs them all the
+    // same. Different link types, precision or (for pcapng) interfaces start a new file.
+    void start(std::vector<DumpRing*> rings, std::vector<std::uint32_t> ring_ifaces, std::vector<std::string> ifaces,
+               std::vector<int> linktypes, int snaplen, bool nano);
+
+    // drains what is queued, then parks the thread; the current file stays open
+    void stop();
+
+    void close();
+
+    [[nodiscard]] bool        enabled() const { return !template_.empty(); }
+    [[nodiscard]] bool        pcapng() const { return level_ >= 0; }
+    [[nodiscard]] std::size_t files_written() const { return files_.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t bytes_written() const { return bytes_.load(std::memory_order_relaxed); }
+
+    // Any thread. `why` must outlive the writer (a string literal); false if
+    // this isn't a recorder or a dump is already under way.
+    bool trigger(const char* why);
+    [[nodiscard]] bool        recorder() const { return post_seconds_ > 0; }
+    [[nodiscard]] bool        armed() const { return recorder() && !pending_.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t triggers() const { return triggers_.load(std::memory_order_relaxed); }
+    [[nodiscard]] const char* last_trigger() const { return why_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void record();
+    void dump_triggered();
+    bool drain_once();
+    bool write_ring(DumpRing& ring, std::uint32_t iface);
+    void open_next();
+    void close_file();
+    [[nodiscard]] bool file_open() const { return fd_ >= 0 || ng_.is_open(); }
+    [[nodiscard]] std::string file_name(std::size_t index) const;
+
+    std::string                template_;
+    RotatePolicy               policy_;
+    std::vector<DumpRing*>     rings_;
+    std::vector<std::uint32_t> ring_ifaces_;
+    std::vector<std::string>   ifaces_;
+    std::vector<int>           linktypes_;
+    std::thread                thread_;
+    std::atomic<bool>          stop_{false};
+
+    int                      fd_           = -1;
+    int                      snaplen_      = 0;
+    bool                     nano_         = false;
+    int                      level_        = -1;    // pcapng compression level, -1: classic pcap
+    PcapngFile               ng_;
+    std::size_t              index_        = 0;
+    std::size_t              file_bytes_   = 0;
+    std::size_t              file_packets_ = 0;
+    std::int64_t             file_opened_  = 0;
+    std::deque<std::string>  kept_;          // files written so far, oldest first
+    int                      pre_seconds_  = 0;
+    int                      post_seconds_ = 0;     // 0: not a recorder
+    std::uint32_t            skip_before_  = 0;     // records stamped earlier are dropped unwritten
+
+    std::atomic<std::size_t> files_{0};
+    std::atomic<std::size_t> bytes_{0};
+    std::atomic<bool>        pending_{false};       // triggered, dump not finished yet
+    std::atomic<std::size_t> triggers_{0};
+    std::atomic<const char*> why_{nullptr};
+};
@@ -0,0 +1,152 @@
+//
+// Created by Shaunik Musukula on 7/26/25.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+struct z_stream_s;
+
+constexpr std::size_t   PCAPNG_BLOCK_BYTES   = 1 << 20;     // packet blocks compressed together as one gzip member
+constexpr std::size_t   PCAPNG_IN_FLIGHT     = 4;           // full blocks waiting for the compressor
+constexpr int           PCAPNG_FLUSH_MS      = 1'000;       // a partly filled block waits no longer than this
+constexpr std::size_t   PCAPNG_TRAILER_BYTES = 63;          // the last gzip member, which points at the index
+
+constexpr std::uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+constexpr std::uint32_t PCAPNG_IDB = 0x00000001;
+constexpr std::uint32_t PCAPNG_EPB = 0x00000006;
+constexpr std::uint32_t PCAPNG_CB  = 0x40000BAD;            // custom block, not to be copied: it holds file offsets
+
+// One gzip member of packet blocks, as listed in the file's index.
+struct PcapngIndexEntry {
+    std::uint64_t offset;       // of the member in the file
+    std::uint32_t length;       // compressed
+    std::uint32_t raw_length;   // decompressed
+    std::uint32_t packets;
+    std::uint32_t pad;
+    std::int64_t  min_ns;       // packets from several rings interleave, so ranges may overlap
+    std::int64_t  max_ns;
+};
+
+// Writes a pcapng file as a series of gzip members: the section and
+// interface blocks first, then about PCAPNG_BLOCK_BYTES of packet blocks
+// each, compressed on a thread of its own, and last an index of the members
+// and their time ranges plus a fixed-size trailer pointing at it. Any gzip
+// reader sees one ordinary pcapng file; PcapngReader uses the index to
+// decompress only the members a time range needs.
+//
+// The index and trailer are private to this program: their custom blocks
+// carry enterprise number 0, which IANA reserves, since the sniffer has no
+// registered one, and are told apart by a magic string instead. Other tools
+// skip custom blocks they don't know and, the type being 0x4000xxxx, won't
+// copy them into files they write; don't expect anything else to read them.
+// Each interface block has the link type of its own interface.
+class PcapngFile {
+public:
+    PcapngFile();
+    PcapngFile(const PcapngFile&) = delete;
+    PcapngFile& operator=(const PcapngFile&) = delete;
+    ~PcapngFile();
+
+    // linktypes[i] belongs to ifaces[i]; `written` counts compressed bytes as
+    // they reach the disk; false if the file can't be created
+    bool open(const std::string& path, const std::vector<std::string>& ifaces, const std::vector<int>& linktypes,
+              int snaplen, bool nano, int level, std::atomic<std::size_t>* written);
+    void close();
+    [[nodiscard]] bool is_open() const { return fd_ >= 0; }
+
+    // one packet from a DumpRing record; its bytes may wrap, hence two pieces
+    void add(std::uint32_t iface, const std::uint32_t rec[4], const std::uint8_t* a, std::size_t a_len,
+             const std::uint8_t* b, std::size_t b_len);
+
+    // hands a partly filled block to the compressor once it is PCAPNG_FLUSH_MS old
+    void flush_stale();
+
+private:
+    struct Block {
+        std::vector<std::uint8_t> raw;
+        std::uint32_t             packets = 0;
+        std::int64_t              min_ns  = 0;
+        std::int64_t              max_ns  = 0;
+    };
+
+    void submit();
+    void run();
+    bool write_member(const std::uint8_t* p, std::size_t n, PcapngIndexEntry* e);
+    bool write_all(const void* p, std::size_t n);
+
+    int                                    fd_      = -1;
+    bool                                   nano_    = false;
+    std::atomic<std::size_t>*              written_ = nullptr;
+    std::unique_ptr<z_stream_s>            zs_;
+    std::vector<std::uint8_t>              out_;            // the compressor's, while it runs
+    std::uint64_t                          offset_  = 0;
+    bool                                   failed_  = false;
+    std::vector<PcapngIndexEntry>          index_;
+
+    Block                                  cur_;            // the writer's
+    std::int64_t                           cur_opened_ms_ = 0;
+
+    std::mutex                             mu_;             // guards the queue, spare_ and done_
+    std::condition_variable                cv_;
+    std::deque<Block>                      queue_;
+    std::vector<std::vector<std::uint8_t>> spare_;          // buffers the compressor is done with
+    bool                                   done_    = false;
+    std::thread                            thread_;
+};
+
+// Reads the files PcapngFile writes, by gzip member.
+class PcapngReader {
+public:
+    PcapngReader() = default;
+    PcapngReader(const PcapngReader&) = delete;
+    PcapngReader& operator=(const PcapngReader&) = delete;
+    ~PcapngReader();
+
+    // false if `path` isn't one of these files; `err` says what is wrong if
+    // it looked like one but is damaged
+    bool open(const char* path, std::string& err);
+
+    [[nodiscard]] int  linktype() const { return linktypes_.front(); }       // the first interface's
+    [[nodiscard]] const std::vector<int>& linktypes() const { return linktypes_; }
+    [[nodiscard]] int  snaplen() const { return snaplen_; }
+    [[nodiscard]] bool nano() const { return nano_; }
+    [[nodiscard]] const std::vector<PcapngIndexEntry>& index() const { return index_; }
+    [[nodiscard]] std::int64_t first_ns() const;
+
+    // decompresses member i and passes every packet in it to `cb`, with
+    // packet_linktype() set to its interface's; false if the member is damaged
+    bool read_block(std::size_t i, pcap_handler cb, std::uint8_t* user);
+    [[nodiscard]] int packet_linktype() const { return packet_linktype_; }
+
+private:
+    bool read_member(std::uint64_t offset, std::size_t length, std::size_t raw_hint);
+
+    int                           fd_              = -1;
+    std::vector<int>              linktypes_;                   // by interface id
+    int                           packet_linktype_ = 0;
+    int                           snaplen_         = 0;
+    bool                          nano_            = false;
+    std::vector<PcapngIndexEntry> index_;
+    std::vector<std::uint8_t>     in_;
+    std::vector<std::uint8_t>     out_;
+};
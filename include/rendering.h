@@ -8,12 +8,31 @@
 
 extern WINDOW* wStats;
 extern WINDOW* wTable;
+extern WINDOW* wFlows;
 extern WINDOW* wHex;
+extern WINDOW* wInstr;
 
-constexpr int  MAX_ROWS      = 1'000;
-constexpr auto DISPATCH_BULK = 64;
-constexpr auto UI_NAP_MS     = 35;
+constexpr auto UI_NAP_MS     = 35;      // longest wait between queue drains
+constexpr auto FLOWS_MIN_W   = 72;
+constexpr auto INSTR_H       = 9;
+
+// Frame pacing: quick while keys are arriving, a steady rate while only the
+// data is changing, and nothing at all when no pane is damaged.
+constexpr auto FRAME_INPUT_MS = 16;
+constexpr auto FRAME_LIVE_MS  = 100;
+constexpr auto INPUT_BURST_MS = 300;     // how long after a key press frames stay quick
+
+// What changed since the last frame. Panes are redrawn only when damaged, and
+// the table only rewrites rows whose packet or highlight moved.
+constexpr unsigned DAMAGE_STATS  = 1u << 0;
+constexpr unsigned DAMAGE_TABLE  = 1u << 1;
+constexpr unsigned DAMAGE_FLOWS  = 1u << 2;
+constexpr unsigned DAMAGE_HEX    = 1u << 3;   // or the rates pane in its place
+constexpr unsigned DAMAGE_SKETCH = 1u << 4;   // sketch lines in the stats bar, merged once a second
+constexpr unsigned DAMAGE_FULL   = 1u << 5;   // windows rebuilt or drawn over: start from blank
+constexpr unsigned DAMAGE_INSTR  = 1u << 6;
+constexpr unsigned DAMAGE_ALL    = 0x7F;
 
 void init_windows(int H, int W);
 
-void refresh_render();
+void refresh_render(unsigned damage = DAMAGE_ALL);
@@ -0,0 +1,59 @@
+//
+// Created by Shaunik Musukula on 7/20/25.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr std::size_t NO_MATCH = ~std::size_t{0};
+
+// A byte pattern to look for in payloads, written one of three ways:
+//   GET /index      the bytes as typed; \xNN, \r, \n, \t and \\ escapes work
+//   x:16 03 01      hex bytes, spaces optional
+//   i:user-agent    ASCII, case-insensitive
+// find() filters 16 positions at a time on the pattern's first and last byte
+// with SSE2 and only compares the middle where both match, so it runs near
+// memory speed on ordinary payloads.
+class Pattern {
+public:
+    // false with `err` set if the text isn't a valid pattern
+    static bool parse(const std::string& text, Pattern& out, std::string& err);
+
+    // offset of the first match in hay[0, n), or NO_MATCH
+    [[nodiscard]] std::size_t find(const std::uint8_t* hay, std::size_t n) const;
+
+    [[nodiscard]] std::size_t        size() const { return bytes_.size(); }
+    [[nodiscard]] const std::string& text() const { return text_; }
+
+private:
+    [[nodiscard]] bool equal(const std::uint8_t* at, std::size_t from, std::size_t to) const;
+    [[nodiscard]] std::size_t find_scalar(const std::uint8_t* hay, std::size_t from, std::size_t n) const;
+
+    std::vector<std::uint8_t> bytes_;    // folded to lower case when nocase_
+    bool                      nocase_ = false;
+    std::string               text_;
+};
+
+// The pattern the capture threads count matches of, nullptr for none. Set by
+// the UI; a replaced pattern is never freed, since a capture thread may still
+// be reading it and patterns are few and small.
+extern std::atomic<const Pattern*> gMatch;
+
+// UI side: the pattern being searched for and highlighted, and the match
+// counter's value when it was set
+extern Pattern     gSearch;
+extern bool        gSearching;
+extern std::size_t gMatchBase;
+
+// copies `p` for the capture threads; nullptr stops counting
+void set_live_match(const Pattern* p);
+
+// Searches the retained payloads of the table's rows, starting at row `from`
+// and going towards older rows (`older`) or newer ones. Returns the row index
+// or NO_MATCH.
+std::size_t search_history(const Pattern& p, std::size_t from, bool older);
@@ -0,0 +1,44 @@
+//
+// Created by Shaunik Musukula on 7/14/25.
+//
+
+#pragma once
+
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer snapshot of a trivially copyable value. The writer never waits;
+// readers retry if the value changed under them.
+template <typename T>
+class SeqLocked {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLocked needs a trivially copyable type");
+
+public:
+    // writer side
+    void store(const T& v) {
+        const unsigned s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&value_, &v, sizeof(T));
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // reader side
+    [[nodiscard]] T load() const {
+        T out;
+        while (true) {
+            const unsigned s1 = seq_.load(std::memory_order_acquire);
+            if (s1 & 1) continue;
+            std::memcpy(&out, &value_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == s1) return out;
+        }
+    }
+
+private:
+    alignas(CACHE_LINE) std::atomic<unsigned> seq_{0};
+    T                                         value_{};
+};
@@ -0,0 +1,208 @@
+//
+// Created by Shaunik Musukula on 7/15/25.
+//
+
+#pragma once
+
+#include "hash.h"
+#include "packet_ring.h"
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+constexpr std::size_t TOP_HITTERS = 16;
+
+// Distinct-count estimate in 2^bits one-byte registers. Merging two sketches
+// of the same size gives the sketch of the union of their streams.
+class HyperLogLog {
+public:
+    explicit HyperLogLog(const int bits) : bits_(bits), regs_(bits ? std::size_t{1} << bits : 0) {}
+
+    void add(const std::uint64_t h) {
+        if (regs_.empty()) return;
+        const std::size_t   idx  = h >> (64 - bits_);
+        const std::uint64_t rest = h << bits_;
+        const auto          rank = static_cast<std::uint8_t>(rest ? __builtin_clzll(rest) + 1 : 64 - bits_ + 1);
+        if (rank > regs_[idx]) regs_[idx] = rank;
+    }
+
+    void merge(const HyperLogLog& o);
+    void clear() { std::fill(regs_.begin(), regs_.end(), 0); }
+
+    [[nodiscard]] double estimate() const;
+    // relative standard error
+    [[nodiscard]] double error() const { return regs_.empty() ? 0 : 1.04 / std::sqrt(static_cast<double>(regs_.size())); }
+    [[nodiscard]] bool   enabled() const { return !regs_.empty(); }
+
+private:
+    int                       bits_;
+    std::vector<std::uint8_t> regs_;
+};
+
+// Count-Min sketch over DEPTH rows of `width` counters, plus the TOP_HITTERS
+// keys with the largest estimates. An estimate never undercounts and, with
+// probability 1 - e^-DEPTH, overcounts by at most e/width of all weight added.
+// Updating is a fixed number of counter bumps whatever the traffic looks like,
+// so spoofed or scanning sources cost no more than a handful of heavy ones.
+// Sketches of the same width merge by adding counters.
+template <typename Key>
+class CountMinTop {
+public:
+    static constexpr std::size_t DEPTH = 4;
+
+    struct Item {
+        Key           key;
+        std::uint64_t hash;
+        std::uint64_t count;
+    };
+
+    explicit CountMinTop(const std::size_t width)
+        : mask_(width ? round_pow2(width) - 1 : 0), rows_(width ? DEPTH * (mask_ + 1) : 0) {}
+
+    void add(const Key& key, const std::uint64_t w = 1) { add(key, hash64(&key, sizeof(Key)), w); }
+
+    // `h` must be hash64() of the key; lets callers share one hash between sketches
+    void add(const Key& key, const std::uint64_t h, const std::uint64_t w) {
+        if (rows_.empty()) return;
+        total_ += w;
+        std::uint64_t est = ~0ull;
+        for (std::size_t d = 0; d < DEPTH; ++d) {
+            std::uint64_t& c = rows_[d * (mask_ + 1) + slot(h, d)];
+            c  += w;
+            est = std::min(est, c);
+        }
+        if (n_top_ == TOP_HITTERS && est <= top_[min_at_].count) return;
+        offer(key, h, est);
+    }
+
+    [[nodiscard]] std::uint64_t estimate(const std::uint64_t h) const {
+        std::uint64_t est = ~0ull;
+        for (std::size_t d = 0; d < DEPTH; ++d) est = std::min(est, rows_[d * (mask_ + 1) + slot(h, d)]);
+        return est;
+    }
+
+    // both sides must have the same width; candidates are re-estimated on the sum
+    void merge(const CountMinTop& o) {
+        if (rows_.size() != o.rows_.size()) return;
+        for (std::size_t i = 0; i < rows_.size(); ++i) rows_[i] += o.rows_[i];
+        total_ += o.total_;
+        for (std::size_t i = 0; i < n_top_; ++i) top_[i].count = estimate(top_[i].hash);
+        recompute_min();
+        for (std::size_t i = 0; i < o.n_top_; ++i) offer(o.top_[i].key, o.top_[i].hash, estimate(o.top_[i].hash));
+    }
+
+    void clear() {
+        std::fill(rows_.begin(), rows_.end(), 0);
+        total_ = 0;
+        n_top_ = 0;
+    }
+
+    // up to n heaviest keys, heaviest first
+    std::size_t top(Item* out, const std::size_t n) const {
+        const std::size_t m = std::min(n, n_top_);
+        std::partial_sort_copy(top_.begin(), top_.begin() + n_top_, out, out + m,
+                               [](const Item& a, const Item& b) { return a.count > b.count; });
+        return m;
+    }
+
+    [[nodiscard]] std::uint64_t total()   const { return total_; }
+    [[nodiscard]] bool          enabled() const { return !rows_.empty(); }
+    // worst-case overcount as a fraction of total()
+    [[nodiscard]] double        error()   const { return rows_.empty() ? 0 : 2.718'281'828 / static_cast<double>(mask_ + 1); }
+
+private:
+    // double hashing: row d probes h1 + d * h2
+    [[nodiscard]] std::size_t slot(const std::uint64_t h, const std::size_t d) const {
+        const auto h1 = static_cast<std::uint32_t>(h);
+        const auto h2 = static_cast<std::uint32_t>(h >> 32) | 1u;
+        return (h1 + d * h2) & mask_;
+    }
+
+    void offer(const Key& key, const std::uint64_t h, const std::uint64_t est) {
+        for (std::size_t i = 0; i < n_top_; ++i) {
+            if (top_[i].hash == h && std::memcmp(&top_[i].key, &key, sizeof(Key)) == 0) {
+                top_[i].count = est;
+                if (i == min_at_) recompute_min();
+                return;
+            }
+        }
+        if (n_top_ < TOP_HITTERS) {
+            top_[n_top_++] = {key, h, est};
+        } else if (est > top_[min_at_].count) {
+            top_[min_at_] = {key, h, est};
+        } else {
+            return;
+        }
+        recompute_min();
+    }
+
+    void recompute_min() {
+        min_at_ = 0;
+        for (std::size_t i = 1; i < n_top_; ++i) if (top_[i].count < top_[min_at_].count) min_at_ = i;
+    }
+
+    std::size_t                   mask_;
+    std::vector<std::uint64_t>    rows_;      // DEPTH rows back to back
+    std::uint64_t                 total_  = 0;
+    std::array<Item, TOP_HITTERS> top_{};
+    std::size_t                   n_top_  = 0;
+    std::size_t                   min_at_ = 0;
+};
+
+struct HostKey {
+    IpAddr       addr;
+    std::uint8_t family;
+    std::uint8_t pad[7];
+};
+
+// Constant-memory view of the traffic: heaviest hosts and ports by packets,
+// and how many distinct hosts and flows were seen.
+struct TrafficSketch {
+    CountMinTop<HostKey>       src;
+    CountMinTop<HostKey>       dst;
+    CountMinTop<std::uint16_t> sport;
+    CountMinTop<std::uint16_t> dport;
+    HyperLogLog                hosts;
+    HyperLogLog                flows;
+
+    TrafficSketch(std::size_t width, int hll_bits);
+
+    void add(const PacketRecord& r);
+    void merge(const TrafficSketch& o);
+    void clear();
+};
+
+// A shard's live sketch plus a copy the UI may read. The capture thread
+// republishes once per second of packet time; readers retry if they raced a
+// publish, as with SeqLocked.
+class ShardSketch {
+public:
+    ShardSketch(const std::size_t width, const int hll_bits) : live_(width, hll_bits), shown_(width, hll_bits) {}
+
+    // capture side
+    void add(const PacketRecord& r) {
+        live_.add(r);
+        dirty_ = true;
+        if (r.ts.tv_sec != published_sec_) {
+            published_sec_ = r.ts.tv_sec;
+            publish();
+        }
+    }
+    void publish();                 // no-op if nothing was added since the last one
+
+    // any thread; `out` must have been built with the same width and bits
+    void load(TrafficSketch& out) const;
+
+private:
+    TrafficSketch                             live_;
+    time_t                                    published_sec_ = 0;
+    bool                                      dirty_         = false;
+    alignas(CACHE_LINE) std::atomic<unsigned> seq_{0};
+    TrafficSketch                             shown_;
+};
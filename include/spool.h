@@ -0,0 +1,65 @@
+//
+// Created by Shaunik Musukula on 7/19/25.
+//
+
+#pragma once
+
+#include "packet_ring.h"
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr std::size_t SPOOL_INDEX_SHARE = 4;    // 1/4 of the spool holds index entries, the rest payload
+
+// Every row the UI takes off the capture queues, written to one unlinked
+// temporary file that is memory-mapped as two rings: fixed-size index entries
+// (the row itself, its payload offset pointing into the spool) and the payload
+// bytes. Entry n is row number n, so finding any row is one multiplication.
+// Both rings overwrite their oldest contents, so --spool-size bounds the disk
+// used and the page cache, not the sniffer, decides how much stays in RAM.
+// UI thread only.
+class Spool {
+public:
+    Spool() = default;
+    Spool(const Spool&)            = delete;
+    Spool& operator=(const Spool&) = delete;
+    ~Spool() { close(); }
+
+    // false with gErr set; the space is reserved up front so a full disk shows up here, not as SIGBUS later
+    bool open(const char* dir, std::size_t bytes);
+    void close();
+    void reset() { count_ = 0; data_head_ = 0; }
+
+    // `src` is the arena holding the row's payload, nullptr if it has none
+    void append(const PacketRecord& r, const PayloadRing* src);
+
+    [[nodiscard]] bool        enabled()  const { return map_ != nullptr; }
+    [[nodiscard]] std::size_t count()    const { return count_; }
+    [[nodiscard]] std::size_t retained() const { return count_ < slots_ ? count_ : slots_; }
+
+    // row number n, which must be one of the last retained() rows
+    [[nodiscard]] const PacketRecord& row(const std::size_t n) const { return index_[n % slots_]; }
+    // false once newer payload has overwritten it
+    bool payload(const PacketRecord& r, std::uint8_t* out) const;
+
+private:
+    int           fd_        = -1;
+    std::uint8_t* map_       = nullptr;
+    std::size_t   map_len_   = 0;
+    PacketRecord* index_     = nullptr;
+    std::size_t   slots_     = 0;
+    std::uint8_t* data_      = nullptr;
+    std::size_t   data_cap_  = 0;
+    std::uint64_t data_head_ = 0;
+    std::size_t   count_     = 0;
+};
+
+// The rows the table can scroll through, newest first: the in-memory rows,
+// then whatever the spool still has behind them.
+std::size_t         history_size();
+const PacketRecord& history_row(std::size_t i);
+// payload of the i-th newest row, from its capture arena while it is still
+// there and from the spool after that; false if both have moved on
+bool                history_payload(std::size_t i, std::uint8_t* out);
+// newest row captured at or before `ts`, or the oldest row if all are later
+std::size_t         history_find(const timeval& ts);
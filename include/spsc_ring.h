@@ -0,0 +1,74 @@
+//
+// Created by Shaunik Musukula on 7/8/25.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+constexpr std::size_t CACHE_LINE = 64;
+
+// Bounded single-producer/single-consumer queue. The producer only writes
+// head_, the consumer only writes tail_; each side keeps a cached copy of the
+// other index so the shared cache lines are touched once per batch, not per item.
+template <typename T, std::size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    static constexpr std::size_t capacity = N;
+
+    // producer side
+    bool push(T&& v) {
+        const std::size_t h = head_.load(std::memory_order_relaxed);
+        if (h - tail_cache_ == N) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (h - tail_cache_ == N) return false;
+        }
+        buf_[h & (N - 1)] = std::move(v);
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T& out) {
+        const std::size_t t = tail_.load(std::memory_order_relaxed);
+        if (t == head_cache_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t == head_cache_) return false;
+        }
+        out = std::move(buf_[t & (N - 1)]);
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, oldest item or nullptr
+    [[nodiscard]] const T* peek() {
+        const std::size_t t = tail_.load(std::memory_order_relaxed);
+        if (t == head_cache_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t == head_cache_) return nullptr;
+        }
+        return &buf_[t & (N - 1)];
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // only valid while the producer is stopped
+    void clear() {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+        head_cache_ = tail_cache_ = tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(CACHE_LINE) std::atomic<std::size_t> head_{0};
+    std::size_t                                  tail_cache_{0};
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail_{0};
+    std::size_t                                  head_cache_{0};
+    alignas(CACHE_LINE) std::array<T, N>         buf_{};
+};
@@ -4,9 +4,21 @@
 
 #pragma once
 
+#include "dns.h"
+#include "flow_table.h"
+#include "instrument.h"
 #include "netdev_lookup.h"
+#include "packet_ring.h"
+#include "pcap_writer.h"
+#include "sketch.h"
+#include "spool.h"
+#include "spsc_ring.h"
+#include "stats.h"
 #include <vector>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,51 +30,136 @@ extern "C" {
 }
 #endif
 
-struct Row {
-    std::string               ts;
-    std::string               src;
-    std::string               dst;
-    std::string               proto;
-    std::size_t               len{};
-    std::vector<std::uint8_t> payload;
-};
+constexpr std::size_t MAX_ROWS           = 1 << 20;
+constexpr std::size_t ROW_QUEUE_CAP      = 1 << 16;
+constexpr std::size_t MAX_SHARDS         = 256;        // PacketRecord::shard is one byte
 
-struct Counters {
-    std::atomic<std::size_t> all{0}, tcp{0}, udp{0}, icmp{0}, other{0}, bytes{0};
-    void clear() { all = tcp = udp = icmp = other = bytes = 0; }
+// The BPF filter attached to every capture handle and what it has kept away
+// from us. `seen` is read from the interface's own counters where the platform
+// has them (0 when unknown); `kept` is what the kernel still delivered.
+struct FilterState {
+    std::string expr;           // empty = no filter
+    std::string error;          // why the last attempt to set a filter failed
+    int         insns   = 0;    // BPF instructions run per packet
+    std::size_t seen    = 0;    // since the filter was set
+    std::size_t kept    = 0;
+    std::size_t seen_ps = 0;    // during the last second
+    std::size_t kept_ps = 0;
 };
 
 enum class LimitKind { kNone, kPackets, kBytes, kSeconds };
 
+// Packet and byte limits are shared by all shards through one claim counter, so
+// the total is exact no matter how traffic is spread. A time limit runs on the
+// capture timestamps from the first packet admitted, so packets never cost a
+// clock read; tick() ends it by the wall clock when the link is quiet. With no
+// limit set the shards never touch it.
 struct CaptureLimit {
     LimitKind kind   = LimitKind::kNone;
     std::size_t                                    target = 0;
     std::chrono::steady_clock::time_point          start  = {};
+    std::atomic<std::size_t>                       used{0};
+    std::atomic<std::int64_t>                      first_ns{0};     // kSeconds: stamp of the first packet
+    std::atomic<bool>                              expired{false};  // kSeconds
+
+    void reset() { set(LimitKind::kNone, 0); }
+
+    // only while capture is stopped
+    void set(const LimitKind k, const std::size_t n) {
+        kind     = k;
+        target   = n;
+        start    = std::chrono::steady_clock::now();
+        used     = 0;
+        first_ns = 0;
+        expired  = false;
+    }
 
-    void reset() { kind = LimitKind::kNone; target = 0; }
+    // capture side: false once the packet would go past the limit
+    [[nodiscard]] bool admit(const pcap_pkthdr* h, const bool nano) {
+        switch (kind) {
+            case LimitKind::kPackets: return used.fetch_add(1,      std::memory_order_relaxed) < target;
+            case LimitKind::kBytes:   return used.fetch_add(h->len, std::memory_order_relaxed) < target;
+            case LimitKind::kSeconds: return admit_at(ts_to_ns(h->ts, nano));
+            default: return true;
+        }
+    }
 
-    [[nodiscard]] bool hit(const Counters &c) const {
-        using clock = std::chrono::steady_clock;
+    [[nodiscard]] bool hit() const {
         switch (kind) {
-            case LimitKind::kPackets: return c.all   >= target;
-            case LimitKind::kBytes:   return c.bytes >= target;
-            case LimitKind::kSeconds:
-                return std::chrono::duration_cast<std::chrono::seconds>(clock::now() - start).count() >= target;
+            case LimitKind::kPackets:
+            case LimitKind::kBytes:   return used.load(std::memory_order_relaxed) >= target;
+            case LimitKind::kSeconds: return expired.load(std::memory_order_relaxed);
             default: return false;
         }
     }
+
+    // UI side, live capture only
+    void tick() {
+        if (kind == LimitKind::kSeconds && std::chrono::steady_clock::now() - start >= std::chrono::seconds(target)) {
+            expired.store(true, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    bool admit_at(const std::int64_t ns) {
+        std::int64_t first = first_ns.load(std::memory_order_relaxed);
+        if (first == 0 && first_ns.compare_exchange_strong(first, ns, std::memory_order_relaxed)) first = ns;
+        if (ns - first < static_cast<std::int64_t>(target) * 1'000'000'000) return true;
+        expired.store(true, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+// One capture socket, on one of the captured interfaces, and the thread
+// draining it. Everything in here is written by that thread alone; the UI pops
+// `queue` and reads `payload`, `cnt`, the DNS counters and the published flow
+// and sketch snapshots, the pcap writer drains `dump`.
+struct CaptureShard {
+    pcap_t*                               handle   = nullptr;
+    int                                   linktype = DLT_EN10MB;
+    std::uint8_t                          id       = 0;       // index in gShards
+    std::uint8_t                          dev      = 0;       // index in gCapDevs
+    Counters                              cnt;
+    SpscRing<PacketRecord, ROW_QUEUE_CAP> queue;
+    PayloadRing                           payload;
+    DumpRing                              dump;
+    FlowTable                             flows;
+    DnsTracker                            dns;
+    ShardSketch                           sketch;
+    ShardInstruments                      instr;
+    timeval                               merged{};           // UI side: stamp of the last row taken from queue
+
+    CaptureShard(const std::size_t payload_bytes, const std::size_t dump_bytes, const std::size_t flow_slots,
+                 const int flow_timeout_s, const std::size_t reasm_bytes, const std::size_t dns_slots,
+                 const int dns_timeout_s, const std::size_t sketch_width, const int hll_bits)
+        : payload(payload_bytes), dump(dump_bytes), flows(flow_slots, flow_timeout_s, reasm_bytes),
+          dns(dns_slots, dns_timeout_s), sketch(sketch_width, hll_bits) {}
 };
 
-extern std::vector<Row>             gRows;
-extern Counters                     gCnt;
-extern bool                         gPaused;
-extern bool                         gShowHex;
-extern std::vector<DeviceMapping>   gDevices;
-extern std::size_t                  gCurDev;
-extern pcap_t*                      gHandle;
-extern pcap_dumper_t*               gDumper;
-extern char                         gErr[PCAP_ERRBUF_SIZE];
-extern std::size_t                  gSelected;
-extern std::size_t                  gFirstVis;
-extern CaptureLimit                 gCapLim;
-extern std::size_t                  gBps;
\ No newline at end of file
+// Ownership:
+//  - capture threads: their own CaptureShard while capture is running
+//  - writer thread:   the consumer side of every shard's DumpRing
+//  - UI thread:       gRows, gSpool, gSelected, gFirstVis, gRates, gRenderLat, the consumer side
+//                     of every shard, its instr.depth and `merged`
+//  - gShards, gCapLim (apart from `used`), gDevices, gCapDevs, gNanoTs and the
+//    filter are only changed by the UI while capture is stopped
+extern PacketRing                                 gRows;
+extern Spool                                      gSpool;
+extern std::vector<std::unique_ptr<CaptureShard>> gShards;
+extern std::atomic<bool>                          gPaused;
+extern std::atomic<bool>                          gShowHex;
+extern std::vector<DeviceMapping>                 gDevices;
+extern std::vector<std::size_t>                   gCapDevs;         // gDevices being captured, in order
+extern PcapWriter                                 gWriter;
+extern char                                       gErr[PCAP_ERRBUF_SIZE];
+extern std::size_t                                gSelected;
+extern std::size_t                                gFirstVis;
+extern CaptureLimit                               gCapLim;
+extern RateHistory                                gRates;
+extern bool                                       gNanoTs;
+extern bool                                       gShowFlows;
+extern bool                                       gFlowsByRate;
+extern bool                                       gShowRates;
+extern bool                                       gShowInstr;
+extern Histogram                                  gRenderLat;       // ns per frame that drew anything
+extern FilterState                                gFilter;
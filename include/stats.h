@@ -0,0 +1,121 @@
+//
+// Created by Shaunik Musukula on 7/18/25.
+//
+
+#pragma once
+
+#include "packet_ring.h"
+#include "spsc_ring.h"
+#include "tcp_analysis.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+constexpr std::size_t N_PROTO      = 6;         // values of Proto
+constexpr std::size_t SIZE_BUCKETS = 7;
+constexpr std::size_t HISTORY_SECS = 3'600;
+
+// RMON etherStats size classes: <=64, 65-127, 128-255, 256-511, 512-1023,
+// 1024-1518 and anything larger (jumbo or offloaded segments).
+constexpr std::uint32_t SIZE_BOUNDS[SIZE_BUCKETS - 1] = {64, 127, 255, 511, 1'023, 1'518};
+constexpr const char*   SIZE_LABELS[SIZE_BUCKETS]     = {"<=64", "65-127", "128-255", "256-511",
+                                                         "512-1023", "1024-1518", ">1518"};
+
+inline std::size_t size_bucket(const std::uint32_t len) {
+    std::size_t b = 0;
+    while (b < SIZE_BUCKETS - 1 && len > SIZE_BOUNDS[b]) ++b;
+    return b;
+}
+
+// One capture shard's counters. Written only by the owning capture thread and
+// read by anyone, so a bump is a relaxed load and store rather than a locked
+// read-modify-write. Each shard's block starts on its own cache line, so
+// threads never write to a line another thread is writing. Totals are derived
+// from the per-protocol arrays when read, which keeps a packet at three bumps.
+struct alignas(CACHE_LINE) Counters {
+    std::atomic<std::size_t> pkts[N_PROTO]{};
+    std::atomic<std::size_t> bytes[N_PROTO]{};
+    std::atomic<std::size_t> sizes[SIZE_BUCKETS]{};
+    std::atomic<std::size_t> dropped{0};
+    std::atomic<std::size_t> delivered{0};      // everything past the kernel filter, paused or not
+    std::atomic<std::size_t> matches{0};        // packets whose payload contains gMatch
+    std::atomic<std::size_t> rsts{0};           // TCP segments with RST set
+    std::atomic<std::size_t> retrans{0};        // TCP segments, as classified by the flow tables
+    std::atomic<std::size_t> ooo{0};
+    std::atomic<std::size_t> dup_acks{0};
+    std::atomic<std::size_t> zero_wins{0};
+
+    void clear();
+
+    // TCP_EV_* bits from the flow table
+    void tcp_events(const std::uint8_t ev) {
+        if (ev & TCP_EV_RETRANS)  bump(retrans);
+        if (ev & TCP_EV_OOO)      bump(ooo);
+        if (ev & TCP_EV_DUP_ACK)  bump(dup_acks);
+        if (ev & TCP_EV_ZERO_WIN) bump(zero_wins);
+    }
+
+    static void bump(std::atomic<std::size_t>& c, const std::size_t n = 1) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void count(const Proto p, const std::uint32_t len) {
+        const auto i = static_cast<std::size_t>(p);
+        bump(pkts[i]);
+        bump(bytes[i], len);
+        bump(sizes[size_bucket(len)]);
+    }
+};
+
+// Plain sum of every shard's Counters, taken when the UI needs numbers.
+struct CounterTotals {
+    std::size_t pkts[N_PROTO]{};
+    std::size_t bytes[N_PROTO]{};
+    std::size_t sizes[SIZE_BUCKETS]{};
+    std::size_t all = 0, total_bytes = 0, dropped = 0, delivered = 0, dump_dropped = 0, matches = 0, rsts = 0;
+    std::size_t retrans = 0, ooo = 0, dup_acks = 0, zero_wins = 0;
+
+    void add(const Counters& c);
+
+    [[nodiscard]] std::size_t of(const Proto p) const { return pkts[static_cast<std::size_t>(p)]; }
+};
+
+// Traffic during one tick of the UI clock, nominally a second.
+struct RateSample {
+    std::time_t   at;           // wall clock at the end of the interval
+    double        secs;
+    std::uint64_t pkts[N_PROTO];
+    std::uint64_t bytes[N_PROTO];
+    std::uint64_t all_pkts;
+    std::uint64_t all_bytes;
+    std::uint64_t rsts;
+
+    [[nodiscard]] double pps() const { return secs > 0 ? static_cast<double>(all_pkts) / secs : 0; }
+    [[nodiscard]] double bps() const { return secs > 0 ? static_cast<double>(all_bytes) / secs : 0; }
+};
+
+// The last HISTORY_SECS samples, oldest overwritten first. Owned by the UI
+// thread, which feeds it the running totals once a second.
+class RateHistory {
+public:
+    RateHistory() : buf_(HISTORY_SECS) {}
+
+    void sample(const CounterTotals& now, double secs);
+    void reset();
+
+    [[nodiscard]] std::size_t size() const { return n_; }
+    [[nodiscard]] bool        empty() const { return n_ == 0; }
+    // i = 0 is the latest sample
+    [[nodiscard]] const RateSample& recent(const std::size_t i) const {
+        return buf_[(head_ + HISTORY_SECS - 1 - i) % HISTORY_SECS];
+    }
+
+private:
+    std::vector<RateSample> buf_;
+    std::size_t             head_ = 0;
+    std::size_t             n_    = 0;
+    CounterTotals           last_;
+    bool                    primed_ = false;
+};
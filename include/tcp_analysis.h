@@ -0,0 +1,111 @@
+//
+// Created by Shaunik Musukula on 7/24/25.
+//
+
+#pragma once
+
+#include "dissect.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+constexpr std::int64_t TCP_OOO_WINDOW_NS = 3'000'000;  // without an RTT estimate, how late a segment may still be reordered
+constexpr std::size_t  REASM_CHUNK       = 8 << 10;    // bytes kept of each direction of a reassembled stream
+constexpr std::size_t  REASM_RANGES      = 4;          // filled ranges past the contiguous prefix
+
+// What a segment was found to be, returned to the shard for its counters.
+constexpr std::uint8_t TCP_EV_RETRANS  = 0x01;
+constexpr std::uint8_t TCP_EV_OOO      = 0x02;
+constexpr std::uint8_t TCP_EV_DUP_ACK  = 0x04;
+constexpr std::uint8_t TCP_EV_ZERO_WIN = 0x08;
+
+// Round-trip samples of one kind, in microseconds. srtt is smoothed by 1/8
+// like the kernel's.
+struct RttStat {
+    std::uint32_t n;
+    std::uint32_t min_us;
+    std::uint32_t max_us;
+    std::uint32_t srtt_us;
+
+    void add(std::int64_t ns);
+};
+
+// One direction of a connection, as seen from its sender.
+struct TcpDir {
+    std::int64_t  last_new_ns;  // when the highest segment so far went past
+    std::int64_t  timed_ns;     // when the segment ending at timed_seq went past
+    std::uint64_t bytes;        // payload bytes, retransmissions not included
+    std::uint32_t isn;          // sequence number of the first payload byte
+    std::uint32_t next_seq;     // end of the highest segment so far
+    std::uint32_t timed_seq;
+    std::uint32_t last_ack;     // the last cumulative ACK this side sent
+    std::uint32_t retrans;
+    std::uint32_t ooo;
+    std::uint32_t dup_acks;
+    std::uint32_t zero_wins;    // times the advertised window closed
+    RttStat       rtt;          // data sent this way until the other side ACKed it
+    std::uint16_t last_win;
+    std::uint8_t  state;        // TD_* bits, private to the tracker
+
+    // reassembly: [0, contig) of the stream is in the buffer, plus `ranges`
+    std::uint32_t stream;       // TcpTracker buffer handle, 0 = none
+    std::uint32_t contig;
+    std::uint32_t ranges[REASM_RANGES][2];
+    std::uint8_t  n_ranges;
+};
+
+// Per-connection analysis. dir[0] is sent by the flow key's `a` side.
+struct TcpStats {
+    TcpDir        dir[2];
+    std::int64_t  syn_ns;
+    std::int64_t  synack_ns;
+    std::int64_t  hs_server_ns; // SYN to SYN-ACK: from the capture point to the server and back
+    std::int64_t  hs_client_ns; // SYN-ACK to ACK: the same towards the client
+    std::int64_t  request_ns;   // client data waiting for the server's answer, 0 = none
+    RttStat       response;     // client data to the first server data after it
+    std::uint8_t  client;       // dir index of the side that opened the connection
+    bool          client_known; // saw the SYN, rather than guessing by port
+};
+
+// TCP state for the connections of one flow table: a pool of TcpStats and,
+// with reassembly on, a pool of REASM_CHUNK buffers that hold the first bytes
+// of each direction. Both are sized up front, so memory never grows with the
+// traffic: connections beyond the pool are counted and left untracked.
+class TcpTracker {
+public:
+    TcpTracker(std::size_t max_conns, std::size_t reasm_bytes);
+
+    // handles are index + 1, 0 when the pool is exhausted
+    [[nodiscard]] std::uint32_t acquire();
+    void release(std::uint32_t h);
+
+    [[nodiscard]] TcpStats&       stats(const std::uint32_t h)       { return conns_[h - 1]; }
+    [[nodiscard]] const TcpStats& stats(const std::uint32_t h) const { return conns_[h - 1]; }
+    [[nodiscard]] const std::uint8_t* stream(const std::uint32_t s) const { return chunks_.get() + (s - 1) * REASM_CHUNK; }
+
+    // one segment sent by dir[s]; returns TCP_EV_* bits
+    std::uint8_t track(TcpStats& t, int s, const Decoded& d, const std::uint8_t* pkt, std::int64_t now_ns);
+
+    [[nodiscard]] std::size_t untracked()    const { return untracked_; }
+    [[nodiscard]] std::size_t reasm_denied() const { return denied_; }
+
+private:
+    template <typename T>
+    using Pool = std::unique_ptr<T[], decltype(&std::free)>;
+
+    void reassemble(TcpDir& dir, std::uint32_t seq, const std::uint8_t* data, std::uint32_t len);
+
+    std::size_t             max_conns_;
+    Pool<TcpStats>          conns_;
+    Pool<std::uint32_t>     free_conns_;    // stack of released handles
+    std::size_t             n_free_conns_;
+    std::size_t             conns_bumped_;  // handles handed out at least once
+    std::size_t             max_chunks_;
+    Pool<std::uint8_t>      chunks_;
+    Pool<std::uint32_t>     free_chunks_;
+    std::size_t             n_free_chunks_;
+    std::size_t             chunks_bumped_;
+    std::size_t             untracked_ = 0;
+    std::size_t             denied_    = 0;
+};
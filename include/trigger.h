@@ -0,0 +1,48 @@
+//
+// Created by Shaunik Musukula on 7/23/25.
+//
+
+#pragma once
+
+#include "state.h"
+#include "stats.h"
+
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// What makes the flight recorder dump besides the user ('r' or SIGUSR1): a
+// packet matching the trigger filter, checked by the capture threads, or a
+// packet or TCP RST rate crossing its threshold, checked on each rate sample.
+// Rate triggers fire on the way up and rearm once the rate has dropped back.
+struct Triggers {
+    bpf_program filter{};            // no instructions: no filter trigger
+    double      pps      = 0;        // 0 = off
+    double      rst_pps  = 0;
+    bool        over_pps = false;    // UI side: above the threshold at the last sample
+    bool        over_rst = false;
+};
+
+extern Triggers gTriggers;
+
+// Compiles gCfg.trigger_filter for the link type of a newly opened device;
+// false with gErr set if it doesn't compile.
+bool compile_trigger_filter(int linktype, int snaplen);
+
+// capture side, once the packet is in the recorder's ring
+inline void check_packet_trigger(const pcap_pkthdr* h, const std::uint8_t* pkt) {
+    if (gTriggers.filter.bf_insns && gWriter.armed() && pcap_offline_filter(&gTriggers.filter, h, pkt)) {
+        gWriter.trigger("filter");
+    }
+}
+
+// UI side, after every gRates.sample()
+void check_rate_triggers();
@@ -4,13 +4,29 @@
 
 #pragma once
 
+#include "flow_table.h"
+#include "packet_ring.h"
+
 #include <ncurses.h>
 
 #include <sstream>
 #include <string>
 
-std::string now_string();
+const char* proto_name(Proto p);
+
+void format_ts(const timeval& ts, bool nano, char* out, std::size_t n);
+
+void format_addr(std::uint8_t family, const IpAddr& a, char* out, std::size_t n);
+
+// "addr:port" ("[addr]:port" for IPv6) for TCP and UDP, the bare address otherwise
+void format_endpoint(const FlowEntry& e, bool src, char* out, std::size_t n);
 
 std::string human_bytes(std::size_t b);
 
+// 1234567 -> "1.2M"; for rates, where the exact figure only adds noise
+std::string human_count(double v);
+
+// 850 -> "850ns", 1234567 -> "1.2ms"
+std::string human_ns(std::uint64_t ns);
+
 void hex_line(WINDOW* w, int y, const std::uint8_t* d, std::size_t len, std::size_t off);
\ No newline at end of file
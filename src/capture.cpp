@@ -0,0 +1,379 @@
+//
+// Created by Shaunik Musukula on 7/8/25.
+//
+
+#include "capture.h"
+#include "pcap_helpers.h"
+#include "state.h"
+#include "options.h"
+
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static std::vector<std::thread> gCaptureThreads;
+static std::atomic<bool>        gStopCapture{false};
+static std::atomic<int>         gLiveShards{0};
+
+// pcap_stats() is cumulative since the handle was opened; on Linux ps_ifdrop
+// comes from the interface's own counters.
+static void poll_kernel_stats(CaptureShard* shard, const std::chrono::steady_clock::time_point now) {
+    if (now < shard->instr.next_kstats) return;
+    shard->instr.next_kstats = now + std::chrono::milliseconds{KSTATS_POLL_MS};
+
+    pcap_stat ps{};
+    if (pcap_stats(shard->handle, &ps) < 0) return;
+    shard->instr.k_recv.store(ps.ps_recv, std::memory_order_relaxed);
+    shard->instr.k_drop.store(ps.ps_drop, std::memory_order_relaxed);
+    shard->instr.k_ifdrop.store(ps.ps_ifdrop, std::memory_order_relaxed);
+    shard->instr.k_valid.store(true, std::memory_order_relaxed);
+}
+
+// Waits until any of a capture thread's handles has packets: epoll on Linux,
+// poll() elsewhere. A handle without a selectable fd is reported every time.
+class ReadySet {
+public:
+    explicit ReadySet(const std::vector<CaptureShard*>& shards) : ready_(shards.size()), fd_(shards.size()) {
+#ifdef __linux__
+        ep_ = epoll_create1(EPOLL_CLOEXEC);
+#endif
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            const int fd = fd_[i] = pcap_get_selectable_fd(shards[i]->handle);
+            if (fd < 0) always_.push_back(i);
+#ifdef __linux__
+            epoll_event ev{};
+            ev.events   = EPOLLIN;
+            ev.data.u64 = i;
+            if (fd >= 0 && (ep_ < 0 || epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) < 0)) always_.push_back(i);
+#else
+            if (fd >= 0) {
+                fds_.push_back({fd, POLLIN, 0});
+                idx_.push_back(i);
+            }
+#endif
+        }
+    }
+    ReadySet(const ReadySet&) = delete;
+    ReadySet& operator=(const ReadySet&) = delete;
+#ifdef __linux__
+    ~ReadySet() { if (ep_ >= 0) close(ep_); }
+#endif
+
+    // stops watching handle i, whose socket may report errors forever once
+    // its interface is gone
+    void remove(const std::size_t i) {
+        always_.erase(std::remove(always_.begin(), always_.end(), i), always_.end());
+#ifdef __linux__
+        if (ep_ >= 0 && fd_[i] >= 0) epoll_ctl(ep_, EPOLL_CTL_DEL, fd_[i], nullptr);
+#else
+        for (std::size_t k = 0; k < idx_.size(); ++k) {
+            if (idx_[k] != i) continue;
+            fds_.erase(fds_.begin() + static_cast<std::ptrdiff_t>(k));
+            idx_.erase(idx_.begin() + static_cast<std::ptrdiff_t>(k));
+            break;
+        }
+#endif
+    }
+
+    // ready()[i] says whether handle i has anything; returns after at most timeout_ms
+    const std::vector<char>& wait(const int timeout_ms) {
+        std::fill(ready_.begin(), ready_.end(), 0);
+        for (const std::size_t i : always_) ready_[i] = 1;
+        const int t = always_.empty() ? timeout_ms : 0;
+#ifdef __linux__
+        epoll_event ev[64];
+        const int   n = ep_ >= 0 ? epoll_wait(ep_, ev, 64, t) : 0;     // without epoll every handle is in always_
+        for (int k = 0; k < n; ++k) ready_[ev[k].data.u64] = 1;
+#else
+        if (poll(fds_.data(), fds_.size(), t) > 0) {
+            for (std::size_t k = 0; k < fds_.size(); ++k) if (fds_[k].revents) ready_[idx_[k]] = 1;
+        }
+#endif
+        return ready_;
+    }
+
+private:
+    std::vector<char>        ready_;
+    std::vector<std::size_t> always_;
+    std::vector<int>         fd_;
+#ifdef __linux__
+    int                      ep_ = -1;
+#else
+    std::vector<pollfd>      fds_;
+    std::vector<std::size_t> idx_;
+#endif
+};
+
+// One capture thread serves one worker's shard on every captured interface.
+// Each ready handle gets at most CAPTURE_BUDGET packets per round, so a busy
+// interface can't keep the thread from the others; one that had more waiting
+// goes again next round without the thread sleeping.
+static void capture_loop(const std::vector<CaptureShard*> shards) {
+    using clock = std::chrono::steady_clock;
+    ReadySet                       ready(shards);
+    std::vector<char>              live(shards.size(), 1), busy(shards.size(), 0);
+    std::vector<clock::time_point> next_sweep(shards.size());
+    std::size_t                    n_live   = shards.size();
+    bool                           any_busy = false;
+
+    while (n_live > 0 && !gStopCapture.load(std::memory_order_relaxed)) {
+        for (CaptureShard* s : shards) s->dump.sync();
+        const std::vector<char>& r   = ready.wait(any_busy ? 0 : CAPTURE_POLL_MS);
+        const auto               now = clock::now();
+        any_busy = false;
+
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            if (!live[i]) continue;
+            CaptureShard* s = shards[i];
+            int           n = 0;
+            if (r[i] || busy[i]) {
+                n = pcap_dispatch(s->handle, CAPTURE_BUDGET, packet_cb, reinterpret_cast<std::uint8_t* >(s));
+                if (n == PCAP_ERROR_BREAK) continue;     // a breakloop left over from the last stop_capture()
+                if (n < 0) {
+                    ready.remove(i);
+                    live[i] = 0;
+                    --n_live;
+                    --gLiveShards;
+                    continue;
+                }
+                if (n > 0) s->instr.batch.record(static_cast<std::uint64_t>(n));
+            }
+            busy[i]   = n >= CAPTURE_BUDGET;
+            any_busy |= busy[i] != 0;
+            poll_kernel_stats(s, now);
+            if (n == 0 && now >= next_sweep[i]) {
+                // quiet link: keep ageing flows against the wall clock
+                next_sweep[i] = now + std::chrono::milliseconds{CAPTURE_POLL_MS};
+                timeval tv{};
+                gettimeofday(&tv, nullptr);
+                s->flows.sweep(FLOW_SWEEP_IDLE, ts_to_ns(tv, false));
+                s->dns.sweep(DNS_SWEEP_IDLE, ts_to_ns(tv, false));
+                s->sketch.publish();
+            }
+        }
+    }
+    gLiveShards -= static_cast<int>(n_live);
+}
+
+void start_capture() {
+    if (!gCaptureThreads.empty() || gShards.empty()) return;
+    gStopCapture = false;
+    gLiveShards  = static_cast<int>(gShards.size());
+    const std::size_t workers = std::min<std::size_t>(static_cast<std::size_t>(gCfg.workers), gShards.size());
+    for (std::size_t w = 0; w < workers; ++w) {
+        std::vector<CaptureShard*> mine;
+        for (std::size_t i = w; i < gShards.size(); i += workers) mine.push_back(gShards[i].get());
+        gCaptureThreads.emplace_back(capture_loop, std::move(mine));
+    }
+}
+
+void stop_capture() {
+    if (gCaptureThreads.empty()) return;
+    gStopCapture = true;
+    for (const auto& s : gShards) pcap_breakloop(s->handle);
+    for (auto& t : gCaptureThreads) t.join();
+    gCaptureThreads.clear();
+}
+
+bool capture_running() {
+    return gLiveShards.load(std::memory_order_relaxed) > 0;
+}
+
+CounterTotals total_counters() {
+    CounterTotals t;
+    for (const auto& s : gShards) {
+        t.add(s->cnt);
+        t.dump_dropped += s->dump.dropped.load(std::memory_order_relaxed);
+    }
+    return t;
+}
+
+CounterTotals device_counters(const std::size_t dev) {
+    CounterTotals t;
+    for (const auto& s : gShards) {
+        if (s->dev != dev) continue;
+        t.add(s->cnt);
+        t.dump_dropped += s->dump.dropped.load(std::memory_order_relaxed);
+    }
+    return t;
+}
+
+KernelDrops device_drops(const std::size_t dev) {
+    KernelDrops k;
+    for (const auto& s : gShards) {
+        const ShardInstruments& in = s->instr;
+        if (s->dev != dev || !in.k_valid.load(std::memory_order_relaxed)) continue;
+        k.valid  = true;
+        k.recv  += in.k_recv.load(std::memory_order_relaxed);
+        k.drop  += in.k_drop.load(std::memory_order_relaxed);
+        // the interface's count, not the socket's: every shard on it sees the same one
+        k.ifdrop = std::max<std::uint64_t>(k.ifdrop, in.k_ifdrop.load(std::memory_order_relaxed));
+    }
+    return k;
+}
+
+KernelDrops kernel_drops() {
+    KernelDrops k;
+    for (std::size_t d = 0; d < std::max<std::size_t>(gCapDevs.size(), 1); ++d) {
+        const KernelDrops one = device_drops(d);
+        k.valid  |= one.valid;
+        k.recv   += one.recv;
+        k.drop   += one.drop;
+        k.ifdrop += one.ifdrop;
+    }
+    return k;
+}
+
+// Each shard publishes its own top list; with hash fanout a flow lives on one
+// shard, but CPU/LB fanout can split it, so equal keys are folded together.
+std::size_t top_flows(const bool by_rate, std::vector<FlowEntry>& flows) {
+    flows.clear();
+    std::size_t active = 0;
+    for (const auto& s : gShards) {
+        const FlowTop t = s->flows.top();
+        const auto&   v = by_rate ? t.by_rate : t.by_bytes;
+        flows.insert(flows.end(), v.begin(), v.begin() + (by_rate ? t.n_rate : t.n_bytes));
+        active += s->flows.active();
+    }
+
+    const auto key_less = [](const FlowEntry& x, const FlowEntry& y) {
+        return std::memcmp(&x.key, &y.key, sizeof(FlowKey)) < 0;
+    };
+    std::sort(flows.begin(), flows.end(), key_less);
+    std::size_t m = 0;
+    for (std::size_t i = 0; i < flows.size(); ++i) {
+        if (m > 0 && flows[m - 1].key == flows[i].key) {
+            FlowEntry& d = flows[m - 1];
+            d.packets   += flows[i].packets;
+            d.bytes     += flows[i].bytes;
+            d.first_ns   = std::min(d.first_ns, flows[i].first_ns);
+            d.last_ns    = std::max(d.last_ns, flows[i].last_ns);
+            d.tcp_flags |= flows[i].tcp_flags;
+        } else {
+            flows[m++] = flows[i];
+        }
+    }
+    flows.resize(m);
+    if (by_rate) std::sort(flows.begin(), flows.end(), [](auto& x, auto& y) { return x.rate() > y.rate(); });
+    else         std::sort(flows.begin(), flows.end(), [](auto& x, auto& y) { return x.bytes > y.bytes; });
+    return active;
+}
+
+DnsTotals dns_totals() {
+    DnsTotals t;
+    for (const auto& s : gShards) t.add(s->dns);
+    t.sort();
+    return t;
+}
+
+static std::vector<unsigned> gAsked;     // per shard, the last ask's number
+
+void ask_flow_detail(const FlowKey& k) {
+    gAsked.resize(gShards.size());
+    for (std::size_t i = 0; i < gShards.size(); ++i) {
+        gAsked[i] = gShards[i]->flows.ask(k);
+        if (!capture_running()) gShards[i]->flows.answer();
+    }
+}
+
+DetailState flow_detail(FlowDetail& out) {
+    bool found = false, pending = false;
+    for (std::size_t i = 0; i < gShards.size() && i < gAsked.size(); ++i) {
+        if (!gShards[i]->flows.enabled()) continue;
+        const FlowDetail d = gShards[i]->flows.detail();
+        if (d.gen != gAsked[i]) {
+            pending = true;
+        } else if (d.found && (!found || d.flow.packets > out.flow.packets)) {
+            out   = d;
+            found = true;
+        }
+    }
+    return found ? DetailState::kFound : pending ? DetailState::kPending : DetailState::kGone;
+}
+
+static bool ts_before(const timeval& a, const timeval& b) {
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_usec < b.tv_usec);
+}
+
+// Each shard's queue is already in capture order, so a k-way merge on the
+// timestamps gives one ordered history; a heap of queue heads keeps that at
+// O(log k) a row with several interfaces and workers. A shard whose queue is
+// empty can still deliver packets stamped as early as the last row taken from
+// it (the kernel hands them over a block at a time), so later rows from the
+// others are held back until it catches up: for at most the block timeout plus
+// a poll on one watermark, or until some queue is half full. A quiet interface
+// delays rows by that much but never stops them.
+std::size_t drain_captured() {
+    using clock = std::chrono::steady_clock;
+    struct Head {
+        timeval       ts;
+        CaptureShard* shard;
+    };
+    static std::vector<Head> heap;
+    static clock::time_point held_since{};
+    static timeval           held_at{};       // the watermark rows have been waiting on since then
+    const auto later = [](const Head& a, const Head& b) { return ts_before(b.ts, a.ts); };
+
+    heap.clear();
+    bool    full    = false;
+    bool    waiting = false;            // some queue is empty
+    timeval watermark{};                // rows up to here can't be overtaken
+    for (const auto& s : gShards) {
+        const std::size_t depth = s->queue.size();
+        s->instr.depth.record(depth);
+        full |= depth > ROW_QUEUE_CAP / 2;
+        if (const PacketRecord* r = s->queue.peek()) {
+            heap.push_back({r->ts, s.get()});
+        } else if (!waiting || ts_before(s->merged, watermark)) {
+            watermark = s->merged;
+            waiting   = true;
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+    if (held_since != clock::time_point{} && (watermark.tv_sec != held_at.tv_sec || watermark.tv_usec != held_at.tv_usec)) {
+        held_since = {};        // the stalled shard has moved on
+    }
+    const bool flush = full || (held_since != clock::time_point{} &&
+                                clock::now() - held_since >= std::chrono::milliseconds{gCfg.timeout_ms + CAPTURE_POLL_MS});
+
+    std::size_t n = 0;
+    while (!heap.empty()) {
+        if (waiting && !flush && ts_before(watermark, heap.front().ts)) break;
+        std::pop_heap(heap.begin(), heap.end(), later);
+        CaptureShard* best = heap.back().shard;
+        heap.pop_back();
+
+        PacketRecord r;
+        best->queue.pop(r);
+        best->merged = r.ts;
+        gRows.push(r);
+        if (gSpool.enabled()) gSpool.append(r, &best->payload);
+        ++n;
+
+        if (const PacketRecord* next = best->queue.peek()) {
+            heap.push_back({next->ts, best});
+            std::push_heap(heap.begin(), heap.end(), later);
+        } else if (!waiting || ts_before(best->merged, watermark)) {
+            watermark = best->merged;
+            waiting   = true;
+        }
+    }
+    if (heap.empty()) {
+        held_since = {};
+    } else if (held_since == clock::time_point{}) {
+        held_since = clock::now();
+        held_at    = watermark;
+    }
+    maintain_selection(n);
+    return n;
+}
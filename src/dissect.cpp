@@ -0,0 +1,257 @@
+//
+// Created by Shaunik Musukula on 7/17/25.
+//
+
+#include "dissect.h"
+#include "net_types.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+
+// The layers below are plain functions that call the next one directly, so the
+// whole chain for a frame is known at compile time and inlines into dissect():
+// no tables, no virtual calls, no per-layer copies.
+namespace {
+
+// Bounds-checked view of the captured bytes. Header structs are packed, so
+// pointers into the frame are read in place.
+struct Frame {
+    const std::uint8_t* p;
+    std::uint32_t       len;
+
+    template <typename H>
+    [[nodiscard]] const H* at(const std::size_t off) const {
+        return off + sizeof(H) <= len ? reinterpret_cast<const H*>(p + off) : nullptr;
+    }
+    [[nodiscard]] bool has(const std::size_t off, const std::size_t n) const { return off + n <= len; }
+    [[nodiscard]] std::uint16_t u16(const std::size_t off) const {
+        std::uint16_t v;
+        std::memcpy(&v, p + off, sizeof(v));
+        return ntohs(v);
+    }
+};
+
+constexpr std::uint8_t IPPROTO_ICMP6_ = 58;
+
+Proto map_proto(const std::uint8_t p) {
+    switch (p) {
+        case IPPROTO_TCP:    return Proto::kTcp;
+        case IPPROTO_UDP:    return Proto::kUdp;
+        case IPPROTO_ICMP:   return Proto::kIcmp;
+        case IPPROTO_ICMP6_: return Proto::kIcmp6;
+        default:             return Proto::kOther;
+    }
+}
+
+inline void set_payload(Decoded& d, const std::size_t off) {
+    d.pl_off = static_cast<std::uint32_t>(std::min<std::size_t>(off, d.pl_end));
+}
+
+inline void transport(const Frame& f, const std::size_t off, Decoded& d) {
+    d.l4_off = static_cast<std::uint32_t>(off);
+    set_payload(d, off);
+    switch (d.ip_proto) {
+        case IPPROTO_TCP: {
+            const auto* th = f.at<tcp_header>(off);
+            if (!th) { d.flags |= DF_TRUNCATED; return; }
+            const std::size_t hl = TH_OFF(th) * 4;
+            if (hl < sizeof(tcp_header)) { d.flags |= DF_MALFORMED; return; }
+            d.sport     = ntohs(th->th_sport);
+            d.dport     = ntohs(th->th_dport);
+            d.seq       = ntohl(th->th_seq);
+            d.ack       = ntohl(th->th_ack);
+            d.win       = ntohs(th->th_win);
+            d.tcp_flags = th->th_flags;
+            d.tcp_len   = d.ip_end > off + hl ? static_cast<std::uint32_t>(d.ip_end - off - hl) : 0;
+            set_payload(d, off + hl);
+            return;
+        }
+        case IPPROTO_UDP:
+            if (!f.has(off, 8)) { d.flags |= DF_TRUNCATED; return; }
+            d.sport = f.u16(off);
+            d.dport = f.u16(off + 2);
+            set_payload(d, off + 8);
+            return;
+        case IPPROTO_ICMP:
+        case IPPROTO_ICMP6_:
+            if (!f.has(off, 4)) { d.flags |= DF_TRUNCATED; return; }
+            d.icmp_type = f.p[off];
+            d.icmp_code = f.p[off + 1];
+            set_payload(d, off + 8);
+            return;
+        default:
+            return;
+    }
+}
+
+inline void ipv4(const Frame& f, const std::size_t off, Decoded& d) {
+    const auto* ip = f.at<ip_header>(off);
+    if (!ip) { d.flags |= DF_TRUNCATED; return; }
+    const std::size_t hl  = IP_HL(ip) * 4;
+    const std::size_t tot = ntohs(ip->ip_len);
+    if (IP_V(ip) != 4 || hl < sizeof(ip_header) || (tot != 0 && tot < hl)) { d.flags |= DF_MALFORMED; return; }
+
+    d.family   = AF_INET;
+    d.ip_proto = ip->ip_p;
+    d.proto    = map_proto(ip->ip_p);
+    d.ttl      = ip->ip_ttl;
+    std::memcpy(&d.src.v4, &ip->ip_src, 4);
+    std::memcpy(&d.dst.v4, &ip->ip_dst, 4);
+    // a zero total length shows up with TSO; trust caplen then
+    d.pl_end   = static_cast<std::uint32_t>(tot ? std::min<std::size_t>(off + tot, f.len) : f.len);
+    d.ip_end   = static_cast<std::uint32_t>(tot ? off + tot : f.len);
+    if (hl > sizeof(ip_header)) d.flags |= DF_IP_OPTIONS;
+    if (!f.has(off, hl)) { d.flags |= DF_TRUNCATED; set_payload(d, f.len); return; }
+
+    const std::uint16_t frag = ntohs(ip->ip_off);
+    if (frag & (IP_MF | IP_OFFMASK)) d.flags |= DF_FRAGMENT;
+    if (frag & IP_OFFMASK) {
+        d.flags |= DF_LATER_FRAG;
+        d.l4_off = static_cast<std::uint32_t>(off + hl);
+        set_payload(d, off + hl);
+        return;
+    }
+    transport(f, off + hl, d);
+}
+
+inline void ipv6(const Frame& f, std::size_t off, Decoded& d) {
+    if (!f.has(off, 40)) { d.flags |= DF_TRUNCATED; return; }
+    if ((f.p[off] >> 4) != 6) { d.flags |= DF_MALFORMED; return; }
+
+    d.family = AF_INET6;
+    d.ttl    = f.p[off + 7];
+    std::memcpy(d.src.v6, f.p + off + 8, 16);
+    std::memcpy(d.dst.v6, f.p + off + 24, 16);
+    const std::size_t plen = f.u16(off + 4);
+    d.pl_end = static_cast<std::uint32_t>(plen ? std::min<std::size_t>(off + 40 + plen, f.len) : f.len);
+    d.ip_end = static_cast<std::uint32_t>(plen ? off + 40 + plen : f.len);
+
+    std::uint8_t next = f.p[off + 6];
+    off += 40;
+    for (int i = 0; i < MAX_IP6_EXT_HDR; ++i) {
+        std::size_t ext;
+        switch (next) {
+            case IPPROTO_HOPOPTS:
+            case IPPROTO_ROUTING:
+            case IPPROTO_DSTOPTS:
+                if (!f.has(off, 2)) { d.flags |= DF_TRUNCATED; return; }
+                ext = (f.p[off + 1] + 1) * 8;
+                break;
+            case IPPROTO_AH:
+                if (!f.has(off, 2)) { d.flags |= DF_TRUNCATED; return; }
+                ext = (f.p[off + 1] + 2) * 4;
+                break;
+            case IPPROTO_FRAGMENT:
+                if (!f.has(off, 8)) { d.flags |= DF_TRUNCATED; return; }
+                d.flags |= DF_FRAGMENT;
+                if (f.u16(off + 2) & 0xFFF8) d.flags |= DF_LATER_FRAG;
+                ext = 8;
+                break;
+            default:
+                ext = 0;
+                break;
+        }
+        if (ext == 0) break;
+        d.flags |= DF_IP_OPTIONS;
+        next = f.p[off];
+        off += ext;
+    }
+
+    d.ip_proto = next;
+    d.proto    = map_proto(next);
+    if (d.flags & DF_LATER_FRAG) {
+        d.l4_off = static_cast<std::uint32_t>(off);
+        set_payload(d, off);
+        return;
+    }
+    transport(f, off, d);
+}
+
+// Ethernet/IPv4 ARP only; other hardware or protocol types are left as kArp
+// without addresses.
+inline void arp(const Frame& f, const std::size_t off, Decoded& d) {
+    d.proto  = Proto::kArp;
+    d.pl_end = f.len;
+    set_payload(d, off);
+    if (!f.has(off, 28)) { d.flags |= DF_TRUNCATED; return; }
+    d.arp_op = f.u16(off + 6);
+    if (f.u16(off) != 1 || f.u16(off + 2) != ETHERTYPE_IP4 || f.p[off + 4] != 6 || f.p[off + 5] != 4) return;
+    d.family = AF_INET;
+    std::memcpy(&d.src.v4, f.p + off + 14, 4);
+    std::memcpy(&d.dst.v4, f.p + off + 24, 4);
+    set_payload(d, off + 28);
+}
+
+inline void network(const Frame& f, const std::uint16_t type, const std::size_t off, Decoded& d) {
+    d.ether_type = type;
+    d.l3_off     = static_cast<std::uint32_t>(off);
+    switch (type) {
+        case ETHERTYPE_IP4: ipv4(f, off, d); break;
+        case ETHERTYPE_IP6: ipv6(f, off, d); break;
+        case ETHERTYPE_ARP: arp(f, off, d);  break;
+        default:
+            d.pl_end = f.len;
+            set_payload(d, off);
+            break;
+    }
+}
+
+inline void ethernet(const Frame& f, Decoded& d) {
+    if (!f.has(0, SIZE_ETHERNET)) { d.flags |= DF_TRUNCATED; return; }
+    std::uint16_t type = f.u16(12);
+    std::size_t   off  = SIZE_ETHERNET;
+    while ((type == ETHERTYPE_VLAN || type == ETHERTYPE_QINQ || type == ETHERTYPE_QINQ_OLD) &&
+           d.vlans < MAX_VLAN_TAGS) {
+        if (!f.has(off, 4)) { d.flags |= DF_TRUNCATED; return; }
+        d.vlan[d.vlans++] = f.u16(off) & 0x0FFF;
+        type = f.u16(off + 2);
+        off += 4;
+    }
+    network(f, type, off, d);
+}
+
+// BSD loopback: a 4-byte address family, in host order for DLT_NULL and
+// network order for DLT_LOOP. IPv6 has a different value on every BSD.
+inline void loopback(const Frame& f, const bool net_order, Decoded& d) {
+    if (!f.has(0, 4)) { d.flags |= DF_TRUNCATED; return; }
+    std::uint32_t af;
+    std::memcpy(&af, f.p, sizeof(af));
+    if (net_order) af = ntohl(af);
+    else if (af > 0xFFFF) af = __builtin_bswap32(af);     // written on a host of the other byte order
+    const bool v6 = af == 10 || af == 24 || af == 28 || af == 30;
+    network(f, af == 2 ? ETHERTYPE_IP4 : v6 ? ETHERTYPE_IP6 : 0, 4, d);
+}
+
+inline void raw_ip(const Frame& f, Decoded& d) {
+    if (!f.has(0, 1)) { d.flags |= DF_TRUNCATED; return; }
+    network(f, (f.p[0] >> 4) == 6 ? ETHERTYPE_IP6 : ETHERTYPE_IP4, 0, d);
+}
+
+} // namespace
+
+void dissect(const std::uint8_t* pkt, const std::uint32_t caplen, const int linktype, Decoded& d) {
+    std::memset(&d, 0, sizeof(d));
+    d.proto = Proto::kOther;
+    const Frame f{pkt, caplen};
+    switch (linktype) {
+        case DLT_EN10MB: ethernet(f, d);        break;
+        case DLT_NULL:   loopback(f, false, d); break;
+        case DLT_LOOP:   loopback(f, true, d);  break;
+        case DLT_RAW:    raw_ip(f, d);          break;
+        case DLT_LINUX_SLL:
+            if (f.has(0, 16)) network(f, f.u16(14), 16, d);
+            else              d.flags |= DF_TRUNCATED;
+            break;
+#ifdef DLT_LINUX_SLL2
+        case DLT_LINUX_SLL2:
+            if (f.has(0, 20)) network(f, f.u16(0), 20, d);
+            else              d.flags |= DF_TRUNCATED;
+            break;
+#endif
+        default:         network(f, 0, 0, d);   break;
+    }
+}
@@ -0,0 +1,183 @@
+//
+// Created by Shaunik Musukula on 7/25/25.
+//
+
+#include "dns.h"
+#include "hash.h"
+#include "stats.h"
+
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+
+const char* const DNS_RCODE_NAMES[DNS_RCODES] = {"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED", "other"};
+
+// Opcodes above 5 and queries without exactly one question are not DNS as
+// resolvers speak it, most likely something else on port 53.
+bool parse_dns(const std::uint8_t* p, const std::size_t len, DnsHeader& h) {
+    if (len < 12) return false;
+    const std::uint8_t opcode = (p[2] >> 3) & 0x0F;
+    h.id        = static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+    h.response  = (p[2] & 0x80) != 0;
+    h.rcode     = p[3] & 0x0F;
+    h.questions = static_cast<std::uint16_t>(p[4] << 8 | p[5]);
+    return opcode <= 5 && (h.response || h.questions == 1);
+}
+
+DnsTracker::DnsTracker(const std::size_t slots, const int timeout_s)
+    : mask_(slots ? round_pow2(slots) - 1 : 0),
+      max_used_(slots ? std::max<std::size_t>((mask_ + 1) / 4 * 3, 1) : 0),
+      timeout_ns_(static_cast<std::int64_t>(timeout_s) * 1'000'000'000),
+      // calloc keeps untouched slots on the kernel's zero pages
+      slots_(slots ? static_cast<DnsPending*>(std::calloc(mask_ + 1, sizeof(DnsPending))) : nullptr, &std::free) {}
+
+std::uint8_t DnsTracker::resolver_of(const IpAddr& a, const std::uint8_t family) {
+    const std::size_t n    = n_resolvers_.load(std::memory_order_relaxed);
+    const std::size_t alen = family == AF_INET6 ? 16 : 4;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (resolvers_[i].family == family && std::memcmp(&resolvers_[i].addr, &a, alen) == 0) {
+            return static_cast<std::uint8_t>(i);
+        }
+    }
+    if (n == DNS_RESOLVERS) return DNS_RESOLVERS;
+    std::memcpy(&resolvers_[n].addr, &a, alen);
+    resolvers_[n].family = family;
+    n_resolvers_.store(n + 1, std::memory_order_release);
+    return static_cast<std::uint8_t>(n);
+}
+
+void DnsTracker::update(const PacketRecord& r, const Decoded& d, const std::uint8_t* pkt, const std::int64_t now_ns) {
+    DnsHeader h;
+    if (!enabled() || d.pl_off >= d.pl_end || !parse_dns(pkt + d.pl_off, d.pl_end - d.pl_off, h)) return;
+
+    const std::size_t alen = r.family == AF_INET6 ? 16 : 4;
+    DnsKey k;
+    std::memset(&k, 0, sizeof(k));
+    std::memcpy(&k.client, h.response ? &r.dst : &r.src, alen);
+    std::memcpy(&k.server, h.response ? &r.src : &r.dst, alen);
+    k.client_port = h.response ? r.dport : r.sport;
+    k.server_port = h.response ? r.sport : r.dport;
+    k.id          = h.id;
+    k.family      = r.family;
+    const std::uint64_t h64  = hash64(&k, sizeof(k));
+    const auto          hash = static_cast<std::uint32_t>(h64 ^ (h64 >> 32));
+
+    std::size_t i = home(hash);
+    while (slots_[i].used && !(slots_[i].hash == hash && std::memcmp(&slots_[i].key, &k, sizeof(k)) == 0)) {
+        i = (i + 1) & mask_;
+    }
+
+    if (!h.response) {
+        Counters::bump(queries);
+        if (!slots_[i].used) {          // a retry under the same ID keeps the first query's time
+            if (used_ >= max_used_) {
+                // the oldest of the next few after the sweep cursor makes room
+                std::size_t victim = mask_ + 1, seen = 0;
+                for (std::size_t n = 0, j = cursor_; n <= mask_ && seen < DNS_EVICT_WINDOW; ++n, j = (j + 1) & mask_) {
+                    if (!slots_[j].used) continue;
+                    if (victim > mask_ || slots_[j].sent_ns < slots_[victim].sent_ns) victim = j;
+                    ++seen;
+                }
+                if (victim <= mask_) {
+                    erase(victim);
+                    Counters::bump(forgotten);
+                }
+                i = home(hash);         // the erase may have shifted entries
+                while (slots_[i].used) i = (i + 1) & mask_;
+            }
+            DnsPending& q = slots_[i];
+            q.key      = k;
+            q.hash     = hash;
+            q.sent_ns  = now_ns;
+            q.resolver = resolver_of(k.server, k.family);
+            q.used     = true;
+            pending.store(++used_, std::memory_order_relaxed);
+        }
+        Counters::bump(resolvers_[slots_[i].resolver].queries);
+    } else {
+        Counters::bump(responses);
+        const std::size_t rc = std::min<std::size_t>(h.rcode, DNS_RCODES - 1);
+        Counters::bump(rcodes[rc]);
+        if (slots_[i].used) {
+            const auto   lat = static_cast<std::uint64_t>(std::max<std::int64_t>(now_ns - slots_[i].sent_ns, 0));
+            DnsResolver& res = resolvers_[slots_[i].resolver];
+            res.latency.record(lat);
+            Counters::bump(res.answered);
+            by_rcode_[rc].record(lat);
+            erase(i);
+        } else {
+            Counters::bump(unmatched);
+        }
+    }
+    sweep(DNS_SWEEP_PER_PKT, now_ns);
+}
+
+// backward-shift deletion, as in FlowTable::erase
+void DnsTracker::erase(std::size_t i) {
+    std::size_t j = i;
+    while (true) {
+        j = (j + 1) & mask_;
+        if (!slots_[j].used) break;
+        const std::size_t k = home(slots_[j].hash);
+        const bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        slots_[i] = slots_[j];
+        i = j;
+    }
+    slots_[i].used = false;
+    pending.store(--used_, std::memory_order_relaxed);
+}
+
+void DnsTracker::sweep(std::size_t n, const std::int64_t now_ns) {
+    if (!enabled() || used_ == 0) return;
+    n = std::min(n, mask_ + 1);
+    while (n--) {
+        DnsPending& q = slots_[cursor_];
+        if (q.used && now_ns - q.sent_ns > timeout_ns_) {
+            Counters::bump(unanswered);
+            Counters::bump(resolvers_[q.resolver].unanswered);
+            erase(cursor_);
+            continue;                // a shifted entry may now sit at the cursor
+        }
+        cursor_ = (cursor_ + 1) & mask_;
+    }
+}
+
+static void add_resolver(std::vector<DnsResolverTotals>& out, const DnsResolver& r, const std::uint8_t family) {
+    auto it = std::find_if(out.begin(), out.end(), [&](const DnsResolverTotals& t) {
+        return t.family == family && std::memcmp(&t.addr, &r.addr, sizeof(IpAddr)) == 0;
+    });
+    if (it == out.end()) {
+        out.emplace_back();
+        it         = out.end() - 1;
+        it->addr   = r.addr;
+        it->family = family;
+    }
+    it->queries    += r.queries.load(std::memory_order_relaxed);
+    it->answered   += r.answered.load(std::memory_order_relaxed);
+    it->unanswered += r.unanswered.load(std::memory_order_relaxed);
+    it->latency.add(r.latency);
+}
+
+void DnsTotals::add(const DnsTracker& t) {
+    queries    += t.queries.load(std::memory_order_relaxed);
+    responses  += t.responses.load(std::memory_order_relaxed);
+    unmatched  += t.unmatched.load(std::memory_order_relaxed);
+    unanswered += t.unanswered.load(std::memory_order_relaxed);
+    forgotten  += t.forgotten.load(std::memory_order_relaxed);
+    pending    += t.pending.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < DNS_RCODES; ++i) {
+        rcodes[i] += t.rcodes[i].load(std::memory_order_relaxed);
+        by_rcode[i].add(t.by_rcode(i));
+    }
+    for (std::size_t i = 0, n = t.resolvers(); i < n; ++i) add_resolver(resolvers, t.resolver(i), t.resolver(i).family);
+    if (t.other().queries.load(std::memory_order_relaxed)) add_resolver(resolvers, t.other(), 0);
+}
+
+void DnsTotals::sort() {
+    std::sort(resolvers.begin(), resolvers.end(), [](const DnsResolverTotals& a, const DnsResolverTotals& b) {
+        if ((a.family == 0) != (b.family == 0)) return b.family == 0;
+        return a.queries > b.queries;
+    });
+}
@@ -0,0 +1,100 @@
+//
+// Created by Shaunik Musukula on 7/16/25.
+//
+
+#include "filter.h"
+#include "capture.h"
+#include "state.h"
+
+#include <cstdio>
+#include <vector>
+
+static std::size_t gSeenBase = 0;
+static std::size_t gKeptBase = 0;
+static std::size_t gSeenLast = 0;
+static std::size_t gKeptLast = 0;
+
+// Packets the captured interfaces themselves have received and sent. Only Linux exposes this
+// cheaply; elsewhere the stats bar shows what was kept and leaves `seen` at 0.
+static std::size_t iface_packets() {
+#ifdef __linux__
+    std::size_t total = 0;
+    for (const std::size_t d : gCapDevs) {
+        for (const char* dir : {"rx_packets", "tx_packets"}) {
+            char path[256];
+            std::snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", gDevices[d].name.c_str(), dir);
+            std::FILE* f = std::fopen(path, "r");
+            if (!f) return 0;
+            unsigned long long v = 0;
+            if (std::fscanf(f, "%llu", &v) != 1) v = 0;
+            std::fclose(f);
+            total += v;
+        }
+    }
+    return total;
+#else
+    return 0;
+#endif
+}
+
+bool set_filter(const std::string& expr) {
+    std::vector<bpf_program> progs(gShards.size());
+    for (std::size_t i = 0; i < gShards.size(); ++i) {
+        pcap_t* h = gShards[i]->handle;
+        if (pcap_compile(h, &progs[i], expr.c_str(), 1, PCAP_NETMASK_UNKNOWN) < 0) {
+            std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(h));
+            for (std::size_t j = 0; j < i; ++j) pcap_freecode(&progs[j]);
+            return false;
+        }
+    }
+
+    std::size_t set = 0;
+    while (set < gShards.size() && pcap_setfilter(gShards[set]->handle, &progs[set]) == 0) ++set;
+    const int insns = progs.empty() ? 0 : static_cast<int>(progs.front().bf_len);
+    for (auto& p : progs) pcap_freecode(&p);
+    if (set < gShards.size()) {
+        std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(gShards[set]->handle));
+        // put the old filter back on the handles that already took the new one
+        for (std::size_t i = 0; i < set; ++i) {
+            pcap_t*     h = gShards[i]->handle;
+            bpf_program old{};
+            if (pcap_compile(h, &old, gFilter.expr.c_str(), 1, PCAP_NETMASK_UNKNOWN) < 0) continue;
+            pcap_setfilter(h, &old);
+            pcap_freecode(&old);
+        }
+        return false;
+    }
+
+    gFilter.insns = insns;
+    gFilter.expr  = expr;
+    gFilter.error.clear();
+    gFilter.seen  = gFilter.kept = gFilter.seen_ps = gFilter.kept_ps = 0;
+    gSeenBase     = gSeenLast = iface_packets();
+    gKeptBase     = gKeptLast = total_counters().delivered;
+    return true;
+}
+
+void update_filter_stats() {
+    if (gFilter.expr.empty() || gShards.empty() || !gShards.front()->handle) return;
+
+    const std::size_t seen = iface_packets();
+    const std::size_t kept = total_counters().delivered;
+    gFilter.seen    = seen >= gSeenBase ? seen - gSeenBase : 0;
+    gFilter.kept    = kept - gKeptBase;
+    gFilter.seen_ps = seen >= gSeenLast ? seen - gSeenLast : 0;
+    gFilter.kept_ps = kept - gKeptLast;
+    gSeenLast       = seen;
+    gKeptLast       = kept;
+}
+
+bool compile_offline_filter(const std::string& expr, const int linktype, const int snaplen, bpf_program& prog) {
+    pcap_t* dead = pcap_open_dead(linktype, snaplen);
+    if (!dead) {
+        std::snprintf(gErr, PCAP_ERRBUF_SIZE, "can't compile filters for link type %d", linktype);
+        return false;
+    }
+    const bool ok = pcap_compile(dead, &prog, expr.c_str(), 1, PCAP_NETMASK_UNKNOWN) == 0;
+    if (!ok) std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(dead));
+    pcap_close(dead);
+    return ok;
+}
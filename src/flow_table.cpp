@@ -0,0 +1,194 @@
+//
+// Created by Shaunik Musukula on 7/14/25.
+//
+
+#include "flow_table.h"
+#include "hash.h"
+
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+std::int64_t ts_to_ns(const timeval& ts, const bool nano) {
+    return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_usec * (nano ? 1 : 1'000);
+}
+
+static std::uint32_t hash_key(const FlowKey& k) {
+    const std::uint64_t h = hash64(&k, sizeof(k));
+    return static_cast<std::uint32_t>(h ^ (h >> 32));
+}
+
+FlowKey make_flow_key(const PacketRecord& r, bool& a_is_src) {
+    const std::size_t alen = r.family == AF_INET6 ? 16 : 4;
+    const int         c    = std::memcmp(&r.src, &r.dst, alen);
+    a_is_src = c < 0 || (c == 0 && r.sport <= r.dport);
+
+    FlowKey k;
+    std::memset(&k, 0, sizeof(k));
+    std::memcpy(&k.a, a_is_src ? &r.src : &r.dst, alen);
+    std::memcpy(&k.b, a_is_src ? &r.dst : &r.src, alen);
+    k.port_a = a_is_src ? r.sport : r.dport;
+    k.port_b = a_is_src ? r.dport : r.sport;
+    k.family = r.family;
+    k.proto  = r.proto;
+    return k;
+}
+
+FlowTable::FlowTable(const std::size_t slots, const int idle_timeout_s, const std::size_t reasm_bytes)
+    : mask_(slots ? round_pow2(slots) - 1 : 0),
+      max_used_(slots ? (mask_ + 1) / 4 * 3 : 0),
+      timeout_ns_(static_cast<std::int64_t>(idle_timeout_s) * 1'000'000'000),
+      // calloc keeps untouched slots on the kernel's zero pages
+      slots_(slots ? static_cast<FlowEntry*>(std::calloc(mask_ + 1, sizeof(FlowEntry))) : nullptr, &std::free),
+      tcp_(max_used_, reasm_bytes),
+      answer_(slots ? std::make_unique<FlowDetail>() : nullptr) {}
+
+std::size_t FlowTable::find(const FlowKey& k, const std::uint32_t h) const {
+    for (std::size_t i = home(h); slots_[i].used; i = (i + 1) & mask_) {
+        if (slots_[i].hash == h && slots_[i].key == k) return i;
+    }
+    return mask_ + 1;
+}
+
+std::uint8_t FlowTable::update(const PacketRecord& r, const Decoded& d, const std::uint8_t* pkt,
+                               const std::int64_t now_ns) {
+    if (!enabled()) return 0;
+
+    bool                a_is_src;
+    const FlowKey       k = make_flow_key(r, a_is_src);
+    const std::uint32_t h = hash_key(k);
+
+    std::size_t i = find(k, h);
+    if (i <= mask_) {
+        FlowEntry& e = slots_[i];
+        ++e.packets;
+        e.bytes     += r.len;
+        e.last_ns    = now_ns;
+        e.tcp_flags |= r.tcp_flags;
+    } else {
+        if (used_ >= max_used_) evict_one();
+        i = home(h);                 // eviction may have shifted entries
+        while (slots_[i].used) i = (i + 1) & mask_;
+
+        FlowEntry& e = slots_[i];
+        e.key       = k;
+        e.hash      = h;
+        e.packets   = 1;
+        e.bytes     = r.len;
+        e.first_ns  = now_ns;
+        e.last_ns   = now_ns;
+        e.tcp       = r.proto == Proto::kTcp ? tcp_.acquire() : 0;
+        e.tcp_flags = r.tcp_flags;
+        e.a_is_src  = a_is_src;
+        e.used      = true;
+        active_.store(++used_, std::memory_order_relaxed);
+    }
+
+    const std::uint32_t t  = slots_[i].tcp;
+    const std::uint8_t  ev = t ? tcp_.track(tcp_.stats(t), a_is_src ? 0 : 1, d, pkt, now_ns) : 0;
+    sweep(FLOW_SWEEP_PER_PKT, now_ns);
+    return ev;
+}
+
+// Backward-shift deletion: pull later entries of the probe run into the hole so
+// lookups never need tombstones.
+void FlowTable::erase(std::size_t i) {
+    tcp_.release(slots_[i].tcp);
+    std::size_t j = i;
+    while (true) {
+        j = (j + 1) & mask_;
+        if (!slots_[j].used) break;
+        const std::size_t k = home(slots_[j].hash);
+        const bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        slots_[i] = slots_[j];
+        i = j;
+    }
+    slots_[i].used = false;
+    active_.store(--used_, std::memory_order_relaxed);
+    evicted_.store(evicted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Table full: drop the least recently seen of the next few flows after the
+// sweep cursor.
+void FlowTable::evict_one() {
+    std::size_t victim = mask_ + 1, seen = 0;
+    for (std::size_t n = 0, i = cursor_; n <= mask_; ++n, i = (i + 1) & mask_) {
+        if (!slots_[i].used) continue;
+        if (victim > mask_ || slots_[i].last_ns < slots_[victim].last_ns) victim = i;
+        if (++seen == FLOW_EVICT_WINDOW) break;
+    }
+    if (victim <= mask_) erase(victim);
+}
+
+void FlowTable::consider(const FlowEntry& e) {
+    const auto keep = [&](auto& arr, std::size_t& n, auto better) {
+        if (n == TOP_FLOWS && !better(e, arr[n - 1])) return;
+        std::size_t at = n < TOP_FLOWS ? n++ : n - 1;
+        while (at > 0 && better(e, arr[at - 1])) { arr[at] = arr[at - 1]; --at; }
+        arr[at] = e;
+    };
+    keep(building_.by_bytes, building_.n_bytes, [](const FlowEntry& x, const FlowEntry& y) { return x.bytes > y.bytes; });
+    keep(building_.by_rate,  building_.n_rate,  [](const FlowEntry& x, const FlowEntry& y) { return x.rate() > y.rate(); });
+}
+
+void FlowTable::sweep(std::size_t n, const std::int64_t now_ns) {
+    if (!enabled()) return;
+    if (ask_gen_.load(std::memory_order_relaxed) != answered_) answer();
+    n = std::min(n, mask_ + 1);
+    while (n--) {
+        FlowEntry& e = slots_[cursor_];
+        if (e.used && now_ns - e.last_ns > timeout_ns_) {
+            erase(cursor_);
+            continue;                // a shifted entry may now sit at the cursor
+        }
+        if (e.used) consider(e);
+
+        cursor_ = (cursor_ + 1) & mask_;
+        if (cursor_ == 0) {
+            top_.store(building_);
+            building_.n_bytes = building_.n_rate = 0;
+        }
+    }
+}
+
+void FlowTable::publish() {
+    if (!enabled()) return;
+    FlowTop partial = building_;
+    building_.n_bytes = building_.n_rate = 0;
+    for (std::size_t i = 0; i <= mask_; ++i) if (slots_[i].used) consider(slots_[i]);
+    top_.store(building_);
+    building_ = partial;
+}
+
+unsigned FlowTable::ask(const FlowKey& k) {
+    ask_key_.store(k);
+    return ask_gen_.fetch_add(1, std::memory_order_release) + 1;
+}
+
+void FlowTable::answer() {
+    if (!enabled()) return;
+    const unsigned gen = ask_gen_.load(std::memory_order_acquire);
+    const FlowKey  k   = ask_key_.load();
+    const std::size_t i = find(k, hash_key(k));
+
+    FlowDetail& a = *answer_;
+    a.gen           = gen;
+    a.found         = i <= mask_;
+    a.tcp_valid     = a.found && slots_[i].tcp;
+    a.untracked     = tcp_.untracked();
+    a.stream_len[0] = a.stream_len[1] = 0;
+    if (a.found) a.flow = slots_[i];
+    if (a.tcp_valid) {
+        a.tcp = tcp_.stats(slots_[i].tcp);
+        for (int s = 0; s < 2; ++s) {
+            const TcpDir& dir = a.tcp.dir[s];
+            if (!dir.stream) continue;
+            a.stream_len[s] = dir.contig;
+            std::memcpy(a.stream[s], tcp_.stream(dir.stream), dir.contig);
+        }
+    }
+    detail_.store(a);
+    answered_ = gen;
+}
@@ -0,0 +1,40 @@
+//
+// Created by Shaunik Musukula on 7/21/25.
+//
+
+#include "instrument.h"
+#include "util.h"
+
+#include <algorithm>
+
+void HistSnapshot::add(const Histogram& h) {
+    for (std::size_t i = 0; i < HIST_BUCKETS; ++i) {
+        const std::uint64_t n = h.counts_[i].load(std::memory_order_relaxed);
+        counts[i] += n;
+        total     += n;
+    }
+    sum += h.sum_.load(std::memory_order_relaxed);
+    max  = std::max(max, h.max_.load(std::memory_order_relaxed));
+}
+
+// The bucket bound can overshoot the largest value actually seen, so it is
+// capped by the recorded maximum.
+std::uint64_t HistSnapshot::percentile(const double q) const {
+    if (total == 0) return 0;
+    const std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    std::uint64_t       seen = 0;
+    for (std::size_t i = 0; i < HIST_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(hist_upper(i), max);
+    }
+    return max;
+}
+
+std::string HistSnapshot::summary(const bool ns) const {
+    if (total == 0) return "no samples";
+    const auto fmt = [ns](const std::uint64_t v) {
+        return ns ? human_ns(v) : human_count(static_cast<double>(v));
+    };
+    return "p50 " + fmt(percentile(0.5)) + "  p99 " + fmt(percentile(0.99)) + "  p99.9 " +
+           fmt(percentile(0.999)) + "  max " + fmt(max);
+}
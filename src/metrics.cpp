@@ -0,0 +1,361 @@
+//
+// Created by Shaunik Musukula on 7/22/25.
+//
+
+#include "metrics.h"
+#include "options.h"
+#include "search.h"
+#include "state.h"
+#include "util.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void MetricsSnapshot::take() {
+    at           = std::time(nullptr);
+    c            = total_counters();
+    rate         = gRates.empty() ? RateSample{} : gRates.recent(0);
+    kernel       = kernel_drops();
+    flows_active = top_flows(false, top);
+    dns          = dns_totals();
+    if (top.size() > METRICS_TOP_FLOWS) top.resize(METRICS_TOP_FLOWS);
+    devs.resize(gCapDevs.size());
+    for (std::size_t d = 0; d < gCapDevs.size(); ++d) {
+        devs[d].name   = gDevices[gCapDevs[d]].name.c_str();
+        devs[d].c      = device_counters(d);
+        devs[d].kernel = device_drops(d);
+    }
+}
+
+static void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(std::string& out, const char* fmt, ...) {
+    char    buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(buf, std::min<std::size_t>(n, sizeof(buf) - 1));
+}
+
+static void family(std::string& out, const char* name, const char* type, const char* help) {
+    append(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static unsigned long long ull(const std::uint64_t v) { return v; }
+
+constexpr double DNS_QUANTILES[] = {0.5, 0.9, 0.99};
+
+// quantiles plus _sum and _count of one labelled series, in seconds
+static void summary_text(std::string& out, const char* name, const char* label, const HistSnapshot& h) {
+    for (const double q : DNS_QUANTILES) {
+        append(out, "%s{%s,quantile=\"%g\"} %.6f\n", name, label, q, static_cast<double>(h.percentile(q)) / 1e9);
+    }
+    append(out, "%s_sum{%s} %.6f\n", name, label, static_cast<double>(h.sum) / 1e9);
+    append(out, "%s_count{%s} %llu\n", name, label, ull(h.total));
+}
+
+static void resolver_name(const DnsResolverTotals& r, char* out, const std::size_t n) {
+    if (r.family) format_addr(r.family, r.addr, out, n);
+    else          std::snprintf(out, n, "other");
+}
+
+static void dns_text(std::string& out, const DnsTotals& d) {
+    family(out, "sniffer_dns_queries_total", "counter", "DNS queries seen, retries included.");
+    append(out, "sniffer_dns_queries_total %zu\n", d.queries);
+    family(out, "sniffer_dns_responses_total", "counter", "DNS responses, by rcode.");
+    for (std::size_t i = 0; i < DNS_RCODES; ++i) {
+        append(out, "sniffer_dns_responses_total{rcode=\"%s\"} %zu\n", DNS_RCODE_NAMES[i], d.rcodes[i]);
+    }
+    family(out, "sniffer_dns_unanswered_total", "counter", "DNS queries without a response within --dns-timeout.");
+    append(out, "sniffer_dns_unanswered_total %zu\n", d.unanswered);
+    family(out, "sniffer_dns_unmatched_responses_total", "counter", "DNS responses to a query that was not seen.");
+    append(out, "sniffer_dns_unmatched_responses_total %zu\n", d.unmatched);
+    family(out, "sniffer_dns_pending", "gauge", "DNS queries waiting for a response.");
+    append(out, "sniffer_dns_pending %zu\n", d.pending);
+
+    char name[INET6_ADDRSTRLEN];
+    family(out, "sniffer_dns_resolver_queries_total", "counter", "DNS queries by resolver.");
+    for (const DnsResolverTotals& r : d.resolvers) {
+        resolver_name(r, name, sizeof(name));
+        append(out, "sniffer_dns_resolver_queries_total{resolver=\"%s\"} %zu\n", name, r.queries);
+    }
+    family(out, "sniffer_dns_resolver_unanswered_total", "counter", "DNS queries without a response, by resolver.");
+    for (const DnsResolverTotals& r : d.resolvers) {
+        resolver_name(r, name, sizeof(name));
+        append(out, "sniffer_dns_resolver_unanswered_total{resolver=\"%s\"} %zu\n", name, r.unanswered);
+    }
+    family(out, "sniffer_dns_latency_seconds", "summary", "Time from DNS query to response, by resolver.");
+    for (const DnsResolverTotals& r : d.resolvers) {
+        if (r.latency.total == 0) continue;
+        resolver_name(r, name, sizeof(name));
+        char label[INET6_ADDRSTRLEN + 16];
+        std::snprintf(label, sizeof(label), "resolver=\"%s\"", name);
+        summary_text(out, "sniffer_dns_latency_seconds", label, r.latency);
+    }
+    family(out, "sniffer_dns_rcode_latency_seconds", "summary", "Time from DNS query to response, by rcode.");
+    for (std::size_t i = 0; i < DNS_RCODES; ++i) {
+        if (d.by_rcode[i].total == 0) continue;
+        char label[32];
+        std::snprintf(label, sizeof(label), "rcode=\"%s\"", DNS_RCODE_NAMES[i]);
+        summary_text(out, "sniffer_dns_rcode_latency_seconds", label, d.by_rcode[i]);
+    }
+}
+
+std::string prometheus_text(const MetricsSnapshot& m) {
+    std::string out;
+    out.reserve(4'096);
+
+    family(out, "sniffer_packets_total", "counter", "Packets captured, by protocol.");
+    for (std::size_t i = 0; i < N_PROTO; ++i) {
+        append(out, "sniffer_packets_total{proto=\"%s\"} %llu\n", proto_name(static_cast<Proto>(i)), ull(m.c.pkts[i]));
+    }
+    family(out, "sniffer_bytes_total", "counter", "Bytes on the wire of captured packets, by protocol.");
+    for (std::size_t i = 0; i < N_PROTO; ++i) {
+        append(out, "sniffer_bytes_total{proto=\"%s\"} %llu\n", proto_name(static_cast<Proto>(i)), ull(m.c.bytes[i]));
+    }
+    family(out, "sniffer_packet_sizes_total", "counter", "Packets by RMON size class.");
+    for (std::size_t i = 0; i < SIZE_BUCKETS; ++i) {
+        append(out, "sniffer_packet_sizes_total{size=\"%s\"} %llu\n", SIZE_LABELS[i], ull(m.c.sizes[i]));
+    }
+    family(out, "sniffer_packets_per_second", "gauge", "Packet rate over the last interval.");
+    append(out, "sniffer_packets_per_second %.1f\n", m.rate.pps());
+    family(out, "sniffer_bytes_per_second", "gauge", "Byte rate over the last interval.");
+    append(out, "sniffer_bytes_per_second %.1f\n", m.rate.bps());
+
+    family(out, "sniffer_queue_dropped_total", "counter", "Packets dropped because the row queue was full.");
+    append(out, "sniffer_queue_dropped_total %llu\n", ull(m.c.dropped));
+    family(out, "sniffer_write_dropped_total", "counter", "Packets left out of the capture file because the writer was behind.");
+    append(out, "sniffer_write_dropped_total %llu\n", ull(m.c.dump_dropped));
+    if (m.kernel.valid) {
+        family(out, "sniffer_kernel_received_total", "counter", "Packets the kernel handed to the capture sockets.");
+        append(out, "sniffer_kernel_received_total %llu\n", ull(m.kernel.recv));
+        family(out, "sniffer_kernel_dropped_total", "counter", "Packets dropped for lack of kernel buffer space.");
+        append(out, "sniffer_kernel_dropped_total %llu\n", ull(m.kernel.drop));
+        family(out, "sniffer_interface_dropped_total", "counter", "Packets dropped by the interface or its driver.");
+        append(out, "sniffer_interface_dropped_total %llu\n", ull(m.kernel.ifdrop));
+    }
+    family(out, "sniffer_device_packets_total", "counter", "Packets captured, by interface.");
+    for (const DeviceMetrics& d : m.devs) append(out, "sniffer_device_packets_total{device=\"%s\"} %zu\n", d.name, d.c.all);
+    family(out, "sniffer_device_bytes_total", "counter", "Bytes on the wire of captured packets, by interface.");
+    for (const DeviceMetrics& d : m.devs) append(out, "sniffer_device_bytes_total{device=\"%s\"} %zu\n", d.name, d.c.total_bytes);
+    if (m.kernel.valid) {
+        family(out, "sniffer_device_kernel_dropped_total", "counter", "Packets dropped for lack of kernel buffer space, by interface.");
+        for (const DeviceMetrics& d : m.devs) {
+            append(out, "sniffer_device_kernel_dropped_total{device=\"%s\"} %llu\n", d.name, ull(d.kernel.drop));
+        }
+    }
+    if (gWriter.recorder()) {
+        family(out, "sniffer_recorder_triggers_total", "counter", "Flight recorder dumps started.");
+        append(out, "sniffer_recorder_triggers_total %zu\n", gWriter.triggers());
+    }
+    if (gSearching) {
+        family(out, "sniffer_payload_matches_total", "counter", "Packets whose payload contains the --match pattern.");
+        append(out, "sniffer_payload_matches_total %llu\n", ull(m.c.matches));
+    }
+
+    family(out, "sniffer_tcp_events_total", "counter", "TCP segments found by the flow tables' stream analysis, by kind.");
+    append(out, "sniffer_tcp_events_total{event=\"retransmission\"} %zu\n", m.c.retrans);
+    append(out, "sniffer_tcp_events_total{event=\"out_of_order\"} %zu\n", m.c.ooo);
+    append(out, "sniffer_tcp_events_total{event=\"duplicate_ack\"} %zu\n", m.c.dup_acks);
+    append(out, "sniffer_tcp_events_total{event=\"zero_window\"} %zu\n", m.c.zero_wins);
+
+    if (gCfg.dns_slots) dns_text(out, m.dns);
+
+    family(out, "sniffer_flows_active", "gauge", "Flows in the flow tables.");
+    append(out, "sniffer_flows_active %zu\n", m.flows_active);
+    family(out, "sniffer_top_flow_bytes", "gauge", "Bytes of the heaviest flows.");
+    char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8];
+    for (const FlowEntry& e : m.top) {
+        format_endpoint(e, true,  src, sizeof(src));
+        format_endpoint(e, false, dst, sizeof(dst));
+        append(out, "sniffer_top_flow_bytes{src=\"%s\",dst=\"%s\",proto=\"%s\"} %llu\n",
+               src, dst, proto_name(e.key.proto), ull(e.bytes));
+    }
+    return out;
+}
+
+std::string json_line(const MetricsSnapshot& m) {
+    std::string out;
+    out.reserve(2'048);
+    append(out, "{\"time\":%lld,\"packets\":%zu,\"bytes\":%zu,\"pps\":%.1f,\"bps\":%.1f,\"proto\":{",
+           static_cast<long long>(m.at), m.c.all, m.c.total_bytes, m.rate.pps(), m.rate.bps());
+    for (std::size_t i = 0; i < N_PROTO; ++i) {
+        append(out, "%s\"%s\":{\"packets\":%zu,\"bytes\":%zu}", i ? "," : "", proto_name(static_cast<Proto>(i)),
+               m.c.pkts[i], m.c.bytes[i]);
+    }
+    append(out, "},\"drops\":{\"queue\":%zu,\"write\":%zu", m.c.dropped, m.c.dump_dropped);
+    if (m.kernel.valid) {
+        append(out, ",\"kernel\":%llu,\"interface\":%llu", ull(m.kernel.drop), ull(m.kernel.ifdrop));
+    }
+    if (gSearching) append(out, "},\"matches\":%zu", m.c.matches);
+    else            out += "}";
+    append(out, ",\"tcp\":{\"retransmissions\":%zu,\"out_of_order\":%zu,\"duplicate_acks\":%zu,\"zero_windows\":%zu}",
+           m.c.retrans, m.c.ooo, m.c.dup_acks, m.c.zero_wins);
+    out += ",\"interfaces\":[";
+    for (std::size_t i = 0; i < m.devs.size(); ++i) {
+        const DeviceMetrics& d = m.devs[i];
+        append(out, "%s{\"name\":\"%s\",\"packets\":%zu,\"bytes\":%zu", i ? "," : "", d.name, d.c.all, d.c.total_bytes);
+        if (d.kernel.valid) append(out, ",\"kernel_drops\":%llu", ull(d.kernel.drop));
+        out += "}";
+    }
+    out += "]";
+    if (gCfg.dns_slots) {
+        append(out, ",\"dns\":{\"queries\":%zu,\"responses\":%zu,\"unanswered\":%zu,\"pending\":%zu,\"resolvers\":[",
+               m.dns.queries, m.dns.responses, m.dns.unanswered, m.dns.pending);
+        char name[INET6_ADDRSTRLEN];
+        for (std::size_t i = 0; i < m.dns.resolvers.size(); ++i) {
+            const DnsResolverTotals& r = m.dns.resolvers[i];
+            resolver_name(r, name, sizeof(name));
+            append(out, "%s{\"addr\":\"%s\",\"queries\":%zu,\"answered\":%zu,\"unanswered\":%zu,\"p50_ms\":%.3f,"
+                        "\"p99_ms\":%.3f}", i ? "," : "", name, r.queries, r.answered, r.unanswered,
+                   static_cast<double>(r.latency.percentile(0.5)) / 1e6, static_cast<double>(r.latency.percentile(0.99)) / 1e6);
+        }
+        out += "]}";
+    }
+    append(out, ",\"flows\":{\"active\":%zu,\"top\":[", m.flows_active);
+    char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8];
+    for (std::size_t i = 0; i < m.top.size(); ++i) {
+        const FlowEntry& e = m.top[i];
+        format_endpoint(e, true,  src, sizeof(src));
+        format_endpoint(e, false, dst, sizeof(dst));
+        append(out, "%s{\"src\":\"%s\",\"dst\":\"%s\",\"proto\":\"%s\",\"packets\":%llu,\"bytes\":%llu}",
+               i ? "," : "", src, dst, proto_name(e.key.proto), ull(e.packets), ull(e.bytes));
+    }
+    out += "]}}\n";
+    return out;
+}
+
+static bool parse_listen(const char* spec, sockaddr_storage& sa, socklen_t& len) {
+    std::string host = "127.0.0.1";
+    const char* port = spec;
+    if (spec[0] == '[') {
+        const char* end = std::strchr(spec, ']');
+        if (!end || end[1] != ':') return false;
+        host.assign(spec + 1, end);
+        port = end + 2;
+    } else if (const char* colon = std::strrchr(spec, ':')) {
+        host.assign(spec, colon);
+        port = colon + 1;
+    }
+    char*      end = nullptr;
+    const long p   = std::strtol(port, &end, 10);
+    if (end == port || *end != '\0' || p <= 0 || p > 65'535) return false;
+
+    std::memset(&sa, 0, sizeof(sa));
+    auto* v4 = reinterpret_cast<sockaddr_in*>(&sa);
+    auto* v6 = reinterpret_cast<sockaddr_in6*>(&sa);
+    if (inet_pton(AF_INET, host.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port   = htons(static_cast<std::uint16_t>(p));
+        len            = sizeof(sockaddr_in);
+        return true;
+    }
+    if (inet_pton(AF_INET6, host.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port   = htons(static_cast<std::uint16_t>(p));
+        len             = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+bool MetricsServer::start(const char* spec) {
+    sockaddr_storage sa{};
+    socklen_t        len = 0;
+    if (!parse_listen(spec, sa, len)) {
+        std::snprintf(gErr, sizeof(gErr), "not [addr:]port: %s", spec);
+        return false;
+    }
+    listen_fd_ = socket(sa.ss_family, SOCK_STREAM, 0);
+    const int on = 1;
+    if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&sa), len) < 0 || listen(listen_fd_, 16) < 0) {
+        std::snprintf(gErr, sizeof(gErr), "%s: %s", spec, std::strerror(errno));
+        if (listen_fd_ >= 0) close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    publish("");
+    stop_   = false;
+    thread_ = std::thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::publish(std::string text) {
+    auto p = std::make_shared<const std::string>(std::move(text));
+    std::lock_guard<std::mutex> lock(mu_);
+    text_ = std::move(p);
+}
+
+void MetricsServer::stop() {
+    if (!thread_.joinable()) return;
+    stop_ = true;
+    thread_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+// One request per connection, answered in turn: scrapers come every few
+// seconds, so there is nothing to gain from serving them concurrently. A
+// client hanging up early would raise SIGPIPE, which headless mode ignores.
+void MetricsServer::run() {
+    pollfd pfd{listen_fd_, POLLIN, 0};
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) continue;
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        serve(fd);
+        close(fd);
+    }
+}
+
+static void send_all(const int fd, const char* p, std::size_t n) {
+    while (n > 0) {
+        const ssize_t k = send(fd, p, n, 0);
+        if (k <= 0) return;
+        p += k;
+        n -= static_cast<std::size_t>(k);
+    }
+}
+
+void MetricsServer::serve(const int fd) {
+    const timeval tv{METRICS_IO_MS / 1'000, (METRICS_IO_MS % 1'000) * 1'000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    std::string req;
+    char        buf[1'024];
+    while (req.size() < METRICS_REQ_MAX && req.find("\r\n\r\n") == std::string::npos) {
+        const ssize_t k = recv(fd, buf, sizeof(buf), 0);
+        if (k <= 0) break;
+        req.append(buf, static_cast<std::size_t>(k));
+    }
+
+    std::shared_ptr<const std::string> body;
+    const char*                        status = "404 Not Found";
+    if (req.rfind("GET ", 0) != 0) {
+        status = "405 Method Not Allowed";
+    } else if (req.rfind("GET /metrics ", 0) == 0 || req.rfind("GET /metrics?", 0) == 0) {
+        std::lock_guard<std::mutex> lock(mu_);
+        body   = text_;
+        status = "200 OK";
+    }
+    char head[256];
+    const int n = std::snprintf(head, sizeof(head),
+                                "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                                status, body ? body->size() : 0);
+    send_all(fd, head, static_cast<std::size_t>(n));
+    if (body) send_all(fd, body->data(), body->size());
+}
@@ -4,7 +4,27 @@
 
 #include "netdev_lookup.h"
 
-std::map<std::string, std::string> get_interface_descriptions() {
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/ethtool.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
+static std::map<std::string, std::string> get_interface_descriptions() {
     std::map<std::string, std::string> mapping;
     FILE* fp = popen("networksetup -listallhardwareports", "r");
     if (!fp) return mapping;
@@ -47,24 +67,153 @@ static std::string get_known_interface_description(const std::string& name) {
     return "No description";
 }
 
-const std::map<std::string, std::string>& get_cached_device_descriptions() {
+// networksetup takes a while, so it runs once and only when a description is
+// first wanted
+static const std::map<std::string, std::string>& get_cached_device_descriptions() {
     static const std::map<std::string, std::string> cached = get_interface_descriptions();
     return cached;
 }
 
-DeviceMapping match_iface_pcap(pcap_if_t* iface) {
+static void load(DeviceMapping& dev) {
     const auto& dev_desc = get_cached_device_descriptions();
-    const auto it = dev_desc.find(std::string(iface->name));
+    const auto  it       = dev_desc.find(dev.name);
+    dev.description = it != dev_desc.end() ? it->second : get_known_interface_description(dev.name);
+}
+#elif defined(__linux__)
+// one line of /sys/class/net/<name>/<file>, newline stripped; false if unreadable
+static bool read_sys(const std::string& name, const char* file, char* buf, const std::size_t len) {
+    char path[256];
+    std::snprintf(path, sizeof(path), "/sys/class/net/%s/%s", name.c_str(), file);
+    std::FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    const bool ok = std::fgets(buf, static_cast<int>(len), f) != nullptr;
+    std::fclose(f);
+    if (ok) buf[std::strcspn(buf, "\n")] = '\0';
+    return ok;
+}
 
-    DeviceMapping dev;
-    dev.iface = iface;
-    const std::string name = iface->name;
+static int read_sys_int(const std::string& name, const char* file) {
+    char buf[32];
+    return read_sys(name, file, buf, sizeof(buf)) ? std::atoi(buf) : 0;
+}
+
+// virtual devices have a driver too (veth, bridge, tun), but only ethtool knows it
+static std::string driver_of(const std::string& name) {
+    static const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || name.size() >= IFNAMSIZ) return {};
+    ethtool_drvinfo info{};
+    info.cmd = ETHTOOL_GDRVINFO;
+    ifreq ifr{};
+    std::memcpy(ifr.ifr_name, name.c_str(), name.size());
+    ifr.ifr_data = reinterpret_cast<char*>(&info);
+    if (ioctl(fd, SIOCETHTOOL, &ifr) < 0) return {};
+    return info.driver;
+}
 
-    if (it != dev_desc.end()) {
-        dev.description = it->second;
-    } else {
-        dev.description = get_known_interface_description(name);
+static void count_queues(const std::string& name, IfaceInfo& info) {
+    const std::string path = "/sys/class/net/" + name + "/queues";
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (const dirent* e = readdir(dir)) {
+        if (std::strncmp(e->d_name, "rx-", 3) == 0) ++info.rx_queues;
+        if (std::strncmp(e->d_name, "tx-", 3) == 0) ++info.tx_queues;
     }
+    closedir(dir);
+}
+
+static void load(DeviceMapping& dev) {
+    IfaceInfo& info = dev.info;
+    info = IfaceInfo{};
+    char buf[64];
+    if (!read_sys(dev.name, "mtu", buf, sizeof(buf))) {
+        // pseudo-devices such as "any" have no sysfs entry
+        dev.description = !dev.present ? "gone" : !dev.pcap_desc.empty() ? dev.pcap_desc : "No description";
+        return;
+    }
+    info.mtu        = std::atoi(buf);
+    info.speed_mbps = std::max(read_sys_int(dev.name, "speed"), 0);      // -1 or EINVAL while the link is down
+    info.physical   = read_sys(dev.name, "device/uevent", buf, sizeof(buf));
+    info.driver     = driver_of(dev.name);
+    if (read_sys(dev.name, "operstate", buf, sizeof(buf))) info.operstate = buf;
+    count_queues(dev.name, info);
+
+    std::string& d = dev.description;
+    d = !info.driver.empty() ? info.driver : dev.name == "lo" ? "loopback" : info.physical ? "device" : "virtual";
+    if (!info.operstate.empty() && info.operstate != "unknown") d += ", " + info.operstate;
+    if (info.speed_mbps >= 1'000)  d += ", " + std::to_string(info.speed_mbps / 1'000) + " Gb/s";
+    else if (info.speed_mbps > 0)  d += ", " + std::to_string(info.speed_mbps) + " Mb/s";
+    d += ", mtu " + std::to_string(info.mtu);
+    if (info.rx_queues > 1 || info.tx_queues > 1) {
+        d += ", " + std::to_string(info.rx_queues) + "/" + std::to_string(info.tx_queues) + " queues";
+    }
+}
+#else
+static void load(DeviceMapping& dev) {
+    dev.description = !dev.pcap_desc.empty() ? dev.pcap_desc : "No description";
+}
+#endif
 
+DeviceMapping match_iface_pcap(const pcap_if_t* iface) {
+    DeviceMapping dev;
+    dev.name = iface->name;
+    if (iface->description) dev.pcap_desc = iface->description;
     return dev;
-}
\ No newline at end of file
+}
+
+const std::string& describe(DeviceMapping& dev) {
+    if (!dev.loaded) {
+        load(dev);
+        dev.loaded = true;
+    }
+    return dev.description;
+}
+
+const IfaceInfo& iface_info(DeviceMapping& dev) {
+    describe(dev);
+    return dev.info;
+}
+
+#ifdef __linux__
+bool LinkWatcher::open() {
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd_ < 0) return false;
+    sockaddr_nl sa{};
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_LINK;
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void LinkWatcher::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool LinkWatcher::poll(std::vector<LinkEvent>& out) {
+    if (fd_ < 0) return true;
+    alignas(nlmsghdr) char buf[16 << 10];
+    while (true) {
+        const ssize_t n = recv(fd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n < 0 && errno == ENOBUFS) return false;    // the kernel dropped some while we weren't looking
+        if (n <= 0) return true;
+        int len = static_cast<int>(n);
+        for (auto* h = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(h, len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_type != RTM_NEWLINK && h->nlmsg_type != RTM_DELLINK) continue;
+            const auto* ifi  = static_cast<const ifinfomsg*>(NLMSG_DATA(h));
+            int         alen = static_cast<int>(IFLA_PAYLOAD(h));
+            for (auto* a = IFLA_RTA(ifi); RTA_OK(a, alen); a = RTA_NEXT(a, alen)) {
+                if (a->rta_type != IFLA_IFNAME) continue;
+                out.push_back({static_cast<const char*>(RTA_DATA(a)), h->nlmsg_type == RTM_DELLINK});
+                break;
+            }
+        }
+    }
+}
+#else
+bool LinkWatcher::open() { return false; }
+void LinkWatcher::close() {}
+bool LinkWatcher::poll(std::vector<LinkEvent>&) { return true; }
+#endif
@@ -0,0 +1,362 @@
+//
+// Created by Shaunik Musukula on 7/11/25.
+//
+
+#include "offline.h"
+#include "search.h"
+#include "capture.h"
+#include "options.h"
+#include "filter.h"
+#include "pcap_helpers.h"
+#include "pcapng.h"
+#include "state.h"
+#include "util.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#pragma pack(push, 1)
+
+struct pcap_record_header {
+    std::uint32_t ts_sec;
+    std::uint32_t ts_frac;
+    std::uint32_t incl_len;
+    std::uint32_t orig_len;
+};
+
+#pragma pack(pop)
+
+static std::uint32_t swap32(const std::uint32_t v) {
+    return __builtin_bswap32(v);
+}
+
+static CaptureShard& offline_shard() {
+    if (gShards.empty()) {
+        // without the ui nobody looks at the bytes, so don't copy them
+        gShards.emplace_back(std::make_unique<CaptureShard>(gCfg.tui ? gCfg.payload_mem : 0, 0, gCfg.flow_slots,
+                                                            gCfg.flow_timeout, gCfg.tui ? gCfg.reasm_bytes : 0,
+                                                            gCfg.dns_slots, gCfg.dns_timeout,
+                                                            gCfg.sketch_width, gCfg.hll_bits));
+    }
+    return *gShards.front();
+}
+
+static bpf_program gOfflineProg{};
+
+// There is no kernel in the way here, so a --filter runs in userspace and every
+// packet of the file counts as seen.
+static void setup_filter(const int linktype, const int snaplen) {
+    if (!gCfg.filter) return;
+    if (!compile_offline_filter(gCfg.filter, linktype, snaplen, gOfflineProg)) {
+        std::fprintf(stderr, "filter: %s\n", gErr);
+        std::exit(EXIT_FAILURE);
+    }
+    gFilter.expr  = gCfg.filter;
+    gFilter.insns = static_cast<int>(gOfflineProg.bf_len);
+}
+
+// The --since/--until window in ns, fixed once the first packet's time is known.
+static std::int64_t gFromNs   = INT64_MIN;
+static std::int64_t gToNs     = INT64_MAX;
+static bool         gRangeSet = false;
+
+static void set_range(const std::int64_t first_ns) {
+    const auto at = [first_ns](const TimeBound& b) {
+        const auto ns = static_cast<std::int64_t>(b.secs * 1e9);
+        return b.relative ? first_ns + ns : ns;
+    };
+    if (gCfg.since.set) gFromNs = at(gCfg.since);
+    if (gCfg.until.set) gToNs   = at(gCfg.until);
+    gRangeSet = true;
+}
+
+// One thread is both producer and consumer of the shard queue here, so it just
+// drains often enough that the queue can never fill.
+static void feed(CaptureShard& shard, const pcap_pkthdr* h, const std::uint8_t* pkt, std::size_t& n) {
+    if (gCfg.since.set || gCfg.until.set) {
+        const std::int64_t ns = ts_to_ns(h->ts, gNanoTs);
+        if (!gRangeSet) set_range(ns);
+        if (ns < gFromNs || ns >= gToNs) return;
+    }
+    if (++n % OFFLINE_DRAIN_EVERY == 0) drain_captured();
+    if (gOfflineProg.bf_insns) {
+        ++gFilter.seen;
+        if (!pcap_offline_filter(&gOfflineProg, h, pkt)) return;
+        ++gFilter.kept;
+    }
+    packet_cb(reinterpret_cast<std::uint8_t* >(&shard), h, pkt);
+}
+
+static bool run_mmap(const char* path, OfflineResult& res) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(pcap_file_header)) {
+        close(fd);
+        return false;
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void*      map  = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const auto* base = static_cast<const std::uint8_t*>(map);
+    std::uint32_t magic;
+    std::memcpy(&magic, base, sizeof(magic));
+
+    const bool swapped = magic == swap32(PCAP_MAGIC_USEC) || magic == swap32(PCAP_MAGIC_NSEC);
+    if (swapped) magic = swap32(magic);
+    if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC) {
+        munmap(map, size);
+        return false;
+    }
+    gNanoTs = magic == PCAP_MAGIC_NSEC;
+
+    pcap_file_header fh;
+    std::memcpy(&fh, base, sizeof(fh));
+    // files carry LINKTYPE_* values; they equal the DLT_* ones except for raw IP
+    int linktype = static_cast<int>(swapped ? swap32(fh.linktype) : fh.linktype);
+    if (linktype == LINKTYPE_RAW) linktype = DLT_RAW;
+    setup_filter(linktype, static_cast<int>(swapped ? swap32(fh.snaplen) : fh.snaplen));
+
+    CaptureShard& shard = offline_shard();
+    shard.linktype      = linktype;
+    std::size_t   off   = sizeof(pcap_file_header);
+    std::size_t   n     = 0;
+    pcap_pkthdr   h{};
+    while (off + sizeof(pcap_record_header) <= size && !gCapLim.hit()) {
+        pcap_record_header rh;
+        std::memcpy(&rh, base + off, sizeof(rh));
+        if (swapped) {
+            rh.ts_sec   = swap32(rh.ts_sec);
+            rh.ts_frac  = swap32(rh.ts_frac);
+            rh.incl_len = swap32(rh.incl_len);
+            rh.orig_len = swap32(rh.orig_len);
+        }
+        off += sizeof(rh);
+        if (off + rh.incl_len > size) break;
+
+        h.ts.tv_sec  = rh.ts_sec;
+        h.ts.tv_usec = rh.ts_frac;
+        h.caplen     = rh.incl_len;
+        h.len        = rh.orig_len;
+        feed(shard, &h, base + off, n);
+        off += rh.incl_len;
+    }
+    drain_captured();
+    shard.flows.publish();
+    shard.sketch.publish();
+
+    if (gOfflineProg.bf_insns) pcap_freecode(&gOfflineProg);
+    munmap(map, size);
+    res.packets    = n;
+    res.file_bytes = off;
+    return true;
+}
+
+static void offline_cb(std::uint8_t* user, const pcap_pkthdr* h, const std::uint8_t* pkt) {
+    auto* n = reinterpret_cast<std::size_t* >(user);
+    feed(offline_shard(), h, pkt, *n);
+}
+
+static void run_libpcap(const char* path, OfflineResult& res) {
+    const unsigned prec = gCfg.nano_ts ? PCAP_TSTAMP_PRECISION_NANO : PCAP_TSTAMP_PRECISION_MICRO;
+    pcap_t*        p    = pcap_open_offline_with_tstamp_precision(path, prec, gErr);
+    if (!p) {
+        std::fprintf(stderr, "%s\n", gErr);
+        std::exit(EXIT_FAILURE);
+    }
+    gNanoTs = gCfg.nano_ts;
+    setup_filter(pcap_datalink(p), pcap_snapshot(p));
+
+    CaptureShard& shard = offline_shard();
+    shard.linktype      = pcap_datalink(p);
+    std::size_t   n     = 0;
+    while (!gCapLim.hit()) {
+        if (pcap_dispatch(p, OFFLINE_DRAIN_EVERY, offline_cb, reinterpret_cast<std::uint8_t* >(&n)) <= 0) break;
+    }
+    drain_captured();
+    shard.flows.publish();
+    shard.sketch.publish();
+
+    if (struct stat st{}; stat(path, &st) == 0) res.file_bytes = static_cast<std::size_t>(st.st_size);
+    res.packets = n;
+    if (gOfflineProg.bf_insns) pcap_freecode(&gOfflineProg);
+    pcap_close(p);
+}
+
+struct IndexedFeed {
+    PcapngReader* rd;
+    std::size_t   n;
+};
+
+// the interfaces in one file may have different link types
+static void indexed_cb(std::uint8_t* user, const pcap_pkthdr* h, const std::uint8_t* pkt) {
+    auto*         f     = reinterpret_cast<IndexedFeed*>(user);
+    CaptureShard& shard = offline_shard();
+    shard.linktype      = f->rd->packet_linktype();
+    feed(shard, h, pkt, f->n);
+}
+
+// Files written with --pcapng: only the blocks whose time range meets the
+// --since/--until window are read from disk and decompressed.
+static bool run_indexed(const char* path, OfflineResult& res) {
+    PcapngReader rd;
+    std::string  err;
+    if (!rd.open(path, err)) {
+        if (err.empty()) return false;
+        std::fprintf(stderr, "%s: %s\n", path, err.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    const auto& lts = rd.linktypes();
+    if (gCfg.filter && std::any_of(lts.begin(), lts.end(), [&](const int lt) { return lt != lts.front(); })) {
+        std::fprintf(stderr, "%s: its interfaces have different link types, which one --filter can't match\n", path);
+        std::exit(EXIT_FAILURE);
+    }
+    gNanoTs = rd.nano();
+    setup_filter(rd.linktype(), rd.snaplen());
+    set_range(rd.first_ns());
+
+    CaptureShard& shard = offline_shard();
+    IndexedFeed   f{&rd, 0};
+    const auto&   index = rd.index();
+    for (std::size_t i = 0; i < index.size() && !gCapLim.hit(); ++i) {
+        if (index[i].max_ns < gFromNs || index[i].min_ns >= gToNs) continue;
+        if (!rd.read_block(i, indexed_cb, reinterpret_cast<std::uint8_t* >(&f))) {
+            std::fprintf(stderr, "%s: damaged block at offset %llu, stopping there\n", path,
+                         static_cast<unsigned long long>(index[i].offset));
+            break;
+        }
+        ++res.blocks_read;
+        res.file_bytes += index[i].length;
+    }
+    drain_captured();
+    shard.flows.publish();
+    shard.sketch.publish();
+
+    res.blocks  = index.size();
+    res.packets = f.n;
+    if (gOfflineProg.bf_insns) pcap_freecode(&gOfflineProg);
+    return true;
+}
+
+OfflineResult run_offline(const char* path) {
+    OfflineResult res;
+    const auto    t0 = std::chrono::steady_clock::now();
+    if (!run_indexed(path, res) && !run_mmap(path, res)) run_libpcap(path, res);
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return res;
+}
+
+void print_offline_summary(const char* path, const OfflineResult& res) {
+    const CounterTotals c    = total_counters();
+    const double        secs = res.seconds > 0 ? res.seconds : 1e-9;
+
+    std::printf("%s\n", path);
+    std::printf("  packets  %zu  (TCP %zu  UDP %zu  ICMP %zu  ICMP6 %zu  ARP %zu  other %zu)\n",
+                c.all, c.of(Proto::kTcp), c.of(Proto::kUdp), c.of(Proto::kIcmp), c.of(Proto::kIcmp6),
+                c.of(Proto::kArp), c.of(Proto::kOther));
+    std::printf("  bytes    %s\n", human_bytes(c.total_bytes).c_str());
+    if (c.all > 0) {
+        std::printf("  sizes   ");
+        for (std::size_t i = 0; i < SIZE_BUCKETS; ++i) {
+            std::printf(" %s %.1f%%", SIZE_LABELS[i], 100.0 * static_cast<double>(c.sizes[i]) / static_cast<double>(c.all));
+        }
+        std::printf("\n");
+    }
+    std::printf("  elapsed  %.3f s\n", res.seconds);
+    std::printf("  rate     %.2f Mpkt/s  %.1f MB/s\n",
+                static_cast<double>(res.packets) / secs / 1e6,
+                static_cast<double>(res.file_bytes) / secs / (1 << 20));
+    if (res.blocks) {
+        std::printf("  index    read %zu of %zu compressed blocks, %s\n", res.blocks_read, res.blocks,
+                    human_bytes(res.file_bytes).c_str());
+    }
+
+    HistSnapshot decode, book;
+    for (const auto& s : gShards) {
+        decode.add(s->instr.decode);
+        book.add(s->instr.book);
+    }
+    std::printf("  decode   %s per packet\n", decode.summary(true).c_str());
+    std::printf("  book     %s per packet\n", book.summary(true).c_str());
+
+    if (gSearching) {
+        std::printf("  match    \"%s\" in %zu packets\n", gSearch.text().c_str(), c.matches);
+    }
+    if (!gFilter.expr.empty()) {
+        std::printf("  filter   \"%s\" (%d insns) kept %zu of %zu packets\n",
+                    gFilter.expr.c_str(), gFilter.insns, gFilter.kept, gFilter.seen);
+    }
+
+    if (c.of(Proto::kTcp)) {
+        std::printf("  tcp      %zu retransmissions, %zu out of order, %zu duplicate ACKs, %zu zero windows\n",
+                    c.retrans, c.ooo, c.dup_acks, c.zero_wins);
+    }
+
+    if (const DnsTotals dns = dns_totals(); dns.queries + dns.responses) {
+        std::printf("  dns      %zu queries, %zu responses, %zu unanswered, %zu still pending at the end, "
+                    "%zu responses to unseen queries, %zu forgotten\n",
+                    dns.queries, dns.responses, dns.unanswered, dns.pending, dns.unmatched, dns.forgotten);
+        char r[INET6_ADDRSTRLEN];
+        for (const DnsResolverTotals& res : dns.resolvers) {
+            if (res.family) format_addr(res.family, res.addr, r, sizeof(r));
+            else            std::snprintf(r, sizeof(r), "other");
+            std::printf("    %-39s %zu queries, %zu unanswered, %s\n", r, res.queries, res.unanswered,
+                        res.latency.summary(true).c_str());
+        }
+        for (std::size_t i = 0; i < DNS_RCODES; ++i) {
+            if (dns.rcodes[i] == 0) continue;
+            std::printf("    %-39s %zu responses, %s\n", DNS_RCODE_NAMES[i], dns.rcodes[i], dns.by_rcode[i].summary(true).c_str());
+        }
+    }
+
+    if (gShards.empty()) return;
+    const FlowTop top = gShards[0]->flows.top();
+    std::printf("  flows    %zu active, %zu evicted\n", gShards[0]->flows.active(), gShards[0]->flows.evicted());
+    char a[INET6_ADDRSTRLEN], b[INET6_ADDRSTRLEN];
+    for (std::size_t i = 0; i < std::min<std::size_t>(top.n_bytes, OFFLINE_TOP_FLOWS); ++i) {
+        const FlowEntry& e = top.by_bytes[i];
+        format_addr(e.key.family, e.key.a, a, sizeof(a));
+        format_addr(e.key.family, e.key.b, b, sizeof(b));
+        std::printf("    %s:%u <-> %s:%u  %s  %llu pkts  %s\n", a, e.key.port_a, b, e.key.port_b,
+                    proto_name(e.key.proto), static_cast<unsigned long long>(e.packets),
+                    human_bytes(e.bytes).c_str());
+    }
+
+    TrafficSketch sk(gCfg.sketch_width, gCfg.hll_bits);
+    gShards[0]->sketch.load(sk);
+    if (sk.hosts.enabled()) {
+        std::printf("  distinct ~%.0f hosts  ~%.0f flows  (+/-%.1f%%)\n",
+                    sk.hosts.estimate(), sk.flows.estimate(), 100 * sk.hosts.error());
+    }
+    if (sk.src.enabled() && sk.src.total() > 0) {
+        CountMinTop<HostKey>::Item       hosts[OFFLINE_TOP_FLOWS];
+        CountMinTop<std::uint16_t>::Item ports[OFFLINE_TOP_FLOWS];
+        std::printf("  heavy hitters by packets, counts at most %.0f high\n",
+                    sk.src.error() * static_cast<double>(sk.src.total()));
+        const auto print_hosts = [&](const char* what, const CountMinTop<HostKey>& s) {
+            for (std::size_t i = 0, n = s.top(hosts, OFFLINE_TOP_FLOWS); i < n; ++i) {
+                format_addr(hosts[i].key.family, hosts[i].key.addr, a, sizeof(a));
+                std::printf("    %-5s %-39s %llu\n", what, a, static_cast<unsigned long long>(hosts[i].count));
+            }
+        };
+        print_hosts("src", sk.src);
+        print_hosts("dst", sk.dst);
+        for (std::size_t i = 0, n = sk.dport.top(ports, OFFLINE_TOP_FLOWS); i < n; ++i) {
+            std::printf("    dport %-39u %llu\n", ports[i].key, static_cast<unsigned long long>(ports[i].count));
+        }
+    }
+}
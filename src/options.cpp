@@ -0,0 +1,343 @@
+//
+// Created by Shaunik Musukula on 7/10/25.
+//
+
+#include "options.h"
+#include "tcp_analysis.h"
+
+#include <getopt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pcap/pcap.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+CaptureConfig gCfg;
+
+static void usage(const char* prog) {
+    std::fprintf(stderr,
+                 "usage: %s [options]\n"
+                 "  --nano                 request nanosecond capture timestamps\n"
+                 "  --tstamp-type <type>   timestamp source: host, host_lowprec, host_hiprec,\n"
+                 "                         adapter, adapter_unsynced\n"
+                 "  --snaplen <bytes>      bytes captured per packet (default %d)\n"
+                 "  --headers-only         same as --snaplen %d\n"
+                 "  --buffer-size <size>   kernel capture ring size, accepts K/M/G suffixes\n"
+                 "  --timeout <ms>         read timeout / block retire timeout (default %d)\n"
+                 "  --immediate            deliver packets as soon as they arrive\n"
+                 "  --workers <n>          capture threads sharing the interface (Linux, max %d)\n"
+                 "  --fanout <mode>        how packets are spread over workers: hash (per flow,\n"
+                 "                         default), cpu (per receiving cpu), lb (round robin)\n"
+                 "  -i, --interface <name> capture on this device; repeat to capture on several at\n"
+                 "                         once (default: the first one found)\n"
+                 "  -r, --read <file>      analyse a saved capture instead of a live device\n"
+                 "  -f, --filter <expr>    BPF capture filter, e.g. \"tcp port 443\"\n"
+                 "  --since <time>         with --read: skip packets before this time, in seconds\n"
+                 "                         since the epoch or +seconds after the first packet\n"
+                 "  --until <time>         with --read: skip packets from this time on\n"
+                 "  --tui                  with --read: browse the results afterwards\n"
+                 "  -w, --write <template> capture file name, strftime conversions and %%n (file\n"
+                 "                         index) are expanded (default capture.pcap)\n"
+                 "  --no-write             don't save packets\n"
+                 "  --rotate-size <size>   start a new file after this many bytes\n"
+                 "  --rotate-seconds <n>   start a new file every n seconds\n"
+                 "  --rotate-packets <n>   start a new file after n packets\n"
+                 "  --max-files <n>        keep only the newest n files\n"
+                 "  --pcapng               write gzip-compressed pcapng with a time index that\n"
+                 "                         --read uses to skip to --since (default name\n"
+                 "                         capture.pcapng.gz)\n"
+                 "  --compress <level>     deflate level for --pcapng, 0..9 (default %d)\n"
+                 "  --flow-slots <n>       flow table size across all workers (default %d, 0 = off)\n"
+                 "  --flow-timeout <s>     forget flows idle for this long (default %d)\n"
+                 "  --reassemble <size>    memory for reassembling the first %zuK of each TCP\n"
+                 "                         stream, shown in the flow detail (default 0 = off)\n"
+                 "  --dns-slots <n>        DNS queries awaiting a response, across all workers\n"
+                 "                         (default %d, 0 = off)\n"
+                 "  --dns-timeout <s>      a DNS query unanswered this long is lost (default %d)\n"
+                 "  --sketch-width <n>     counters per heavy-hitter sketch row (default %d, 0 = off)\n"
+                 "  --hll-bits <n>         distinct-count precision, %d..%d (default %d, 0 = off)\n"
+                 "  --payload-mem <size>   memory for the packet bytes behind the hex pane, oldest\n"
+                 "                         evicted first (default %zuM, 0 = keep none)\n"
+                 "  --spool-size <size>    disk for scrollback past the rows kept in memory\n"
+                 "                         (default %zuM, 0 = off)\n"
+                 "  --spool-dir <dir>      where the spool file goes (default $TMPDIR or /var/tmp)\n"
+                 "  --match <pattern>      count packets whose payload contains the pattern; text,\n"
+                 "                         i:text (any case) or x:hex bytes\n"
+                 "  --stop-packets <n>     stop capturing after n packets\n"
+                 "  --stop-bytes <size>    stop capturing after this many bytes\n"
+                 "  --stop-seconds <n>     stop capturing after n seconds\n"
+                 "  --headless             no UI: capture until a stop condition, SIGINT or SIGTERM\n"
+                 "  --metrics <[addr:]port> serve Prometheus metrics on http://addr:port/metrics\n"
+                 "                         (addr defaults to 127.0.0.1); implies --headless\n"
+                 "  --json <file>          append a JSON line of metrics every interval, - for\n"
+                 "                         stdout; implies --headless\n"
+                 "  --interval <s>         seconds between metric updates (default %d)\n"
+                 "  --record <size>        flight recorder: keep the newest packets in a ring of\n"
+                 "                         this size and write them only when a trigger fires\n"
+                 "  --record-seconds <n>   a dump reaches back at most n seconds (default: all)\n"
+                 "  --post-seconds <n>     traffic written after a trigger (default %d)\n"
+                 "  --trigger-filter <expr> dump when a packet matches this BPF expression\n"
+                 "  --trigger-pps <n>      dump when the packet rate reaches n per second\n"
+                 "  --trigger-rst <n>      dump when TCP resets reach n per second\n",
+                 prog, SNAPLEN_DEFAULT, SNAPLEN_HEADERS, READ_TIMEOUT_MS, MAX_WORKERS, COMPRESS_DEFAULT,
+                 FLOW_SLOTS_DEFAULT, FLOW_TIMEOUT_S, REASM_CHUNK >> 10, DNS_SLOTS_DEFAULT, DNS_TIMEOUT_S,
+                 SKETCH_WIDTH_DEFAULT, HLL_BITS_MIN, HLL_BITS_MAX,
+                 HLL_BITS_DEFAULT, PAYLOAD_MEM_DEFAULT >> 20, SPOOL_BYTES_DEFAULT >> 20, INTERVAL_DEFAULT_S,
+                 POST_SECONDS_DEFAULT);
+}
+
+static long long parse_size(const char* s) {
+    char*     end = nullptr;
+    long long v   = std::strtoll(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; ++end; break;
+        case 'm': case 'M': v <<= 20; ++end; break;
+        case 'g': case 'G': v <<= 30; ++end; break;
+        default: break;
+    }
+    if (end == s || *end != '\0' || v < 0) {
+        std::fprintf(stderr, "invalid size: %s\n", s);
+        std::exit(EXIT_FAILURE);
+    }
+    return v;
+}
+
+static int parse_int(const char* s, const long long max = INT_MAX) {
+    const long long v = parse_size(s);
+    if (v > max) {
+        std::fprintf(stderr, "value too large: %s\n", s);
+        std::exit(EXIT_FAILURE);
+    }
+    return static_cast<int>(v);
+}
+
+static std::size_t parse_count(const char* s) {
+    return static_cast<std::size_t>(parse_size(s));
+}
+
+static TimeBound parse_time(const char* s) {
+    TimeBound t;
+    t.set      = true;
+    t.relative = *s == '+';
+    char* end  = nullptr;
+    t.secs     = std::strtod(s + t.relative, &end);
+    if (end == s + t.relative || *end != '\0' || t.secs < 0) {
+        std::fprintf(stderr, "invalid time: %s\n", s);
+        std::exit(EXIT_FAILURE);
+    }
+    return t;
+}
+
+void parse_args(const int argc, char** argv) {
+    enum { kNano = 256, kTstampType, kSnaplen, kHeadersOnly, kBufferSize, kTimeout, kImmediate,
+           kWorkers, kFanout, kTui, kNoWrite, kRotateSize, kRotateSeconds, kRotatePackets, kMaxFiles,
+           kPcapng, kCompress, kSince, kUntil,
+           kFlowSlots, kFlowTimeout, kReassemble, kDnsSlots, kDnsTimeout, kSketchWidth, kHllBits, kPayloadMem,
+           kSpoolSize, kSpoolDir, kMatch, kStopPackets, kStopBytes, kStopSeconds, kHeadless, kMetrics,
+           kJson, kInterval, kRecord, kRecordSeconds, kPostSeconds, kTriggerFilter, kTriggerPps, kTriggerRst };
+    static const option longopts[] = {
+        {"nano",           no_argument,       nullptr, kNano},
+        {"tstamp-type",    required_argument, nullptr, kTstampType},
+        {"snaplen",        required_argument, nullptr, kSnaplen},
+        {"headers-only",   no_argument,       nullptr, kHeadersOnly},
+        {"buffer-size",    required_argument, nullptr, kBufferSize},
+        {"timeout",        required_argument, nullptr, kTimeout},
+        {"immediate",      no_argument,       nullptr, kImmediate},
+        {"workers",        required_argument, nullptr, kWorkers},
+        {"fanout",         required_argument, nullptr, kFanout},
+        {"interface",      required_argument, nullptr, 'i'},
+        {"read",           required_argument, nullptr, 'r'},
+        {"filter",         required_argument, nullptr, 'f'},
+        {"tui",            no_argument,       nullptr, kTui},
+        {"write",          required_argument, nullptr, 'w'},
+        {"no-write",       no_argument,       nullptr, kNoWrite},
+        {"rotate-size",    required_argument, nullptr, kRotateSize},
+        {"rotate-seconds", required_argument, nullptr, kRotateSeconds},
+        {"rotate-packets", required_argument, nullptr, kRotatePackets},
+        {"max-files",      required_argument, nullptr, kMaxFiles},
+        {"pcapng",         no_argument,       nullptr, kPcapng},
+        {"compress",       required_argument, nullptr, kCompress},
+        {"since",          required_argument, nullptr, kSince},
+        {"until",          required_argument, nullptr, kUntil},
+        {"flow-slots",     required_argument, nullptr, kFlowSlots},
+        {"flow-timeout",   required_argument, nullptr, kFlowTimeout},
+        {"reassemble",     required_argument, nullptr, kReassemble},
+        {"dns-slots",      required_argument, nullptr, kDnsSlots},
+        {"dns-timeout",    required_argument, nullptr, kDnsTimeout},
+        {"sketch-width",   required_argument, nullptr, kSketchWidth},
+        {"hll-bits",       required_argument, nullptr, kHllBits},
+        {"payload-mem",    required_argument, nullptr, kPayloadMem},
+        {"spool-size",     required_argument, nullptr, kSpoolSize},
+        {"spool-dir",      required_argument, nullptr, kSpoolDir},
+        {"match",          required_argument, nullptr, kMatch},
+        {"stop-packets",   required_argument, nullptr, kStopPackets},
+        {"stop-bytes",     required_argument, nullptr, kStopBytes},
+        {"stop-seconds",   required_argument, nullptr, kStopSeconds},
+        {"headless",       no_argument,       nullptr, kHeadless},
+        {"metrics",        required_argument, nullptr, kMetrics},
+        {"json",           required_argument, nullptr, kJson},
+        {"interval",       required_argument, nullptr, kInterval},
+        {"record",         required_argument, nullptr, kRecord},
+        {"record-seconds", required_argument, nullptr, kRecordSeconds},
+        {"post-seconds",   required_argument, nullptr, kPostSeconds},
+        {"trigger-filter", required_argument, nullptr, kTriggerFilter},
+        {"trigger-pps",    required_argument, nullptr, kTriggerPps},
+        {"trigger-rst",    required_argument, nullptr, kTriggerRst},
+        {"help",           no_argument,       nullptr, 'h'},
+        {nullptr,          0,                 nullptr, 0},
+    };
+
+    bool named = false;
+    int  opt;
+    while ((opt = getopt_long(argc, argv, "i:r:w:f:", longopts, nullptr)) != -1) {
+        switch (opt) {
+            case kNano:          gCfg.nano_ts        = true;                           break;
+            case kTstampType:
+                gCfg.tstamp_type = pcap_tstamp_type_name_to_val(optarg);
+                if (gCfg.tstamp_type == PCAP_ERROR) {
+                    std::fprintf(stderr, "unknown timestamp type: %s\n", optarg);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case kSnaplen:       gCfg.snaplen        = parse_int(optarg, 262'144);     break;
+            case kHeadersOnly:   gCfg.snaplen        = SNAPLEN_HEADERS;                break;
+            case kBufferSize:    gCfg.buffer_bytes   = parse_int(optarg);              break;
+            case kTimeout:       gCfg.timeout_ms     = parse_int(optarg);              break;
+            case kImmediate:     gCfg.immediate      = true;                           break;
+            case kWorkers:       gCfg.workers        = parse_int(optarg, MAX_WORKERS); break;
+            case kFanout:
+                if      (std::strcmp(optarg, "hash") == 0) gCfg.fanout = FanoutMode::kHash;
+                else if (std::strcmp(optarg, "cpu")  == 0) gCfg.fanout = FanoutMode::kCpu;
+                else if (std::strcmp(optarg, "lb")   == 0) gCfg.fanout = FanoutMode::kLoadBalance;
+                else {
+                    std::fprintf(stderr, "unknown fanout mode: %s\n", optarg);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'i':            gCfg.devices.push_back(optarg);                       break;
+            case 'r':            gCfg.read_file      = optarg;                         break;
+            case 'f':            gCfg.filter         = optarg;                         break;
+            case kTui:           gCfg.tui            = true;                           break;
+            case 'w':            gCfg.write_file     = optarg; named = true;           break;
+            case kNoWrite:       gCfg.write_file     = nullptr;                        break;
+            case kRotateSize:    gCfg.rotate_bytes   = parse_count(optarg);            break;
+            case kRotateSeconds: gCfg.rotate_seconds = parse_int(optarg);              break;
+            case kRotatePackets: gCfg.rotate_packets = parse_count(optarg);            break;
+            case kMaxFiles:      gCfg.max_files      = parse_int(optarg);              break;
+            case kPcapng:        gCfg.pcapng         = true;                           break;
+            case kCompress:      gCfg.compress_level = parse_int(optarg, 9);           break;
+            case kSince:         gCfg.since          = parse_time(optarg);             break;
+            case kUntil:         gCfg.until          = parse_time(optarg);             break;
+            case kFlowSlots:     gCfg.flow_slots     = parse_count(optarg);            break;
+            case kFlowTimeout:   gCfg.flow_timeout   = parse_int(optarg);              break;
+            case kReassemble:    gCfg.reasm_bytes    = parse_count(optarg);            break;
+            case kDnsSlots:      gCfg.dns_slots      = parse_count(optarg);            break;
+            case kDnsTimeout:    gCfg.dns_timeout    = parse_int(optarg, 3'600);       break;
+            case kSketchWidth:   gCfg.sketch_width   = parse_int(optarg, 1 << 24);     break;
+            case kHllBits:
+                gCfg.hll_bits = parse_int(optarg, HLL_BITS_MAX);
+                if (gCfg.hll_bits != 0 && gCfg.hll_bits < HLL_BITS_MIN) {
+                    std::fprintf(stderr, "--hll-bits must be 0 or %d..%d\n", HLL_BITS_MIN, HLL_BITS_MAX);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case kPayloadMem:    gCfg.payload_mem    = parse_count(optarg);            break;
+            case kSpoolSize:     gCfg.spool_bytes    = parse_count(optarg);            break;
+            case kSpoolDir:      gCfg.spool_dir      = optarg;                         break;
+            case kMatch:         gCfg.match          = optarg;                         break;
+            case kStopPackets:   gCfg.stop_packets   = parse_count(optarg);            break;
+            case kStopBytes:     gCfg.stop_bytes     = parse_count(optarg);            break;
+            case kStopSeconds:   gCfg.stop_seconds   = parse_count(optarg);            break;
+            case kHeadless:      gCfg.headless       = true;                           break;
+            case kMetrics:       gCfg.metrics        = optarg;                         break;
+            case kJson:          gCfg.json           = optarg;                         break;
+            case kInterval:      gCfg.interval       = parse_int(optarg, 3'600);       break;
+            case kRecord:        gCfg.record_bytes   = parse_count(optarg);            break;
+            case kRecordSeconds: gCfg.record_seconds = parse_int(optarg);              break;
+            case kPostSeconds:   gCfg.post_seconds   = parse_int(optarg, 86'400);      break;
+            case kTriggerFilter: gCfg.trigger_filter = optarg;                         break;
+            case kTriggerPps:    gCfg.trigger_pps    = parse_count(optarg);            break;
+            case kTriggerRst:    gCfg.trigger_rst    = parse_count(optarg);            break;
+            case 'h':            usage(argv[0]); std::exit(EXIT_SUCCESS);
+            default:             usage(argv[0]); std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (gCfg.workers < 1) gCfg.workers = 1;
+#ifndef __linux__
+    if (gCfg.workers > 1) {
+        std::fprintf(stderr, "--workers needs PACKET_FANOUT, which is Linux only\n");
+        std::exit(EXIT_FAILURE);
+    }
+#endif
+    if (gCfg.spool_bytes != 0 && gCfg.spool_bytes < SPOOL_BYTES_MIN) {
+        std::fprintf(stderr, "--spool-size must be 0 or at least %zuM\n", SPOOL_BYTES_MIN >> 20);
+        std::exit(EXIT_FAILURE);
+    }
+    if ((gCfg.stop_packets != 0) + (gCfg.stop_bytes != 0) + (gCfg.stop_seconds != 0) > 1) {
+        std::fprintf(stderr, "use only one of --stop-packets, --stop-bytes and --stop-seconds\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.reasm_bytes && !gCfg.flow_slots) {
+        std::fprintf(stderr, "--reassemble needs the flow table, not --flow-slots 0\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.dns_timeout < 1) {
+        std::fprintf(stderr, "--dns-timeout must be at least 1\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.interval < 1) {
+        std::fprintf(stderr, "--interval must be at least 1\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (!gCfg.record_bytes && (gCfg.trigger_filter || gCfg.trigger_pps || gCfg.trigger_rst)) {
+        std::fprintf(stderr, "--trigger-filter, --trigger-pps and --trigger-rst need --record\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.record_bytes) {
+        if (gCfg.read_file || !gCfg.write_file) {
+            std::fprintf(stderr, "--record needs live capture and somewhere to write, not -r or --no-write\n");
+            std::exit(EXIT_FAILURE);
+        }
+        if (gCfg.post_seconds < 1) {
+            std::fprintf(stderr, "--post-seconds must be at least 1\n");
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if (gCfg.compress_level >= 0 && !gCfg.pcapng) {
+        std::fprintf(stderr, "--compress is for --pcapng output\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.pcapng) {
+        if (gCfg.compress_level < 0) gCfg.compress_level = COMPRESS_DEFAULT;
+        if (gCfg.write_file && !named) gCfg.write_file = "capture.pcapng.gz";
+    }
+    if ((gCfg.since.set || gCfg.until.set) && !gCfg.read_file) {
+        std::fprintf(stderr, "--since and --until select packets from a file, with -r\n");
+        std::exit(EXIT_FAILURE);
+    }
+    if (gCfg.metrics || gCfg.json) gCfg.headless = true;
+    if (gCfg.headless) {
+        if (gCfg.read_file) {
+            std::fprintf(stderr, "--headless, --metrics and --json are for live capture; -r already runs without the UI\n");
+            std::exit(EXIT_FAILURE);
+        }
+        gCfg.payload_mem = 0;       // the bytes are only ever looked at in the UI
+        gCfg.spool_bytes = 0;
+        gCfg.reasm_bytes = 0;
+    }
+    if (!gCfg.spool_dir) {
+        const char* tmp = std::getenv("TMPDIR");
+        gCfg.spool_dir  = tmp && *tmp ? tmp : "/var/tmp";     // /tmp is often RAM-backed
+    }
+}
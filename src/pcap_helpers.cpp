@@ -3,75 +3,257 @@
 //
 
 #include "pcap_helpers.h"
+#include "capture.h"
 #include "state.h"
 #include "util.h"
 #include "rendering.h"
 #include "net_types.h"
+#include "options.h"
+#include "filter.h"
+#include "search.h"
+#include "trigger.h"
 
-void open_device(const std::size_t idx) {
-    if (gHandle) {
-        pcap_close(gHandle);
-        gHandle = nullptr;
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/if_packet.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// nullptr, with the reason in gErr, if the device can't be opened
+static pcap_t* open_handle(const char* name, const bool nano) {
+    pcap_t* handle = pcap_create(name, gErr);
+    if (!handle) return nullptr;
+
+    // On Linux, libpcap reads through the TPACKET_V3 mmap ring: pcap_dispatch hands
+    // packet_cb pointers straight into the kernel's blocks. Immediate mode makes
+    // libpcap fall back to TPACKET_V2 (one frame per slot), so it is opt-in.
+    pcap_set_snaplen(handle, gCfg.snaplen);
+    pcap_set_promisc(handle, PROMISCUOUS_MODE);
+    pcap_set_timeout(handle, gCfg.timeout_ms);
+    pcap_set_immediate_mode(handle, gCfg.immediate ? 1 : 0);
+    if (gCfg.buffer_bytes > 0) pcap_set_buffer_size(handle, gCfg.buffer_bytes);
+    if (gCfg.tstamp_type >= 0) pcap_set_tstamp_type(handle, gCfg.tstamp_type);
+    if (nano) pcap_set_tstamp_precision(handle, PCAP_TSTAMP_PRECISION_NANO);
+
+    if (const int rc = pcap_activate(handle); rc < 0) {
+        std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s: %s: %s", name, pcap_statustostr(rc), pcap_geterr(handle));
+        pcap_close(handle);
+        return nullptr;
     }
+    pcap_setnonblock(handle, 1, gErr);
+    return handle;
+}
 
-    gHandle = pcap_open_live(gDevices[idx].iface->name,
-                             BUFSIZ,
-                             PROMISCUOUS_MODE,
-                             1'000,
-                             gErr);
-    if (!gHandle) {
+// Puts the handle's packet socket into the interface's fanout group so the
+// kernel spreads its traffic over all workers. Hash mode keeps both directions
+// of a flow on the same shard.
+static void join_fanout(pcap_t* handle, const std::size_t group) {
+#ifdef __linux__
+    std::uint32_t mode = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+    if (gCfg.fanout == FanoutMode::kCpu)         mode = PACKET_FANOUT_CPU;
+    if (gCfg.fanout == FanoutMode::kLoadBalance) mode = PACKET_FANOUT_LB;
+
+    const std::uint32_t arg = ((static_cast<std::uint32_t>(getpid()) + group) & 0xFFFF) | (mode << 16);
+    if (setsockopt(pcap_fileno(handle), SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0) {
         endwin();
-        std::fprintf(stderr, "%s\n", gErr);
+        std::fprintf(stderr, "PACKET_FANOUT: %s\n", std::strerror(errno));
         std::exit(EXIT_FAILURE);
     }
+#else
+    (void)handle;
+    (void)group;
+#endif
+}
 
-    gDumper = pcap_dump_open(gHandle, "capture.pcap");
-    if (!gDumper) {
-        std::fprintf(stderr, "Couldn't open dump file: %s\n", pcap_geterr(gHandle));
+void close_devices() {
+    stop_capture();
+    gWriter.stop();
+    for (const auto& s : gShards) if (s->handle) pcap_close(s->handle);
+    gShards.clear();
+}
+
+static void close_handles(std::vector<pcap_t*>& handles) {
+    for (pcap_t* h : handles) pcap_close(h);
+    handles.clear();
+}
+
+// One handle per worker on every interface in gCapDevs, interface-major, so
+// handle i belongs to worker i % workers. They are only activated: the fanout
+// group is joined once the old handles are gone. False, with nothing left
+// open and the reason in gErr, if one can't be opened or the set can't be
+// captured together.
+static bool open_handles(std::vector<pcap_t*>& handles) {
+    const std::size_t workers = static_cast<std::size_t>(gCfg.workers);
+    for (bool nano = gCfg.nano_ts;; nano = false) {
+        for (const std::size_t d : gCapDevs) {
+            for (std::size_t i = 0; i < workers; ++i) {
+                pcap_t* h = open_handle(gDevices[d].name.c_str(), nano);
+                if (!h) {
+                    close_handles(handles);
+                    return false;
+                }
+                handles.push_back(h);
+            }
+        }
+        // one history can't mix timestamp precisions
+        const int precision = pcap_get_tstamp_precision(handles.front());
+        if (!nano || std::all_of(handles.begin(), handles.end(),
+                                 [&](pcap_t* h) { return pcap_get_tstamp_precision(h) == precision; })) {
+            break;
+        }
+        close_handles(handles);
     }
 
-    pcap_setnonblock(gHandle, 1, gErr);
+    // pcapng gives every interface its own link type; a classic pcap file and
+    // the trigger filter have only one
+    for (std::size_t i = 0; i < handles.size(); ++i) {
+        if (pcap_datalink(handles[i]) == pcap_datalink(handles.front())) continue;
+        const char* a = gDevices[gCapDevs.front()].name.c_str();
+        const char* b = gDevices[gCapDevs[i / workers]].name.c_str();
+        if (gWriter.enabled() && !gWriter.pcapng()) {
+            std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s and %s have different link types, which one pcap file "
+                                                  "can't hold; use --pcapng or --no-write", a, b);
+        } else if (gCfg.trigger_filter) {
+            std::snprintf(gErr, PCAP_ERRBUF_SIZE, "%s and %s have different link types, which one "
+                                                  "--trigger-filter can't match", a, b);
+        } else {
+            continue;
+        }
+        close_handles(handles);
+        return false;
+    }
+    return true;
+}
+
+// a shard around each handle, splitting the budgets evenly between them
+static void open_shards(const std::vector<pcap_t*>& handles) {
+    const std::size_t workers = static_cast<std::size_t>(gCfg.workers);
+    const std::size_t n       = handles.size();
+    const std::size_t ring    = gWriter.enabled() ? (gCfg.record_bytes ? gCfg.record_bytes : DUMP_RING_BYTES) / n : 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        auto shard      = std::make_unique<CaptureShard>(gCfg.payload_mem / n, ring, gCfg.flow_slots / n,
+                                                         gCfg.flow_timeout, gCfg.reasm_bytes / n,
+                                                         gCfg.dns_slots / n, gCfg.dns_timeout,
+                                                         gCfg.sketch_width, gCfg.hll_bits);
+        shard->id       = static_cast<std::uint8_t>(i);
+        shard->dev      = static_cast<std::uint8_t>(i / workers);
+        shard->handle   = handles[i];
+        shard->linktype = pcap_datalink(shard->handle);
+        if (workers > 1) join_fanout(shard->handle, shard->dev);
+        gShards.emplace_back(std::move(shard));
+    }
+}
+
+bool open_devices(const bool clear_limit) {
+    // the new handles are opened before the running capture is touched, so
+    // it is left alone if they can't be
+    std::vector<pcap_t*> handles;
+    if (!open_handles(handles)) return false;
+    close_devices();
+    if (clear_limit) gCapLim.reset();
+    open_shards(handles);
+
+    pcap_t* first = gShards.front()->handle;
+    if (!gFilter.expr.empty() && !set_filter(gFilter.expr)) {
+        gFilter.error = gErr;
+        gFilter.expr.clear();
+    }
+    gNanoTs = pcap_get_tstamp_precision(first) == PCAP_TSTAMP_PRECISION_NANO;
+    if (!compile_trigger_filter(pcap_datalink(first), pcap_snapshot(first))) {
+        endwin();
+        std::fprintf(stderr, "--trigger-filter: %s\n", gErr);
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<DumpRing*>     rings;
+    std::vector<std::uint32_t> ring_ifaces;
+    std::vector<std::string>   ifaces;
+    std::vector<int>           linktypes(gCapDevs.size());
+    for (const auto& s : gShards) {
+        rings.push_back(&s->dump);
+        ring_ifaces.push_back(s->dev);
+        linktypes[s->dev] = s->linktype;
+    }
+    for (const std::size_t d : gCapDevs) ifaces.push_back(gDevices[d].name);
+    gWriter.start(std::move(rings), std::move(ring_ifaces), std::move(ifaces), std::move(linktypes),
+                  pcap_snapshot(first), gNanoTs);
 
     gRows.clear();
-    gCnt.clear();
+    gSpool.reset();
     gSelected = gFirstVis = 0;
-    gCapLim.reset();
+
+    start_capture();
+    return true;
 }
 
-void maintain_selection() {
+// Once the user has scrolled away from the newest row, the selection and the
+// view both stay on the same packets while new ones arrive above them.
+void maintain_selection(const std::size_t added) {
     if (gSelected > 0) {
-        ++gSelected;
-        if (gSelected >= gRows.size()) gSelected = gRows.size() - 1;
+        gSelected += added;
+        gFirstVis += added;
+        if (gSelected >= history_size()) gSelected = history_size() - 1;
+        if (gFirstVis > gSelected) gFirstVis = gSelected;
     }
 }
 
-void packet_cb([[maybe_unused]] std::uint8_t* user,
-               const pcap_pkthdr* h,
-               const std::uint8_t*      pkt) {
-    if (gPaused || gCapLim.hit(gCnt)) return;
-    if (gDumper) pcap_dump(reinterpret_cast<std::uint8_t* >(gDumper), h, pkt);
+void decode_packet(const pcap_pkthdr* h, const std::uint8_t* pkt, const int linktype, PacketRecord& r, Decoded& d) {
+    dissect(pkt, h->caplen, linktype, d);
+    r.ts        = h->ts;
+    r.len       = h->len;
+    r.src       = d.src;
+    r.dst       = d.dst;
+    r.family    = d.family;
+    r.proto     = d.proto;
+    r.sport     = d.sport;
+    r.dport     = d.dport;
+    r.tcp_flags = d.tcp_flags;
+}
 
-    const auto* ip = reinterpret_cast<const ip_header* >(pkt + SIZE_ETHERNET);
-    Row          r{now_string(), inet_ntoa(ip->ip_src), inet_ntoa(ip->ip_dst), "", h->len};
+void packet_cb(std::uint8_t*       user,
+               const pcap_pkthdr*  h,
+               const std::uint8_t* pkt) {
+    auto& shard = *reinterpret_cast<CaptureShard* >(user);
+    Counters::bump(shard.cnt.delivered);
 
-    switch (ip->ip_p) {
-        case IPPROTO_TCP: ++gCnt.tcp;   r.proto = "TCP";   break;
-        case IPPROTO_UDP: ++gCnt.udp;   r.proto = "UDP";   break;
-        case IPPROTO_ICMP:++gCnt.icmp;  r.proto = "ICMP";  break;
-        default:          ++gCnt.other; r.proto = "OTH";   break;
+    if (gPaused.load(std::memory_order_relaxed) || !gCapLim.admit(h, gNanoTs)) return;
+    StageTimer t(shard.instr.timed());
+    if (gWriter.enabled()) {
+        shard.dump.push(h, pkt);
+        check_packet_trigger(h, pkt);
+        t.lap(shard.instr.dump);
     }
 
-    ++gCnt.all;
-    gCnt.bytes += h->len;
+    PacketRecord r{};
+    Decoded      d;
+    decode_packet(h, pkt, shard.linktype, r, d);
+    t.lap(shard.instr.decode);
+    r.shard = shard.id;
+    shard.cnt.count(r.proto, r.len);
+    if (r.proto == Proto::kTcp && (r.tcp_flags & TH_RST)) Counters::bump(shard.cnt.rsts);
+    const std::int64_t now_ns = ts_to_ns(r.ts, gNanoTs);
+    if (const std::uint8_t ev = shard.flows.update(r, d, pkt, now_ns)) shard.cnt.tcp_events(ev);
+    if (is_dns(r)) shard.dns.update(r, d, pkt, now_ns);
+    shard.sketch.add(r);
 
-    if (gShowHex) {
-        const std::size_t ip_len = IP_HL(ip)*  4;
-        const auto*       pl     = pkt + SIZE_ETHERNET + ip_len;
-        const std::size_t pl_len = h->caplen - static_cast<std::size_t>(pl - pkt);
-        r.payload.assign(pl, pl + pl_len);
+    // kept whether or not the hex pane is open, so any packet still in the
+    // arena can be inspected later; it shows the transport header onwards
+    const std::uint32_t pl_at = d.l4_off ? d.l4_off : d.pl_off;
+    if (const Pattern* m = gMatch.load(std::memory_order_acquire);
+        m && pl_at < d.pl_end && m->find(pkt + pl_at, d.pl_end - pl_at) != NO_MATCH) {
+        Counters::bump(shard.cnt.matches);
+    }
+    if (shard.payload.enabled() && pl_at < d.pl_end) {
+        r.pl_len = std::min<std::uint32_t>(d.pl_end - pl_at, PayloadRing::MAX_APPEND);
+        r.pl_off = shard.payload.append(pkt + pl_at, r.pl_len);
     }
 
-    if (gRows.size() == MAX_ROWS) gRows.erase(gRows.begin());
-    gRows.emplace_back(std::move(r));
-    maintain_selection();
-}
\ No newline at end of file
+    if (!shard.queue.push(std::move(r))) Counters::bump(shard.cnt.dropped);
+    t.lap(shard.instr.book);
+}
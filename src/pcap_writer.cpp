@@ -0,0 +1,329 @@
+//
+// Created by Shaunik Musukula on 7/13/25.
+//
+
+#include "pcap_writer.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+static std::int64_t now_seconds() {
+    using namespace std::chrono;
+    return duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// writev until everything is out or it fails; returns the bytes written
+static std::size_t writev_all(const int fd, iovec* iov, int cnt) {
+    std::size_t total = 0;
+    while (cnt > 0) {
+        const ssize_t n = writev(fd, iov, cnt);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += static_cast<std::size_t>(n);
+        for (std::size_t left = static_cast<std::size_t>(n); left > 0 && cnt > 0;) {
+            const std::size_t step = std::min(left, iov->iov_len);
+            iov->iov_base  = static_cast<std::uint8_t*>(iov->iov_base) + step;
+            iov->iov_len  -= step;
+            left          -= step;
+            if (iov->iov_len == 0) {
+                ++iov;
+                --cnt;
+            }
+        }
+    }
+    return total;
+}
+
+void DumpRing::put(const std::uint64_t at, const void* src, const std::size_t len) {
+    const std::size_t off = at % cap_;
+    const std::size_t n1  = std::min(len, cap_ - off);
+    std::memcpy(buf_.get() + off, src, n1);
+    std::memcpy(buf_.get(), static_cast<const std::uint8_t*>(src) + n1, len - n1);
+}
+
+bool DumpRing::push(const pcap_pkthdr* h, const std::uint8_t* pkt) {
+    const std::size_t   need = PCAP_RECORD_BYTES + h->caplen;
+    const std::uint64_t head = head_.load(std::memory_order_relaxed);
+    if (mode_) {
+        if (need > cap_) return false;
+        // the tail is ours while overwriting: step it past whole records
+        std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+        while (cap_ - (head - tail) < need) {
+            std::uint32_t rec[4];
+            copy(tail, rec, sizeof(rec));
+            tail += PCAP_RECORD_BYTES + rec[2];
+        }
+        tail_.store(tail, std::memory_order_release);
+        tail_cache_ = tail;
+    } else if (cap_ - (head - tail_cache_) < need) {
+        tail_cache_ = tail_.load(std::memory_order_acquire);
+        if (cap_ - (head - tail_cache_) < need) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    const std::uint32_t rec[4] = {
+        static_cast<std::uint32_t>(h->ts.tv_sec), static_cast<std::uint32_t>(h->ts.tv_usec),
+        h->caplen, h->len,
+    };
+    put(head, rec, sizeof(rec));
+    put(head + sizeof(rec), pkt, h->caplen);
+    head_.store(head + need, std::memory_order_release);
+    return true;
+}
+
+void DumpRing::copy(const std::uint64_t at, void* out, const std::size_t len) const {
+    const std::uint8_t *a, *b;
+    std::size_t         a_len, b_len;
+    segments(at, len, a, a_len, b, b_len);
+    std::memcpy(out, a, a_len);
+    std::memcpy(static_cast<std::uint8_t*>(out) + a_len, b, b_len);
+}
+
+void DumpRing::segments(const std::uint64_t at, const std::size_t len, const std::uint8_t*& a, std::size_t& a_len,
+                        const std::uint8_t*& b, std::size_t& b_len) const {
+    const std::size_t off = at % cap_;
+    a     = buf_.get() + off;
+    a_len = std::min(len, cap_ - off);
+    b     = buf_.get();
+    b_len = len - a_len;
+}
+
+void PcapWriter::configure(std::string name_template, const RotatePolicy& policy) {
+    template_ = std::move(name_template);
+    policy_   = policy;
+}
+
+void PcapWriter::configure_recorder(const int pre_seconds, const int post_seconds) {
+    pre_seconds_  = pre_seconds;
+    post_seconds_ = post_seconds;
+}
+
+void PcapWriter::configure_pcapng(const int level) {
+    level_ = level;
+}
+
+void PcapWriter::start(std::vector<DumpRing*> rings, std::vector<std::uint32_t> ring_ifaces,
+                       std::vector<std::string> ifaces, std::vector<int> linktypes, const int snaplen, const bool nano) {
+    stop();
+    if (!enabled()) return;
+    if (file_open() && (linktypes != linktypes_ || nano != nano_ || (ng_.is_open() && ifaces != ifaces_))) close_file();
+
+    rings_       = std::move(rings);
+    ring_ifaces_ = std::move(ring_ifaces);
+    ifaces_      = std::move(ifaces);
+    linktypes_   = std::move(linktypes);
+    snaplen_     = snaplen;
+    nano_        = nano;
+    pending_     = false;
+    thread_      = std::thread(&PcapWriter::run, this);
+}
+
+void PcapWriter::stop() {
+    if (!thread_.joinable()) return;
+    stop_ = true;
+    thread_.join();
+    stop_ = false;
+    rings_.clear();
+}
+
+void PcapWriter::close() {
+    stop();
+    close_file();
+}
+
+void PcapWriter::run() {
+    if (recorder()) {
+        record();
+        return;
+    }
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (!drain_once()) std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+    }
+    while (drain_once()) {}
+}
+
+bool PcapWriter::trigger(const char* why) {
+    bool idle = false;
+    if (!recorder() || !pending_.compare_exchange_strong(idle, true, std::memory_order_acq_rel)) return false;
+    why_.store(why, std::memory_order_relaxed);
+    triggers_.store(triggers_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void PcapWriter::record() {
+    for (DumpRing* r : rings_) r->set_overwrite(true);
+    while (!stop_.load(std::memory_order_relaxed)) {
+        if (pending_.load(std::memory_order_acquire)) dump_triggered();
+        else                                          std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+    }
+}
+
+// The capture threads hand the tails back between batches; from then on the
+// rings drain like a normal capture until the post-trigger window is over.
+void PcapWriter::dump_triggered() {
+    for (DumpRing* r : rings_) r->set_overwrite(false);
+    while (!std::all_of(rings_.begin(), rings_.end(), [](const DumpRing* r) { return r->synced(); })) {
+        if (stop_.load(std::memory_order_relaxed)) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    skip_before_ = pre_seconds_ > 0 ? static_cast<std::uint32_t>(std::time(nullptr) - pre_seconds_) : 0;
+    close_file();                   // every dump gets a file of its own
+    const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(post_seconds_);
+    while (!stop_.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < until) {
+        if (!drain_once()) std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_IDLE_MS));
+    }
+    drain_once();
+    close_file();
+    skip_before_ = 0;
+
+    for (DumpRing* r : rings_) r->set_overwrite(true);
+    pending_.store(false, std::memory_order_release);
+}
+
+bool PcapWriter::drain_once() {
+    if (file_open() && policy_.max_seconds > 0 && file_packets_ > 0 &&
+        now_seconds() - file_opened_ >= policy_.max_seconds) {
+        close_file();
+    }
+
+    bool wrote = false;
+    for (std::size_t i = 0; i < rings_.size(); ++i) wrote |= write_ring(*rings_[i], ring_ifaces_[i]);
+    ng_.flush_stale();
+    return wrote;
+}
+
+// Writes the longest run of whole records that fits in the current file,
+// straight out of the ring (at most two iovecs when the run wraps), or as
+// pcapng packet blocks handed to the compressor.
+bool PcapWriter::write_ring(DumpRing& ring, const std::uint32_t iface) {
+    std::size_t avail = std::min(ring.readable(), DUMP_MAX_WRITE);
+    if (avail == 0) return false;
+
+    std::uint64_t at      = ring.tail();
+    std::size_t   run     = 0;
+    bool          skipped = false;
+    while (run + PCAP_RECORD_BYTES <= avail) {
+        std::uint32_t rec[4];
+        ring.copy(at + run, rec, sizeof(rec));
+        const std::size_t sz = PCAP_RECORD_BYTES + rec[2];
+        if (run + sz > avail) break;
+        if (rec[0] < skip_before_) {        // from before the recorder's window
+            if (run > 0) break;
+            ring.consume(sz);
+            at      += sz;
+            avail   -= sz;
+            skipped  = true;
+            continue;
+        }
+
+        const bool full = !file_open()
+                       || (policy_.max_bytes   && file_packets_ > 0 && file_bytes_ + sz > policy_.max_bytes)
+                       || (policy_.max_packets && file_packets_ >= policy_.max_packets);
+        if (full) {
+            if (run > 0) break;
+            open_next();
+        }
+        run           += sz;
+        file_bytes_   += sz;
+        file_packets_ += 1;
+    }
+    if (run == 0) return skipped;
+
+    if (ng_.is_open()) {
+        for (std::size_t off = 0; off < run;) {
+            std::uint32_t rec[4];
+            ring.copy(at + off, rec, sizeof(rec));
+            const std::uint8_t *a, *b;
+            std::size_t         a_len, b_len;
+            ring.segments(at + off + PCAP_RECORD_BYTES, rec[2], a, a_len, b, b_len);
+            ng_.add(iface, rec, a, a_len, b, b_len);
+            off += PCAP_RECORD_BYTES + rec[2];
+        }
+    } else if (fd_ >= 0) {
+        const std::uint8_t *a, *b;
+        std::size_t         a_len, b_len;
+        ring.segments(at, run, a, a_len, b, b_len);
+        iovec iov[2] = {{const_cast<std::uint8_t*>(a), a_len}, {const_cast<std::uint8_t*>(b), b_len}};
+        const std::size_t n = writev_all(fd_, iov, b_len ? 2 : 1);
+        if (n < run) close_file();          // the rest of the file would be misaligned
+        bytes_.store(bytes_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    ring.consume(run);
+    return true;
+}
+
+void PcapWriter::open_next() {
+    close_file();
+
+    const std::string name = file_name(index_++);
+    file_bytes_   = sizeof(pcap_file_header);
+    file_packets_ = 0;
+    file_opened_  = now_seconds();
+    if (level_ >= 0) {
+        if (!ng_.open(name, ifaces_, linktypes_, snaplen_, nano_, level_, &bytes_)) return;
+    } else {
+        fd_ = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) return;
+
+        pcap_file_header fh{};
+        fh.magic         = nano_ ? 0xA1B23C4D : 0xA1B2C3D4;
+        fh.version_major = 2;
+        fh.version_minor = 4;
+        fh.snaplen       = static_cast<bpf_u_int32>(snaplen_);
+        fh.linktype      = static_cast<bpf_u_int32>(linktypes_.front());
+        if (::write(fd_, &fh, sizeof(fh)) != static_cast<ssize_t>(sizeof(fh))) {
+            close_file();
+            return;
+        }
+    }
+    files_.store(files_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    kept_.push_back(name);
+    while (policy_.max_files > 0 && kept_.size() > static_cast<std::size_t>(policy_.max_files)) {
+        ::unlink(kept_.front().c_str());
+        kept_.pop_front();
+    }
+}
+
+void PcapWriter::close_file() {
+    ng_.close();
+    if (fd_ < 0) return;
+    ::close(fd_);
+    fd_ = -1;
+}
+
+// The template goes through strftime, with %n for the file index. A template
+// without any '%' gets "-<index>" before its extension from the second file on.
+std::string PcapWriter::file_name(const std::size_t index) const {
+    std::string tmpl = template_;
+    if (tmpl.find('%') == std::string::npos) {
+        if (index == 0) return tmpl;
+        const auto dot   = tmpl.find_last_of('.');
+        const auto slash = tmpl.find_last_of('/');
+        const auto at    = (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? tmpl.size() : dot;
+        return tmpl.insert(at, "-" + std::to_string(index));
+    }
+
+    for (std::size_t p = tmpl.find("%n"); p != std::string::npos; p = tmpl.find("%n", p)) {
+        const std::string idx = std::to_string(index);
+        tmpl.replace(p, 2, idx);
+        p += idx.size();
+    }
+
+    const std::time_t t = std::time(nullptr);
+    std::tm           tm{};
+    localtime_r(&t, &tm);
+    char out[4'096];
+    const std::size_t n = std::strftime(out, sizeof(out), tmpl.c_str(), &tm);
+    return n ? std::string(out, n) : tmpl;
+}
@@ -0,0 +1,418 @@
+//
+// Created by Shaunik Musukula on 7/26/25.
+//
+
+#include "pcapng.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+constexpr std::uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4D;
+constexpr std::uint32_t PCAPNG_PEN        = 0;             // IANA-reserved: the blocks are private, see pcapng.h
+constexpr std::uint32_t INDEX_VERSION     = 1;
+constexpr char          INDEX_MAGIC[8]    = {'s', 'n', 'i', 'f', 'f', 'i', 'd', 'x'};
+constexpr char          TRAILER_MAGIC[8]  = {'s', 'n', 'i', 'f', 'f', 'e', 'n', 'd'};
+constexpr std::size_t   TRAILER_BLOCK     = 40;            // the custom block inside the trailer member
+constexpr std::size_t   GZIP_HEADER       = 10;
+constexpr int           GZIP_WINDOW_BITS  = 15 + 16;       // deflate with a gzip wrapper
+
+static std::int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+static void put(std::vector<std::uint8_t>& out, const T v) {
+    const std::size_t at = out.size();
+    out.resize(at + sizeof(T));
+    std::memcpy(out.data() + at, &v, sizeof(T));
+}
+
+template <typename T>
+static T get(const std::uint8_t* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+static void put_option(std::vector<std::uint8_t>& body, const std::uint16_t code, const void* data, const std::size_t len) {
+    put(body, code);
+    put(body, static_cast<std::uint16_t>(len));
+    const std::size_t at = body.size();
+    body.resize(at + ((len + 3) & ~std::size_t{3}), 0);
+    std::memcpy(body.data() + at, data, len);
+}
+
+// type, length, body padded to 4 bytes, length again
+static void put_block(std::vector<std::uint8_t>& out, const std::uint32_t type, const std::vector<std::uint8_t>& body) {
+    const auto total = static_cast<std::uint32_t>(12 + ((body.size() + 3) & ~std::size_t{3}));
+    put(out, type);
+    put(out, total);
+    out.insert(out.end(), body.begin(), body.end());
+    out.resize(out.size() + (total - 12 - body.size()), 0);
+    put(out, total);
+}
+
+// out of line, where z_stream_s is complete
+PcapngFile::PcapngFile() = default;
+
+PcapngFile::~PcapngFile() {
+    close();
+}
+
+bool PcapngFile::open(const std::string& path, const std::vector<std::string>& ifaces, const std::vector<int>& linktypes,
+                      const int snaplen, const bool nano, const int level, std::atomic<std::size_t>* written) {
+    close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) return false;
+
+    zs_ = std::make_unique<z_stream_s>();
+    if (deflateInit2(zs_.get(), level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        zs_.reset();
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    nano_    = nano;
+    written_ = written;
+    offset_  = 0;
+    failed_  = false;
+    done_    = false;
+    index_.clear();
+    cur_ = Block{};
+    cur_.raw.reserve(PCAPNG_BLOCK_BYTES + (64 << 10));
+
+    // the section header and one interface block per device make the first member
+    std::vector<std::uint8_t> head, body;
+    put(body, PCAPNG_BYTE_ORDER);
+    put(body, std::uint16_t{1});
+    put(body, std::uint16_t{0});
+    put(body, std::int64_t{-1});                                // section length unknown
+    put_option(body, 4, "sniffer", 7);                          // shb_userappl
+    put_option(body, 0, nullptr, 0);
+    put_block(head, PCAPNG_SHB, body);
+    for (std::size_t i = 0; i < ifaces.size(); ++i) {
+        const std::string& name = ifaces[i];
+        body.clear();
+        put(body, static_cast<std::uint16_t>(linktypes[i]));
+        put(body, std::uint16_t{0});
+        put(body, static_cast<std::uint32_t>(snaplen));
+        put_option(body, 2, name.data(), name.size());          // if_name
+        if (nano) {
+            const std::uint8_t resol = 9;
+            put_option(body, 9, &resol, 1);                     // if_tsresol
+        }
+        put_option(body, 0, nullptr, 0);
+        put_block(head, PCAPNG_IDB, body);
+    }
+    if (!write_member(head.data(), head.size(), nullptr)) {
+        deflateEnd(zs_.get());
+        zs_.reset();
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    thread_ = std::thread(&PcapngFile::run, this);
+    return true;
+}
+
+void PcapngFile::add(const std::uint32_t iface, const std::uint32_t rec[4], const std::uint8_t* a,
+                     const std::size_t a_len, const std::uint8_t* b, const std::size_t b_len) {
+    if (fd_ < 0) return;
+    const std::uint32_t cap    = rec[2];
+    const std::uint32_t padded = (cap + 3) & ~3u;
+    const std::uint32_t total  = 32 + padded;
+    const std::uint64_t ts     = static_cast<std::uint64_t>(rec[0]) * (nano_ ? 1'000'000'000 : 1'000'000) + rec[1];
+    const auto          ns     = static_cast<std::int64_t>(nano_ ? ts : ts * 1'000);
+
+    if (cur_.packets == 0) {
+        cur_.min_ns    = cur_.max_ns = ns;
+        cur_opened_ms_ = now_ms();
+    } else {
+        cur_.min_ns = std::min(cur_.min_ns, ns);
+        cur_.max_ns = std::max(cur_.max_ns, ns);
+    }
+
+    std::vector<std::uint8_t>& raw = cur_.raw;
+    const std::size_t at = raw.size();
+    raw.resize(at + total);
+    std::uint8_t* p = raw.data() + at;
+    const std::uint32_t hdr[7] = {PCAPNG_EPB, total, iface, static_cast<std::uint32_t>(ts >> 32),
+                                  static_cast<std::uint32_t>(ts), cap, rec[3]};
+    std::memcpy(p, hdr, sizeof(hdr));
+    std::memcpy(p + sizeof(hdr), a, a_len);
+    std::memcpy(p + sizeof(hdr) + a_len, b, b_len);
+    std::memset(p + sizeof(hdr) + cap, 0, padded - cap);
+    std::memcpy(p + sizeof(hdr) + padded, &total, sizeof(total));
+    ++cur_.packets;
+
+    if (raw.size() >= PCAPNG_BLOCK_BYTES) submit();
+}
+
+void PcapngFile::flush_stale() {
+    if (fd_ >= 0 && cur_.packets > 0 && now_ms() - cur_opened_ms_ >= PCAPNG_FLUSH_MS) submit();
+}
+
+// Waits while PCAPNG_IN_FLIGHT blocks are queued, so a slow disk backs up
+// into the dump rings, which drop and count like they always do.
+void PcapngFile::submit() {
+    if (cur_.packets == 0) return;
+    std::vector<std::uint8_t> next;
+    {
+        std::unique_lock lock(mu_);
+        cv_.wait(lock, [this] { return queue_.size() < PCAPNG_IN_FLIGHT; });
+        queue_.push_back(std::move(cur_));
+        if (!spare_.empty()) {
+            next = std::move(spare_.back());
+            spare_.pop_back();
+        }
+    }
+    cv_.notify_all();
+    cur_ = Block{};
+    next.clear();
+    cur_.raw = std::move(next);
+    cur_.raw.reserve(PCAPNG_BLOCK_BYTES + (64 << 10));
+}
+
+void PcapngFile::run() {
+    while (true) {
+        Block b;
+        {
+            std::unique_lock lock(mu_);
+            cv_.wait(lock, [this] { return done_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            b = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        cv_.notify_all();
+
+        PcapngIndexEntry e{};
+        if (write_member(b.raw.data(), b.raw.size(), &e)) {
+            e.packets = b.packets;
+            e.min_ns  = b.min_ns;
+            e.max_ns  = b.max_ns;
+            index_.push_back(e);
+        }
+        std::lock_guard lock(mu_);
+        spare_.push_back(std::move(b.raw));
+    }
+}
+
+bool PcapngFile::write_all(const void* p, std::size_t n) {
+    const auto* c = static_cast<const std::uint8_t*>(p);
+    while (n > 0) {
+        const ssize_t w = ::write(fd_, c, n);
+        if (w < 0) return false;
+        c += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+// One complete gzip member; after a failed write the rest of the file is
+// dropped rather than left with a hole.
+bool PcapngFile::write_member(const std::uint8_t* p, const std::size_t n, PcapngIndexEntry* e) {
+    if (failed_) return false;
+    z_stream_s& zs = *zs_;
+    deflateReset(&zs);
+    out_.resize(deflateBound(&zs, n));
+    zs.next_in   = const_cast<Bytef*>(p);
+    zs.avail_in  = static_cast<uInt>(n);
+    zs.next_out  = out_.data();
+    zs.avail_out = static_cast<uInt>(out_.size());
+    const bool        done = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+    const std::size_t len  = out_.size() - zs.avail_out;
+    if (!done || !write_all(out_.data(), len)) {
+        failed_ = true;
+        return false;
+    }
+    if (e) {
+        e->offset     = offset_;
+        e->length     = static_cast<std::uint32_t>(len);
+        e->raw_length = static_cast<std::uint32_t>(n);
+    }
+    offset_ += len;
+    if (written_) written_->store(written_->load(std::memory_order_relaxed) + len, std::memory_order_relaxed);
+    return true;
+}
+
+void PcapngFile::close() {
+    if (fd_ < 0) return;
+    submit();
+    {
+        std::lock_guard lock(mu_);
+        done_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    // the index as a custom block of its own member...
+    std::vector<std::uint8_t> body, block;
+    put(body, PCAPNG_PEN);
+    body.insert(body.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    put(body, INDEX_VERSION);
+    put(body, static_cast<std::uint32_t>(index_.size()));
+    const std::size_t at = body.size();
+    body.resize(at + index_.size() * sizeof(PcapngIndexEntry));
+    if (!index_.empty()) std::memcpy(body.data() + at, index_.data(), index_.size() * sizeof(PcapngIndexEntry));
+    put_block(block, PCAPNG_CB, body);
+    PcapngIndexEntry idx{};
+    if (write_member(block.data(), block.size(), &idx)) {
+        // ...and a trailer of fixed size, in a stored (uncompressed) deflate
+        // block written by hand so a reader finds it at the end of the file
+        body.clear();
+        block.clear();
+        put(body, PCAPNG_PEN);
+        body.insert(body.end(), TRAILER_MAGIC, TRAILER_MAGIC + sizeof(TRAILER_MAGIC));
+        put(body, idx.offset);
+        put(body, idx.length);
+        put(body, idx.raw_length);
+        put_block(block, PCAPNG_CB, body);
+
+        std::vector<std::uint8_t> t = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF, 0x01};
+        put(t, static_cast<std::uint16_t>(block.size()));
+        put(t, static_cast<std::uint16_t>(~block.size()));
+        t.insert(t.end(), block.begin(), block.end());
+        put(t, static_cast<std::uint32_t>(crc32(crc32(0, nullptr, 0), block.data(), static_cast<uInt>(block.size()))));
+        put(t, static_cast<std::uint32_t>(block.size()));
+        if (write_all(t.data(), t.size()) && written_) {
+            written_->store(written_->load(std::memory_order_relaxed) + t.size(), std::memory_order_relaxed);
+        }
+    }
+
+    deflateEnd(zs_.get());
+    zs_.reset();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+PcapngReader::~PcapngReader() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool PcapngReader::read_member(const std::uint64_t offset, const std::size_t length, const std::size_t raw_hint) {
+    in_.resize(length);
+    if (pread(fd_, in_.data(), length, static_cast<off_t>(offset)) != static_cast<ssize_t>(length)) return false;
+
+    z_stream zs{};
+    if (inflateInit2(&zs, GZIP_WINDOW_BITS) != Z_OK) return false;
+    out_.resize(std::max<std::size_t>(raw_hint, 64 << 10));
+    zs.next_in  = in_.data();
+    zs.avail_in = static_cast<uInt>(length);
+    int rc      = Z_OK;
+    while (rc == Z_OK) {
+        if (zs.total_out == out_.size()) out_.resize(out_.size() * 2);
+        zs.next_out  = out_.data() + zs.total_out;
+        zs.avail_out = static_cast<uInt>(out_.size() - zs.total_out);
+        rc           = inflate(&zs, Z_NO_FLUSH);
+        if (rc == Z_BUF_ERROR && zs.avail_out == 0) rc = Z_OK;      // just out of room
+    }
+    out_.resize(zs.total_out);
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+bool PcapngReader::open(const char* path, std::string& err) {
+    fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd_ < 0 || fstat(fd_, &st) < 0 || static_cast<std::size_t>(st.st_size) < PCAPNG_TRAILER_BYTES) return false;
+    const auto size = static_cast<std::uint64_t>(st.st_size);
+
+    // the trailer: a gzip header, one stored block, the custom block, crc and size
+    std::uint8_t t[PCAPNG_TRAILER_BYTES];
+    if (pread(fd_, t, sizeof(t), static_cast<off_t>(size - sizeof(t))) != static_cast<ssize_t>(sizeof(t))) return false;
+    const std::uint8_t* blk = t + GZIP_HEADER + 5;
+    if (t[0] != 0x1F || t[1] != 0x8B || t[GZIP_HEADER] != 0x01 || get<std::uint16_t>(t + GZIP_HEADER + 1) != TRAILER_BLOCK ||
+        get<std::uint32_t>(blk) != PCAPNG_CB || get<std::uint32_t>(blk + 4) != TRAILER_BLOCK ||
+        std::memcmp(blk + 12, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0) {
+        return false;
+    }
+    const auto idx_off = get<std::uint64_t>(blk + 20);
+    const auto idx_len = get<std::uint32_t>(blk + 28);
+    const auto idx_raw = get<std::uint32_t>(blk + 32);
+    err = "damaged index";
+    if (idx_off + idx_len > size - PCAPNG_TRAILER_BYTES || !read_member(idx_off, idx_len, idx_raw)) return false;
+    if (out_.size() < 32 || get<std::uint32_t>(out_.data()) != PCAPNG_CB ||
+        std::memcmp(out_.data() + 12, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        get<std::uint32_t>(out_.data() + 20) != INDEX_VERSION) {
+        return false;
+    }
+    const std::size_t n = get<std::uint32_t>(out_.data() + 24);
+    if (28 + n * sizeof(PcapngIndexEntry) + 4 > out_.size()) return false;
+    index_.resize(n);
+    if (n) std::memcpy(index_.data(), out_.data() + 28, n * sizeof(PcapngIndexEntry));
+    for (const PcapngIndexEntry& e : index_) {
+        if (e.offset + e.length > idx_off) return false;
+    }
+
+    // the section header, then every interface's link type; the resolution
+    // and snaplen are the same for all of them, so the first one's will do
+    err = "damaged header";
+    const std::uint64_t head_len = index_.empty() ? idx_off : index_.front().offset;
+    if (!read_member(0, head_len, 0) || out_.size() < 28 || get<std::uint32_t>(out_.data()) != PCAPNG_SHB ||
+        get<std::uint32_t>(out_.data() + 8) != PCAPNG_BYTE_ORDER) {
+        return false;
+    }
+    for (std::size_t off = get<std::uint32_t>(out_.data() + 4); off + 20 <= out_.size();) {
+        const std::uint8_t* idb = out_.data() + off;
+        const std::size_t   len = get<std::uint32_t>(idb + 4);
+        if (len < 20 || len % 4 != 0 || len > out_.size() - off) return false;
+        off += len;
+        if (get<std::uint32_t>(idb) != PCAPNG_IDB) continue;
+        linktypes_.push_back(get<std::uint16_t>(idb + 8));
+        if (linktypes_.size() > 1) continue;
+        snaplen_ = static_cast<int>(get<std::uint32_t>(idb + 12));
+        for (std::size_t o = 16; o + 4 <= len - 4;) {
+            const auto code = get<std::uint16_t>(idb + o);
+            const auto olen = get<std::uint16_t>(idb + o + 2);
+            if (code == 0) break;
+            if (code == 9 && olen == 1) nano_ = idb[o + 4] == 9;
+            o += 4 + ((olen + 3u) & ~3u);
+        }
+    }
+    if (linktypes_.empty()) return false;
+    err.clear();
+    return true;
+}
+
+std::int64_t PcapngReader::first_ns() const {
+    std::int64_t first = INT64_MAX;
+    for (const PcapngIndexEntry& e : index_) first = std::min(first, e.min_ns);
+    return index_.empty() ? 0 : first;
+}
+
+bool PcapngReader::read_block(const std::size_t i, const pcap_handler cb, std::uint8_t* user) {
+    const PcapngIndexEntry& e = index_[i];
+    if (!read_member(e.offset, e.length, e.raw_length)) return false;
+
+    const std::uint64_t per_sec = nano_ ? 1'000'000'000 : 1'000'000;
+    const std::uint8_t* p       = out_.data();
+    std::size_t         left    = out_.size();
+    pcap_pkthdr         h{};
+    while (left >= 12) {
+        const auto type  = get<std::uint32_t>(p);
+        const auto total = get<std::uint32_t>(p + 4);
+        if (total < 12 || total % 4 != 0 || total > left) return false;
+        if (type == PCAPNG_EPB && total >= 32) {
+            const std::uint64_t ts = static_cast<std::uint64_t>(get<std::uint32_t>(p + 12)) << 32 | get<std::uint32_t>(p + 16);
+            h.caplen     = get<std::uint32_t>(p + 20);
+            h.len        = get<std::uint32_t>(p + 24);
+            h.ts.tv_sec  = static_cast<time_t>(ts / per_sec);
+            h.ts.tv_usec = static_cast<suseconds_t>(ts % per_sec);
+            const auto iface = get<std::uint32_t>(p + 8);
+            if (h.caplen > total - 32 || iface >= linktypes_.size()) return false;
+            packet_linktype_ = linktypes_[iface];
+            cb(user, &h, p + 28);
+        }
+        p    += total;
+        left -= total;
+    }
+    return true;
+}
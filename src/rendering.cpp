@@ -5,90 +5,491 @@
 #include "rendering.h"
 #include "state.h"
 #include "util.h"
+#include "capture.h"
+#include "options.h"
+#include "search.h"
+#include "spool.h"
 
 #include <ncurses.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
 
 WINDOW* wStats = nullptr;
 WINDOW* wTable = nullptr;
+WINDOW* wFlows = nullptr;
 WINDOW* wHex   = nullptr;
+WINDOW* wInstr = nullptr;
 
 void init_windows(int H, int W) {
-    constexpr int stats_h = 3;
+    for (WINDOW* w : {wStats, wTable, wFlows, wHex, wInstr}) if (w) delwin(w);
+    wFlows = wInstr = nullptr;
+
+    constexpr int stats_h = 5;
+    const int instr_h = gShowInstr ? INSTR_H : 0;
     const int hex_h   = H / 3;
-    const int table_h = H - stats_h - hex_h;
+    const int table_h = H - stats_h - instr_h - hex_h;
+    const int flows_w = gShowFlows && W >= 2 * FLOWS_MIN_W ? std::max(W * 2 / 5, FLOWS_MIN_W) : 0;
 
     wStats = newwin(stats_h, W, 0, 0);
-    wTable = newwin(table_h, W, stats_h, 0);
-    wHex   = newwin(hex_h,   W, stats_h + table_h, 0);
+    if (instr_h) wInstr = newwin(instr_h, W, stats_h, 0);
+    wTable = newwin(table_h, W - flows_w, stats_h + instr_h, 0);
+    if (flows_w) wFlows = newwin(table_h, flows_w, stats_h + instr_h, W - flows_w);
+    wHex   = newwin(hex_h,   W, stats_h + instr_h + table_h, 0);
     keypad(wTable, TRUE);
+    scrollok(wTable, TRUE);
+    idlok(wTable, TRUE);        // let the terminal move scrolled rows instead of resending them
+}
+static std::string host_share(const CountMinTop<HostKey>::Item& it, const std::uint64_t total) {
+    char addr[INET6_ADDRSTRLEN], out[INET6_ADDRSTRLEN + 16];
+    format_addr(it.key.family, it.key.addr, addr, sizeof(addr));
+    std::snprintf(out, sizeof(out), "%s %.0f%%", addr, 100.0 * static_cast<double>(it.count) / static_cast<double>(total));
+    return out;
+}
+
+static std::string port_share(const CountMinTop<std::uint16_t>::Item& it, const std::uint64_t total) {
+    char out[32];
+    std::snprintf(out, sizeof(out), "%u %.0f%%", it.key, 100.0 * static_cast<double>(it.count) / static_cast<double>(total));
+    return out;
 }
-void draw_stats() {
+
+// Sketches from every shard are merged into one view, at most once a second
+// since that is how often the shards publish them. Heavy-hitter shares are
+// upper bounds, high by at most the printed fraction of all packets (with ~98%
+// confidence).
+static void draw_sketch(const bool merge) {
+    static TrafficSketch merged(gCfg.sketch_width, gCfg.hll_bits);
+    static TrafficSketch part(gCfg.sketch_width, gCfg.hll_bits);
+    static std::string   counts, top;
+    int h, w; getmaxyx(wStats, h, w);
+
+    if (merge) {
+        merged.clear();
+        for (const auto& s : gShards) {
+            s->sketch.load(part);
+            merged.merge(part);
+        }
+        counts.clear();
+        top.clear();
+        if (merged.hosts.enabled()) {
+            char buf[96];
+            std::snprintf(buf, sizeof(buf), "Hosts: ~%.0f  Flows: ~%.0f  (+/-%.1f%%)",
+                          merged.hosts.estimate(), merged.flows.estimate(), 100 * merged.hosts.error());
+            counts = buf;
+        }
+        if (merged.src.enabled() && merged.src.total() > 0) {
+            constexpr std::size_t SHOWN = 3;
+
+            CountMinTop<HostKey>::Item       hosts[SHOWN];
+            CountMinTop<std::uint16_t>::Item ports[SHOWN];
+            top = "Top src:";
+            for (std::size_t i = 0, n = merged.src.top(hosts, SHOWN); i < n; ++i) top += " " + host_share(hosts[i], merged.src.total());
+            top += "  dst:";
+            for (std::size_t i = 0, n = merged.dst.top(hosts, SHOWN); i < n; ++i) top += " " + host_share(hosts[i], merged.dst.total());
+            top += "  dport:";
+            for (std::size_t i = 0, n = merged.dport.top(ports, SHOWN); i < n; ++i) top += " " + port_share(ports[i], merged.dport.total());
+
+            char bound[32];
+            std::snprintf(bound, sizeof(bound), "  (+%.2f%%)", 100 * merged.src.error());
+            top += bound;
+        }
+    }
+    mvwprintw(wStats, 2, 1, "%.*s", w - 2, counts.c_str());
+    mvwprintw(wStats, 3, 1, "%.*s", w - 2, top.c_str());
+}
+
+// Filter status goes on the top border after the device name. With interface
+// counters available, the share the kernel threw away is shown as well.
+static void draw_filter() {
+    if (!gFilter.error.empty()) {
+        wprintw(wStats, "  Filter error: %s", gFilter.error.c_str());
+        return;
+    }
+    if (gFilter.expr.empty()) return;
+
+    wprintw(wStats, "  Filter: \"%s\" (%d insns)", gFilter.expr.c_str(), gFilter.insns);
+    if (gFilter.seen > 0) {
+        const std::size_t dropped = gFilter.seen > gFilter.kept ? gFilter.seen - gFilter.kept : 0;
+        wprintw(wStats, " kept %zu/s of %zu/s, %.1f%% discarded in kernel", gFilter.kept_ps, gFilter.seen_ps,
+                100.0 * static_cast<double>(dropped) / static_cast<double>(gFilter.seen));
+    } else {
+        wprintw(wStats, " kept %zu pkts", gFilter.kept);
+    }
+}
+
+void draw_stats(const bool merge_sketch) {
     werase(wStats);
     box(wStats, 0, 0);
     wattron(wStats, A_BOLD);
-    mvwprintw(wStats, 0, 2, "Dev:%s (%s)",
-               gDevices[gCurDev].iface->name,
-               gDevices[gCurDev].description.c_str());
-    mvwprintw(wStats, 1, 1,
-              "Pk: %zu  TCP: %zu UDP: %zu ICMP: %zu Oth: %zu  Bytes: %s Bytes/second: %s/s",
-              gCnt.all.load(), gCnt.tcp.load(), gCnt.udp.load(), gCnt.icmp.load(),
-              gCnt.other.load(), human_bytes(gCnt.bytes.load()).c_str(),
-              human_bytes(gBps).c_str());
+    if (gCfg.read_file) {
+        mvwprintw(wStats, 0, 2, "File:%s", gCfg.read_file);
+    } else if (gCapDevs.size() == 1) {
+        mvwprintw(wStats, 0, 2, "Dev:%s (%s)",
+                   gDevices[gCapDevs.front()].name.c_str(),
+                   describe(gDevices[gCapDevs.front()]).c_str());
+    } else {
+        std::string names;
+        for (const std::size_t d : gCapDevs) {
+            names += (names.empty() ? "" : "+") + gDevices[d].name + (gDevices[d].present ? "" : " (gone)");
+        }
+        mvwprintw(wStats, 0, 2, "Dev:%s", names.c_str());
+    }
+    // every interface went away or failed; the ui stays up so another can be picked
+    if (!gCfg.read_file && !capture_running()) wprintw(wStats, " stopped, 'd' picks another interface");
+    draw_filter();
+    const CounterTotals c = total_counters();
+    const auto bps = static_cast<std::size_t>(gRates.empty() ? 0 : gRates.recent(0).bps());
+    char line[512];
+    int  n = std::snprintf(line, sizeof(line),
+                           "Pk: %zu  TCP: %zu UDP: %zu ICMP: %zu ARP: %zu Oth: %zu  Bytes: %s Bytes/second: %s/s  Drop: %zu",
+                           c.all, c.of(Proto::kTcp), c.of(Proto::kUdp), c.of(Proto::kIcmp) + c.of(Proto::kIcmp6),
+                           c.of(Proto::kArp), c.of(Proto::kOther), human_bytes(c.total_bytes).c_str(),
+                           human_bytes(bps).c_str(), c.dropped);
+    if (gWriter.recorder() && n < static_cast<int>(sizeof(line))) {
+        std::size_t held = 0, ring = 0;
+        for (const auto& s : gShards) {
+            held += s->dump.readable();
+            ring += s->dump.capacity();
+        }
+        n += std::snprintf(line + n, sizeof(line) - n, "  Recorder: %s of %s, %s, %zu trigger(s)",
+                           human_bytes(held).c_str(), human_bytes(ring).c_str(),
+                           gWriter.armed() ? "armed" : "dumping", gWriter.triggers());
+        if (gWriter.last_trigger() && n < static_cast<int>(sizeof(line))) {
+            std::snprintf(line + n, sizeof(line) - n, " (last: %s)", gWriter.last_trigger());
+        }
+    } else if (gWriter.enabled() && n < static_cast<int>(sizeof(line))) {
+        std::snprintf(line + n, sizeof(line) - n, "  Saved: %s in %zu file(s), %zu not written",
+                      human_bytes(gWriter.bytes_written()).c_str(), gWriter.files_written(), c.dump_dropped);
+    }
+    int h, w; getmaxyx(wStats, h, w);
+    mvwprintw(wStats, 1, 1, "%.*s", w - 2, line);     // clipped: a wrapped line would overwrite the rows below
     wattroff(wStats, A_BOLD);
+    draw_sketch(merge_sketch);
     wnoutrefresh(wStats);
 }
 
-void draw_table() {
-    werase(wTable);
-    box(wTable, 0, 0);
+// The sniffer's view of itself: whether anything was lost on the way in, how
+// full the queues between the stages are and where a packet's time goes.
+// Stage times come from one packet in INSTR_SAMPLE per shard.
+static void draw_instruments() {
+    if (!wInstr) return;
+    werase(wInstr);
+    box(wInstr, 0, 0);
+    int h, w; getmaxyx(wInstr, h, w);
+
+    HistSnapshot decode, dump, book, batch, depth, render;
+    std::size_t  queued = 0, ring = 0;
+    for (const auto& s : gShards) {
+        decode.add(s->instr.decode);
+        dump.add(s->instr.dump);
+        book.add(s->instr.book);
+        batch.add(s->instr.batch);
+        depth.add(s->instr.depth);
+        queued += s->dump.readable();
+        ring   += s->dump.capacity();
+    }
+    render.add(gRenderLat);
+    const CounterTotals c    = total_counters();
+    const KernelDrops   k    = kernel_drops();
+    const bool          lost = k.drop || k.ifdrop || c.dropped || c.dump_dropped;
+
+    wattron(wInstr, A_BOLD);
+    mvwprintw(wInstr, 0, 2, "Instrumentation: %s", lost ? "PACKETS LOST, see below" :
+                                                 k.valid ? "every packet accounted for" : "no kernel counters");
+    wattroff(wInstr, A_BOLD);
+
+    char line[256];
+    if (k.valid && gCapDevs.size() > 1) {
+        // per interface, since a drop usually points at one of them
+        int n = std::snprintf(line, sizeof(line), "Kernel (received/dropped/by interface):");
+        for (std::size_t d = 0; d < gCapDevs.size() && n < static_cast<int>(sizeof(line)); ++d) {
+            const KernelDrops kd = device_drops(d);
+            n += std::snprintf(line + n, sizeof(line) - n, "  %s %llu/%llu/%llu", gDevices[gCapDevs[d]].name.c_str(),
+                               static_cast<unsigned long long>(kd.recv), static_cast<unsigned long long>(kd.drop),
+                               static_cast<unsigned long long>(kd.ifdrop));
+        }
+    } else if (k.valid) {
+        std::snprintf(line, sizeof(line), "Kernel: %llu received, %llu dropped (buffer full), %llu by the interface",
+                      static_cast<unsigned long long>(k.recv), static_cast<unsigned long long>(k.drop),
+                      static_cast<unsigned long long>(k.ifdrop));
+    } else {
+        std::snprintf(line, sizeof(line), "Kernel: no counters (%s)", gCfg.read_file ? "reading a file" : "not yet read");
+    }
+    mvwprintw(wInstr, 1, 1, "%.*s", w - 2, line);
+    std::snprintf(line, sizeof(line), "Sniffer: %zu rows dropped (ui behind), %zu not written (writer behind)",
+                  c.dropped, c.dump_dropped);
+    mvwprintw(wInstr, 2, 1, "%.*s", w - 2, line);
+
+    std::string s = "Rows queued of " + std::to_string(ROW_QUEUE_CAP) + ": " + depth.summary(false) +
+                    "   Pkts per batch: " + batch.summary(false);
+    if (gWriter.enabled()) s += "   Writer ring: " + human_bytes(queued) + " of " + human_bytes(ring);
+    mvwprintw(wInstr, 3, 1, "%.*s", w - 2, s.c_str());
+
+    const std::pair<const char*, const HistSnapshot*> stages[] = {
+        {"Decode", &decode}, {"Dump", &dump}, {"Book", &book}, {"Render", &render}};
+    for (int i = 0; i < 4 && 4 + i < h - 1; ++i) {
+        s = std::string(stages[i].first) + std::string(8 - std::strlen(stages[i].first), ' ') +
+            stages[i].second->summary(true) + "  (" + std::to_string(stages[i].second->total) +
+            (i < 3 ? " timed)" : " frames)");
+        mvwprintw(wInstr, 4 + i, 1, "%.*s", w - 2, s.c_str());
+    }
+    wnoutrefresh(wInstr);
+}
+
+static void table_row(const int y, const int w, const PacketRecord& r, const bool sel, const bool hit) {
+    char ts[32], src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN], line[192];
+    format_ts(r.ts, gNanoTs, ts, sizeof(ts));
+    format_addr(r.family, r.src, src, sizeof(src));
+    format_addr(r.family, r.dst, dst, sizeof(dst));
+
+    // the destination starts on the tab stop the header's "\t\t" lands on
+    int       n   = std::snprintf(line, 96, "%s  %-15s", ts, src);
+    const int tab = ((1 + n) / 8 + 1) * 8 - 1;
+    n += std::snprintf(line + n, sizeof(line) - n, "%*s%-15s  %-3s %5u", tab - n, "", dst,
+                       is_dns(r) ? "DNS" : proto_name(r.proto), r.len);
+    if (gCapDevs.size() > 1 && r.shard < gShards.size()) {
+        n += std::snprintf(line + n, sizeof(line) - n, "  %s", gDevices[gCapDevs[gShards[r.shard]->dev]].name.c_str());
+    }
+    n  = std::min(n, w - 2);
+
+    const attr_t a = (sel ? A_REVERSE : 0) | (hit ? A_BOLD : 0);
+    wattron(wTable, a);
+    mvwaddnstr(wTable, y, 1, line, n);
+    wattroff(wTable, a);
+    if (n < w - 2) whline(wTable, ' ', w - 2 - n);
+}
+
+// Rows on screen are remembered by packet number. While the view follows the
+// newest packets, the rows already drawn are scrolled down (which the terminal
+// does itself) and only the new ones are formatted; while it is parked on
+// older packets nothing is rewritten except a moved highlight.
+void draw_table(const bool full) {
+    struct Shown {
+        std::size_t seq;
+        bool        sel;
+    };
+    static std::uint8_t payload[PayloadRing::MAX_APPEND];
+    constexpr std::size_t  NONE = ~std::size_t{0};
+    static std::vector<Shown> shown;
 
     int h, w; getmaxyx(wTable, h, w);
     const int inner = h - 3;
 
-    wattron(wTable, A_UNDERLINE);
-    mvwprintw(wTable, 1, 1, "Time        Source\t\tDestination        Pr  Len");
-    wattroff(wTable, A_UNDERLINE);
+    if (full || shown.size() != static_cast<std::size_t>(std::max(inner, 0))) {
+        werase(wTable);
+        box(wTable, 0, 0);
+        wattron(wTable, A_UNDERLINE);
+        const int ts_w = gNanoTs ? 18 : 15;
+        mvwprintw(wTable, 1, 1, "%-*s  Source\t\tDestination        Pr  Len%s", ts_w, "Time",
+                  gCapDevs.size() > 1 ? "  Interface" : "");
+        wattroff(wTable, A_UNDERLINE);
+        shown.assign(std::max(inner, 0), {NONE, false});
+    }
+    if (inner <= 0) { wnoutrefresh(wTable); return; }
+
+    const std::size_t rows = history_size();
+    const std::size_t top  = gFirstVis < rows ? gRows.pushed() - 1 - gFirstVis : NONE;
+    if (top != NONE && shown[0].seq != NONE && top > shown[0].seq && top - shown[0].seq < static_cast<std::size_t>(inner)) {
+        const int k = static_cast<int>(top - shown[0].seq);
+        wsetscrreg(wTable, 2, 1 + inner);
+        wscrl(wTable, -k);
+        for (int y = 2; y < 2 + k; ++y) {      // the lines scrolled in have no border yet
+            mvwaddch(wTable, y, 0, ACS_VLINE);
+            mvwaddch(wTable, y, w - 1, ACS_VLINE);
+        }
+        std::rotate(shown.begin(), shown.end() - k, shown.end());
+        std::fill(shown.begin(), shown.begin() + k, Shown{NONE, false});
+    }
 
     for (int i = 0; i < inner; ++i) {
         const std::size_t off = gFirstVis + i;
-        if (off >= gRows.size()) break;
+        if (off >= rows) {
+            if (shown[i].seq != NONE) mvwhline(wTable, 2 + i, 1, ' ', w - 2);
+            shown[i] = {NONE, false};
+            continue;
+        }
+        const std::size_t seq = gRows.pushed() - 1 - off;
+        const bool        sel = off == gSelected;
+        if (shown[i].seq == seq && shown[i].sel == sel) continue;
+        const PacketRecord& r   = history_row(off);
+        const bool          hit = gSearching && r.pl_len >= gSearch.size() && history_payload(off, payload) &&
+                                  gSearch.find(payload, r.pl_len) != NO_MATCH;
+        table_row(2 + i, w, r, sel, hit);
+        shown[i] = {seq, sel};
+    }
+
+    // the live counter changes without any row changing, so the border is redone every time
+    mvwhline(wTable, 0, 1, ACS_HLINE, w - 2);
+    if (gSearching) {
+        wattron(wTable, A_BOLD);
+        mvwprintw(wTable, 0, 2, "Search \"%.*s\": %zu packets matched since set, n/N for next/previous",
+                  std::max(w - 70, 8), gSearch.text().c_str(), total_counters().matches - gMatchBase);
+        wattroff(wTable, A_BOLD);
+    }
+    wnoutrefresh(wTable);
+}
+
+void draw_flows() {
+    if (!wFlows) return;
+    werase(wFlows);
+    box(wFlows, 0, 0);
 
-        const Row &r = gRows[gRows.size() - 1 - off];
-        const bool sel = (off == gSelected);
-        if (sel) wattron(wTable, A_REVERSE);
+    static std::vector<FlowEntry> flows;
+    const std::size_t active = top_flows(gFlowsByRate, flows);
 
-        mvwprintw(wTable, 2 + i, 1,
-                  "%s  %-15s\t%-15s  %-3s %5zu",
-                  r.ts.c_str(), r.src.c_str(), r.dst.c_str(),
-                  r.proto.c_str(), r.len);
+    int h, w; getmaxyx(wFlows, h, w);
+    const int ep_w = std::max((w - 2 - 36) / 2, 8);
 
-        if (sel) wattroff(wTable, A_REVERSE);
+    wattron(wFlows, A_BOLD);
+    mvwprintw(wFlows, 0, 2, "Flows: %zu active, by %s", active, gFlowsByRate ? "rate" : "bytes");
+    wattroff(wFlows, A_BOLD);
+    wattron(wFlows, A_UNDERLINE);
+    mvwprintw(wFlows, 1, 1, "%-*s %-*s %-3s %7s %9s %11s", ep_w, "Source", ep_w, "Destination",
+              "Pr", "Pkts", "Bytes", "Rate");
+    wattroff(wFlows, A_UNDERLINE);
+
+    char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8];
+    for (int i = 0; i < h - 3 && i < static_cast<int>(flows.size()); ++i) {
+        const FlowEntry& e = flows[i];
+        format_endpoint(e, true,  src, sizeof(src));
+        format_endpoint(e, false, dst, sizeof(dst));
+        mvwprintw(wFlows, 2 + i, 1, "%-*.*s %-*.*s %-3s %7llu %9s %9s/s",
+                  ep_w, ep_w, src, ep_w, ep_w, dst, proto_name(e.key.proto),
+                  static_cast<unsigned long long>(e.packets), human_bytes(e.bytes).c_str(),
+                  human_bytes(static_cast<std::size_t>(e.rate())).c_str());
     }
-    wnoutrefresh(wTable);
+
+    const CounterTotals c = total_counters();
+    if (c.retrans + c.ooo + c.dup_acks + c.zero_wins) {
+        mvwprintw(wFlows, h - 1, 2, " TCP: %zu retrans, %zu out of order, %zu dup ACKs, %zu zero windows ",
+                  c.retrans, c.ooo, c.dup_acks, c.zero_wins);
+    }
+    wnoutrefresh(wFlows);
 }
 
 void draw_hex() {
     werase(wHex);
     box(wHex, 0, 0);
-    if (!gShowHex || gRows.empty()) { wnoutrefresh(wHex); return; }
+    if (!gShowHex || history_size() == 0) { wnoutrefresh(wHex); return; }
 
-    if (gSelected >= gRows.size()) gSelected = gRows.size() - 1;
-    const Row &r = gRows[gRows.size() - 1 - gSelected];
-    mvwprintw(wHex, 1, 1, "Hex dump (%zu bytes)", r.payload.size());
+    if (gSelected >= history_size()) gSelected = history_size() - 1;
+    const PacketRecord &r = history_row(gSelected);
+
+    static std::uint8_t payload[PayloadRing::MAX_APPEND];
+    const char* missing = nullptr;
+    if (gCfg.payload_mem == 0)                     missing = "not kept, --payload-mem is 0";
+    else if (r.pl_len == 0)                        missing = "no bytes past the headers";
+    else if (!history_payload(gSelected, payload)) missing = "evicted, newer packets filled --payload-mem and the spool";
+    if (missing) {
+        mvwprintw(wHex, 1, 1, "Hex dump (%s)", missing);
+        wnoutrefresh(wHex);
+        return;
+    }
+    mvwprintw(wHex, 1, 1, "Hex dump (%u bytes)", r.pl_len);
 
     int h, w; getmaxyx(wHex, h, w);
     std::size_t off = 0; int line = 2;
-    while (off < r.payload.size() && line < h - 1) {
-        const std::size_t chunk = std::min<std::size_t>(16, r.payload.size() - off);
-        hex_line(wHex, line++, r.payload.data() + off, chunk, off);
+    while (off < r.pl_len && line < h - 1) {
+        const std::size_t chunk = std::min<std::size_t>(16, r.pl_len - off);
+        hex_line(wHex, line++, payload + off, chunk, off);
         off += chunk;
     }
+
+    // matched bytes are reversed in both the hex and the text column
+    if (gSearching) {
+        for (std::size_t at = 0; at < off;) {
+            const std::size_t m = gSearch.find(payload + at, r.pl_len - at);
+            if (m == NO_MATCH) break;
+            for (std::size_t b = at + m; b < std::min(at + m + gSearch.size(), off); ++b) {
+                const int y = 2 + static_cast<int>(b / 16);
+                const int x = static_cast<int>(b % 16);
+                mvwchgat(wHex, y, 7 + 3 * x, 2, A_REVERSE, 0, nullptr);
+                mvwchgat(wHex, y, 56 + x, 1, A_REVERSE, 0, nullptr);
+            }
+            at += m + 1;
+        }
+    }
     wnoutrefresh(wHex);
 }
 
-void refresh_render() {
-    draw_stats();
-    draw_table();
-    draw_hex();
+// Shares the space under the table with the hex dump: the last second by
+// protocol, the size mix since the start, and bytes/s over the whole retained
+// history, squeezed so one column covers `span` seconds.
+static void draw_rates() {
+    werase(wHex);
+    box(wHex, 0, 0);
+    int h, w; getmaxyx(wHex, h, w);
+    const CounterTotals c = total_counters();
+
+    std::string line = "Last second:";
+    if (!gRates.empty()) {
+        const RateSample& s = gRates.recent(0);
+        line += " " + human_count(s.pps()) + " pkt/s " + human_count(s.bps()) + "B/s  ";
+        for (std::size_t i = 0; i < N_PROTO && s.secs > 0; ++i) {
+            if (s.pkts[i] == 0) continue;
+            line += std::string(" ") + proto_name(static_cast<Proto>(i)) + " " +
+                    human_count(static_cast<double>(s.pkts[i]) / s.secs) + "/" +
+                    human_count(static_cast<double>(s.bytes[i]) / s.secs) + "B";
+        }
+    }
+    mvwprintw(wHex, 1, 1, "%.*s", w - 2, line.c_str());
+
+    line = "Sizes:";
+    for (std::size_t i = 0; i < SIZE_BUCKETS && c.all > 0; ++i) {
+        char part[32];
+        std::snprintf(part, sizeof(part), " %s %.0f%%", SIZE_LABELS[i],
+                      100.0 * static_cast<double>(c.sizes[i]) / static_cast<double>(c.all));
+        line += part;
+    }
+    mvwprintw(wHex, 2, 1, "%.*s", w - 2, line.c_str());
+
+    constexpr int AXIS_W = 9;
+    const int     rows   = h - 4;
+    const int     cols   = w - 2 - AXIS_W;
+    if (rows < 2 || cols < 8 || gRates.empty()) { wnoutrefresh(wHex); return; }
+
+    const std::size_t n    = gRates.size();
+    const std::size_t span = (n + cols - 1) / cols;
+    static std::vector<double> col;
+    col.assign(cols, 0);
+    double peak = 0;
+    for (std::size_t k = 0; k < static_cast<std::size_t>(cols) && k * span < n; ++k) {
+        double bytes = 0, secs = 0;
+        for (std::size_t i = k * span; i < std::min(n, (k + 1) * span); ++i) {
+            bytes += static_cast<double>(gRates.recent(i).all_bytes);
+            secs  += gRates.recent(i).secs;
+        }
+        col[cols - 1 - k] = secs > 0 ? bytes / secs : 0;
+        peak = std::max(peak, col[cols - 1 - k]);
+    }
+
+    wattron(wHex, A_BOLD);
+    mvwprintw(wHex, 0, 2, "Rates: bytes/s over the last %zus, %zus per column", n, span);
+    wattroff(wHex, A_BOLD);
+    mvwprintw(wHex, 3, 1, "%*s", AXIS_W - 1, (human_count(peak) + "B/s").c_str());
+    mvwprintw(wHex, 2 + rows, 1, "%*s", AXIS_W - 1, "0");
+    wattron(wHex, A_REVERSE);
+    for (int x = 0; x < cols; ++x) {
+        const int bar = peak > 0 ? static_cast<int>(col[x] / peak * rows + 0.5) : 0;
+        for (int y = 0; y < bar; ++y) mvwaddch(wHex, 2 + rows - y, 1 + AXIS_W + x, ' ');
+    }
+    wattroff(wHex, A_REVERSE);
+    wnoutrefresh(wHex);
+}
+
+void refresh_render(const unsigned damage) {
+    const bool full = damage & DAMAGE_FULL;
+    if (full || (damage & (DAMAGE_STATS | DAMAGE_SKETCH))) draw_stats(full || (damage & DAMAGE_SKETCH));
+    if (full || (damage & DAMAGE_TABLE)) draw_table(full);
+    if (full || (damage & DAMAGE_INSTR)) draw_instruments();
+    if (full || (damage & DAMAGE_FLOWS)) draw_flows();
+    if (full || (damage & DAMAGE_HEX)) {
+        if (gShowRates) draw_rates();
+        else            draw_hex();
+    }
     doupdate();
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+//
+// Created by Shaunik Musukula on 7/20/25.
+//
+
+#include "search.h"
+#include "spool.h"
+#include "packet_ring.h"
+
+#include <cstring>
+#include <memory>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+std::atomic<const Pattern*> gMatch{nullptr};
+Pattern                     gSearch;
+bool                        gSearching = false;
+std::size_t                 gMatchBase = 0;
+
+static std::uint8_t fold(const std::uint8_t c) {
+    return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+static int hex_val(const char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool Pattern::parse(const std::string& text, Pattern& out, std::string& err) {
+    out.bytes_.clear();
+    out.nocase_ = false;
+    out.text_   = text;
+
+    if (text.rfind("x:", 0) == 0) {
+        int hi = -1;
+        for (std::size_t i = 2; i < text.size(); ++i) {
+            if (text[i] == ' ') continue;
+            const int v = hex_val(text[i]);
+            if (v < 0) { err = "not a hex digit: " + std::string(1, text[i]); return false; }
+            if (hi < 0) hi = v;
+            else { out.bytes_.push_back(static_cast<std::uint8_t>(hi << 4 | v)); hi = -1; }
+        }
+        if (hi >= 0) { err = "odd number of hex digits"; return false; }
+    } else {
+        std::size_t i = 0;
+        if (text.rfind("i:", 0) == 0) {
+            out.nocase_ = true;
+            i = 2;
+        }
+        for (; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '\\' && i + 1 < text.size()) {
+                switch (text[++i]) {
+                    case 'n':  c = '\n'; break;
+                    case 'r':  c = '\r'; break;
+                    case 't':  c = '\t'; break;
+                    case '\\': c = '\\'; break;
+                    case 'x': {
+                        const int a = i + 2 < text.size() ? hex_val(text[i + 1]) : -1;
+                        const int b = a >= 0 ? hex_val(text[i + 2]) : -1;
+                        if (b < 0) { err = "\\x needs two hex digits"; return false; }
+                        c  = static_cast<char>(a << 4 | b);
+                        i += 2;
+                        break;
+                    }
+                    default: err = "unknown escape \\" + std::string(1, text[i]); return false;
+                }
+            }
+            const auto u = static_cast<std::uint8_t>(c);
+            out.bytes_.push_back(out.nocase_ ? fold(u) : u);
+        }
+    }
+    if (out.bytes_.empty()) { err = "empty pattern"; return false; }
+    return true;
+}
+
+// compares bytes [from, to) of the pattern against `at`
+bool Pattern::equal(const std::uint8_t* at, const std::size_t from, const std::size_t to) const {
+    if (!nocase_) return std::memcmp(at + from, bytes_.data() + from, to - from) == 0;
+    for (std::size_t i = from; i < to; ++i) if (fold(at[i]) != bytes_[i]) return false;
+    return true;
+}
+
+std::size_t Pattern::find_scalar(const std::uint8_t* hay, std::size_t from, const std::size_t n) const {
+    const std::size_t m = bytes_.size();
+    for (; from + m <= n; ++from) if (equal(hay + from, 0, m)) return from;
+    return NO_MATCH;
+}
+
+std::size_t Pattern::find(const std::uint8_t* hay, const std::size_t n) const {
+    const std::size_t m = bytes_.size();
+    if (m == 0 || n < m) return NO_MATCH;
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    // Muła's "generic SIMD" filter: a position can only match if both its first
+    // and its last byte do. Each byte is compared in both cases for nocase.
+    const auto  first = bytes_.front(), last = bytes_.back();
+    const auto  upper = [this](const std::uint8_t c) { return nocase_ && c >= 'a' && c <= 'z' ? c & ~0x20 : c; };
+    const __m128i f_lo = _mm_set1_epi8(static_cast<char>(first));
+    const __m128i f_up = _mm_set1_epi8(static_cast<char>(upper(first)));
+    const __m128i l_lo = _mm_set1_epi8(static_cast<char>(last));
+    const __m128i l_up = _mm_set1_epi8(static_cast<char>(upper(last)));
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        const __m128i a  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+        const __m128i b  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+        const __m128i ea = _mm_or_si128(_mm_cmpeq_epi8(a, f_lo), _mm_cmpeq_epi8(a, f_up));
+        const __m128i eb = _mm_or_si128(_mm_cmpeq_epi8(b, l_lo), _mm_cmpeq_epi8(b, l_up));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(ea, eb)));
+        while (mask) {
+            const unsigned bit = __builtin_ctz(mask);
+            if (m <= 2 || equal(hay + i + bit, 1, m - 1)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return find_scalar(hay, i, n);
+}
+
+void set_live_match(const Pattern* p) {
+    static std::vector<std::unique_ptr<Pattern>> kept;
+    if (!p) {
+        gMatch.store(nullptr, std::memory_order_release);
+        return;
+    }
+    kept.push_back(std::make_unique<Pattern>(*p));
+    gMatch.store(kept.back().get(), std::memory_order_release);
+}
+
+std::size_t search_history(const Pattern& p, std::size_t from, const bool older) {
+    static std::uint8_t buf[PayloadRing::MAX_APPEND];
+    const std::size_t   n = history_size();
+    // going newer, i wraps past 0 to a huge value and the loop ends
+    for (std::size_t i = from; i < n; older ? ++i : --i) {
+        const PacketRecord& r = history_row(i);
+        if (r.pl_len >= p.size() && history_payload(i, buf) && p.find(buf, r.pl_len) != NO_MATCH) return i;
+    }
+    return NO_MATCH;
+}
@@ -0,0 +1,98 @@
+//
+// Created by Shaunik Musukula on 7/15/25.
+//
+
+#include "sketch.h"
+#include "flow_table.h"
+
+#include <sys/socket.h>
+
+void HyperLogLog::merge(const HyperLogLog& o) {
+    if (o.regs_.size() != regs_.size()) return;
+    for (std::size_t i = 0; i < regs_.size(); ++i) regs_[i] = std::max(regs_[i], o.regs_[i]);
+}
+
+// Flajolet et al., with linear counting while many registers are still empty.
+double HyperLogLog::estimate() const {
+    if (regs_.empty()) return 0;
+    const auto  m     = static_cast<double>(regs_.size());
+    double      sum   = 0;
+    std::size_t zeros = 0;
+    for (const std::uint8_t r : regs_) {
+        sum += std::ldexp(1.0, -r);
+        zeros += r == 0;
+    }
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    const double raw   = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros) return m * std::log(m / static_cast<double>(zeros));
+    return raw;
+}
+
+TrafficSketch::TrafficSketch(const std::size_t width, const int hll_bits)
+    : src(width), dst(width), sport(width), dport(width), hosts(hll_bits), flows(hll_bits) {}
+
+static HostKey host_key(const std::uint8_t family, const IpAddr& a) {
+    HostKey k;
+    std::memset(&k, 0, sizeof(k));
+    std::memcpy(&k.addr, &a, family == AF_INET6 ? 16 : 4);
+    k.family = family;
+    return k;
+}
+
+void TrafficSketch::add(const PacketRecord& r) {
+    const HostKey       s  = host_key(r.family, r.src);
+    const HostKey       d  = host_key(r.family, r.dst);
+    const std::uint64_t hs = hash64(&s, sizeof(s));
+    const std::uint64_t hd = hash64(&d, sizeof(d));
+    src.add(s, hs, 1);
+    dst.add(d, hd, 1);
+    if (r.proto == Proto::kTcp || r.proto == Proto::kUdp) {
+        sport.add(r.sport);
+        dport.add(r.dport);
+    }
+    if (hosts.enabled()) {
+        hosts.add(hs);
+        hosts.add(hd);
+        bool          a_is_src;
+        const FlowKey f = make_flow_key(r, a_is_src);
+        flows.add(hash64(&f, sizeof(f)));
+    }
+}
+
+void TrafficSketch::merge(const TrafficSketch& o) {
+    src.merge(o.src);
+    dst.merge(o.dst);
+    sport.merge(o.sport);
+    dport.merge(o.dport);
+    hosts.merge(o.hosts);
+    flows.merge(o.flows);
+}
+
+void TrafficSketch::clear() {
+    src.clear();
+    dst.clear();
+    sport.clear();
+    dport.clear();
+    hosts.clear();
+    flows.clear();
+}
+
+void ShardSketch::publish() {
+    if (!dirty_) return;
+    dirty_ = false;
+    const unsigned s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    shown_ = live_;     // same sizes on both sides, so this only copies elements
+    seq_.store(s + 2, std::memory_order_release);
+}
+
+void ShardSketch::load(TrafficSketch& out) const {
+    while (true) {
+        const unsigned s1 = seq_.load(std::memory_order_acquire);
+        if (s1 & 1) continue;
+        out = shown_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == s1) return;
+    }
+}
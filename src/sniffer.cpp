@@ -3,6 +3,15 @@
 #include "state.h"
 #include "rendering.h"
 #include "pcap_helpers.h"
+#include "capture.h"
+#include "options.h"
+#include "offline.h"
+#include "filter.h"
+#include "search.h"
+#include "spool.h"
+#include "metrics.h"
+#include "trigger.h"
+#include "util.h"
 
 #include <pcap/pcap.h>
 #include <ncurses.h>
@@ -10,54 +19,179 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace dev {
-    void enumerate() {
+    constexpr int REFRESH_MS = 500;
+
+    static LinkWatcher gLinks;
+
+    // Only names are taken here; what describes them is read from the system
+    // when a row first shows up, so startup doesn't grow with the interface count.
+    static void list_devices() {
         pcap_if_t* list = nullptr;
         if (pcap_findalldevs(&list, gErr) == PCAP_ERROR) {
             std::fprintf(stderr, "%s\n", gErr);
             std::exit(EXIT_FAILURE);
         }
-        for (auto* d = list; d; d = d->next) gDevices.emplace_back(match_iface_pcap(d));
+        for (DeviceMapping& d : gDevices) d.present = false;
+        for (const auto* d = list; d; d = d->next) {
+            const auto it = std::find_if(gDevices.begin(), gDevices.end(),
+                                         [d](const DeviceMapping& m) { return m.name == d->name; });
+            if (it == gDevices.end()) {
+                gDevices.emplace_back(match_iface_pcap(d));
+            } else {
+                it->present = true;
+                it->loaded  = false;
+            }
+        }
+        pcap_freealldevs(list);
+    }
+
+    void enumerate() {
+        // listening first means nothing added during the listing is missed
+        gLinks.open();
+        list_devices();
         if (gDevices.empty()) {
             std::fprintf(stderr, "No devices found\n");
             std::exit(EXIT_FAILURE);
         }
     }
 
+    // Interfaces that appeared since the last call are appended; ones that
+    // went away stay in place, marked, since gCapDevs holds indices into the
+    // list. True if anything changed.
+    bool hotplug() {
+        std::vector<LinkEvent> events;
+        if (!gLinks.poll(events)) {
+            list_devices();
+            return true;
+        }
+        for (const LinkEvent& e : events) {
+            const auto it = std::find_if(gDevices.begin(), gDevices.end(),
+                                         [&e](const DeviceMapping& m) { return m.name == e.name; });
+            if (it == gDevices.end()) {
+                if (e.gone) continue;
+                DeviceMapping d;
+                d.name = e.name;
+                gDevices.push_back(std::move(d));
+            } else {
+                it->present = !e.gone;
+                it->loaded  = false;        // the link state, mtu or speed may be what changed
+            }
+        }
+        return !events.empty();
+    }
+
+    // Every worker gets a share of the memory budgets and table sizes on each
+    // interface, so each extra interface shrinks the shares; this many keeps
+    // them above their minimums.
+    std::size_t device_limit() {
+        const std::size_t workers = static_cast<std::size_t>(gCfg.workers);
+        std::size_t       n       = MAX_SHARDS / workers;
+        if (gCfg.payload_mem)  n = std::min(n, gCfg.payload_mem / (PAYLOAD_MEM_MIN * workers));
+        if (gCfg.record_bytes) n = std::min(n, gCfg.record_bytes / (RECORD_BYTES_MIN * workers));
+        if (gCfg.flow_slots)   n = std::min(n, gCfg.flow_slots / (FLOW_SLOTS_MIN * workers));
+        if (gCfg.dns_slots)    n = std::min(n, gCfg.dns_slots / (DNS_SLOTS_MIN * workers));
+        return n;
+    }
+
+    // adds the device called `name` to the ones captured
+    bool add(const char* name) {
+        for (std::size_t i = 0; i < gDevices.size(); ++i) {
+            if (gDevices[i].name != name) continue;
+            if (std::find(gCapDevs.begin(), gCapDevs.end(), i) == gCapDevs.end()) gCapDevs.push_back(i);
+            return true;
+        }
+        return false;
+    }
+
+    // Space marks devices to capture together, Enter captures the marked ones
+    // (or the highlighted one if none are marked). The list follows interfaces
+    // coming and going while it is open; ones that go away are unmarked, and
+    // if the chosen ones can't be opened the current capture carries on.
     void popup() {
         int H, W; getmaxyx(stdscr, H, W);
-        const int box_h = std::min<int>(static_cast<int>(gDevices.size()) + 2, H - 4);
-        const int box_w = W / 2;
-        const int y0    = (H - box_h) / 2;
+        const int box_w = std::max(W / 2, std::min(W - 4, 80));
         const int x0    = (W - box_w) / 2;
 
-        WINDOW* pop = newwin(box_h, box_w, y0, x0);
-        box(pop, 0, 0);
-        keypad(pop, TRUE);
-
-        int sel = 0;
+        WINDOW* pop = nullptr;
+        int     box_h = 0;
+        const std::size_t max_devs = device_limit();
+        std::vector<char> marked(gDevices.size(), 0);
+        for (const std::size_t d : gCapDevs) marked[d] = 1;
+        int         sel = 0, first = 0;
+        std::string err;
         while (true) {
+            marked.resize(gDevices.size(), 0);
+            for (std::size_t i = 0; i < marked.size(); ++i) if (!gDevices[i].present) marked[i] = 0;
+            const int n = static_cast<int>(gDevices.size());
+            if (const int want = std::min(n + 2, H - 4); want != box_h) {
+                if (pop) delwin(pop);
+                box_h = want;
+                pop   = newwin(box_h, box_w, (H - box_h) / 2, x0);
+                keypad(pop, TRUE);
+                wtimeout(pop, REFRESH_MS);
+            }
+            const int rows = box_h - 2;
+            if (sel < first)             first = sel;
+            else if (sel >= first + rows) first = sel - rows + 1;
+
             werase(pop);
             box(pop, 0, 0);
-            for (int i = 0; i < box_h - 2; ++i) {
-                const int idx = i;
-                if (idx >= static_cast<int>(gDevices.size())) break;
+            mvwprintw(pop, 0, 2, "Space marks, Enter captures (%d interfaces)", n);
+            for (int i = 0; i < rows && first + i < n; ++i) {
+                const int idx = first + i;
+                DeviceMapping& d = gDevices[idx];
                 if (idx == sel) wattron(pop, A_REVERSE);
-                mvwprintw(pop, 1 + i, 1, "%-10s  %s",
-                           gDevices[idx].iface->name,
-                           gDevices[idx].description.c_str());
+                if (!d.present) wattron(pop, A_DIM);
+                mvwprintw(pop, 1 + i, 1, "[%c] %-15s  %.*s", marked[idx] ? 'x' : ' ', d.name.c_str(),
+                          std::max(box_w - 24, 0), describe(d).c_str());
+                if (!d.present) wattroff(pop, A_DIM);
                 if (idx == sel) wattroff(pop, A_REVERSE);
             }
+            if (!err.empty()) mvwprintw(pop, box_h - 1, 2, " %.*s ", std::max(box_w - 6, 0), err.c_str());
             wrefresh(pop);
-            if (const int ch = wgetch(pop); ch == KEY_UP && sel > 0)              --sel;
-            else if (ch == KEY_DOWN && sel < static_cast<int>(gDevices.size()) - 1) ++sel;
-            else if (ch == '\n') { gCurDev = sel; delwin(pop); open_device(gCurDev); return; }
+
+            const int ch = wgetch(pop);
+            if (ch == ERR) {
+                hotplug();
+                drain_captured();
+            }
+            else if (ch == KEY_UP && sel > 0)       --sel;
+            else if (ch == KEY_DOWN && sel < n - 1) ++sel;
+            else if (ch == KEY_PPAGE)               sel = std::max(sel - rows, 0);
+            else if (ch == KEY_NPAGE)               sel = std::min(sel + rows, n - 1);
+            else if (ch == ' ') {
+                if (!marked[sel] && (!gDevices[sel].present ||
+                    static_cast<std::size_t>(std::count(marked.begin(), marked.end(), 1)) >= max_devs)) beep();
+                else marked[sel] = !marked[sel];
+            }
+            else if (ch == '\n') {
+                std::vector<std::size_t> want;
+                for (std::size_t i = 0; i < marked.size(); ++i) if (marked[i]) want.push_back(i);
+                if (want.empty() && gDevices[sel].present) want.push_back(static_cast<std::size_t>(sel));
+                if (want.empty()) { beep(); continue; }
+                std::swap(gCapDevs, want);
+                if (!open_devices(true)) {
+                    std::swap(gCapDevs, want);
+                    err = gErr;
+                    beep();
+                    continue;
+                }
+                delwin(pop);
+                return;
+            }
             else if (ch == 27)   { delwin(pop); return; }
         }
     }
@@ -97,11 +231,11 @@ namespace limit {
             else if (ch == KEY_BACKSPACE || ch == 127) {
                 if (!num.empty()) num.pop_back();
             } else if (ch == '\n' && !num.empty()) {
-                gCapLim.kind   = kind_sel == 0 ? LimitKind::kPackets
-                                   : kind_sel == 1 ? LimitKind::kBytes
-                                                   : LimitKind::kSeconds;
-                gCapLim.target = std::stoull(num);
-                gCapLim.start  = std::chrono::steady_clock::now();
+                stop_capture();
+                gCapLim.set(kind_sel == 0 ? LimitKind::kPackets
+                            : kind_sel == 1 ? LimitKind::kBytes
+                                            : LimitKind::kSeconds, std::stoull(num));
+                start_capture();
                 delwin(pop);
                 noecho();
                 return;
@@ -114,8 +248,548 @@ namespace limit {
     }
 }
 
-int main() {
-    dev::enumerate();
+namespace bpf {
+    void popup() {
+        int H, W; getmaxyx(stdscr, H, W);
+        const int box_h = 6, box_w = std::max(W * 2 / 3, 40);
+        const int y0 = (H - box_h) / 2, x0 = (W - box_w) / 2;
+
+        WINDOW* pop = newwin(box_h, box_w, y0, x0);
+        keypad(pop, TRUE);
+
+        std::string expr = gFilter.expr;
+        std::string err;
+        while (true) {
+            werase(pop);
+            box(pop, 0, 0);
+            mvwprintw(pop, 1, 2, "BPF filter (empty clears, Esc cancels):");
+            mvwprintw(pop, 2, 2, "> %.*s", box_w - 6, expr.c_str());
+            if (!err.empty()) mvwprintw(pop, 4, 2, "%.*s", box_w - 4, err.c_str());
+            wrefresh(pop);
+
+            if (const int ch = wgetch(pop); ch == KEY_BACKSPACE || ch == 127) {
+                if (!expr.empty()) expr.pop_back();
+            } else if (ch == '\n') {
+                stop_capture();
+                const bool ok = set_filter(expr);
+                start_capture();
+                if (ok) break;
+                err = gErr;
+            } else if (ch == 27) {
+                break;
+            } else if (ch >= 32 && ch < 127) {
+                expr.push_back(static_cast<char>(ch));
+            }
+        }
+        delwin(pop);
+    }
+}
+
+namespace jump {
+    // "HH:MM:SS[.frac]" on the day of the newest row, or the day before if
+    // that would be in the future
+    static bool parse_time(const std::string& s, timeval& out) {
+        int h, m, sec, used = 0;
+        if (gRows.empty() || std::sscanf(s.c_str(), "%d:%d:%d%n", &h, &m, &sec, &used) != 3) return false;
+        long        frac   = 0;
+        const char* p      = s.c_str() + used;
+        int         digits = 0;
+        if (*p == '.') {
+            for (++p; std::isdigit(static_cast<unsigned char>(*p)) && digits < 9; ++p, ++digits) frac = frac * 10 + (*p - '0');
+        }
+        if (*p != '\0') return false;
+        for (int d = digits; d < (gNanoTs ? 9 : 6); ++d) frac *= 10;
+        for (int d = digits; d > (gNanoTs ? 9 : 6); --d) frac /= 10;
+
+        const timeval newest = gRows.recent(0).ts;
+        std::time_t   t      = newest.tv_sec;
+        std::tm       tm{};
+        localtime_r(&t, &tm);
+        tm.tm_hour = h;
+        tm.tm_min  = m;
+        tm.tm_sec  = sec;
+        t = std::mktime(&tm);
+        if (t > newest.tv_sec) t -= 24 * 3600;
+        out.tv_sec  = t;
+        out.tv_usec = static_cast<decltype(out.tv_usec)>(frac);
+        return true;
+    }
+
+    void popup() {
+        int H, W; getmaxyx(stdscr, H, W);
+        constexpr int box_h = 6, box_w = 44;
+        const int y0 = (H - box_h) / 2, x0 = (W - box_w) / 2;
+
+        WINDOW* pop = newwin(box_h, box_w, y0, x0);
+        keypad(pop, TRUE);
+
+        std::string text;
+        bool        bad = false;
+        while (true) {
+            werase(pop);
+            box(pop, 0, 0);
+            mvwprintw(pop, 1, 2, "Jump to time (HH:MM:SS[.frac]):");
+            mvwprintw(pop, 2, 2, "> %s", text.c_str());
+            if (bad) mvwprintw(pop, 4, 2, "not a time of day");
+            wrefresh(pop);
+
+            if (const int ch = wgetch(pop); ch == KEY_BACKSPACE || ch == 127) {
+                if (!text.empty()) text.pop_back();
+            } else if (ch == '\n') {
+                timeval ts{};
+                if (!(bad = !parse_time(text, ts))) {
+                    gSelected = history_find(ts);
+                    break;
+                }
+            } else if (ch == 27) {
+                break;
+            } else if ((std::isdigit(ch) || ch == ':' || ch == '.') && text.size() < 24) {
+                text.push_back(static_cast<char>(ch));
+            }
+        }
+        delwin(pop);
+    }
+}
+
+namespace search {
+    static void start(const Pattern& p) {
+        gSearch    = p;
+        gSearching = true;
+        set_live_match(&gSearch);
+        gMatchBase = total_counters().matches;
+    }
+
+    // from the selected row on, wrapping around at either end
+    static void next(const bool older) {
+        const std::size_t n = history_size();
+        if (!gSearching || n == 0) return;
+        std::size_t hit = NO_MATCH;
+        if (older ? gSelected + 1 < n : gSelected > 0) {
+            hit = search_history(gSearch, older ? gSelected + 1 : gSelected - 1, older);
+        }
+        if (hit == NO_MATCH) hit = search_history(gSearch, older ? 0 : n - 1, older);
+        if (hit == NO_MATCH) beep();
+        else                 gSelected = hit;
+    }
+
+    void popup() {
+        int H, W; getmaxyx(stdscr, H, W);
+        const int box_h = 7, box_w = std::max(W * 2 / 3, 48);
+        const int y0 = (H - box_h) / 2, x0 = (W - box_w) / 2;
+
+        WINDOW* pop = newwin(box_h, box_w, y0, x0);
+        keypad(pop, TRUE);
+
+        std::string text = gSearching ? gSearch.text() : "";
+        std::string err;
+        while (true) {
+            werase(pop);
+            box(pop, 0, 0);
+            mvwprintw(pop, 1, 2, "Search payloads (empty clears, Esc cancels):");
+            mvwprintw(pop, 2, 2, "text, i:case-insensitive or x:hex bytes");
+            mvwprintw(pop, 3, 2, "/%.*s", box_w - 5, text.c_str());
+            if (!err.empty()) mvwprintw(pop, 5, 2, "%.*s", box_w - 4, err.c_str());
+            wrefresh(pop);
+
+            if (const int ch = wgetch(pop); ch == KEY_BACKSPACE || ch == 127) {
+                if (!text.empty()) text.pop_back();
+            } else if (ch == '\n') {
+                if (text.empty()) {
+                    gSearching = false;
+                    set_live_match(nullptr);
+                    break;
+                }
+                Pattern p;
+                if (Pattern::parse(text, p, err)) {
+                    start(p);
+                    const std::size_t hit = search_history(gSearch, gSelected, true);
+                    if (hit != NO_MATCH) gSelected = hit;
+                    else                 next(true);
+                    break;
+                }
+            } else if (ch == 27) {
+                break;
+            } else if (ch >= 32 && ch < 127) {
+                text.push_back(static_cast<char>(ch));
+            }
+        }
+        delwin(pop);
+    }
+}
+
+namespace flow {
+    constexpr int REFRESH_MS = 250;
+
+    // endpoint of dir[s], i.e. the key's `a` side for s = 0
+    static void endpoint(const FlowEntry& e, const int s, char* out, const std::size_t n) {
+        format_endpoint(e, (s == 0) == e.a_is_src, out, n);
+    }
+
+    static std::string rtt(const RttStat& r) {
+        if (r.n == 0) return "-";
+        return human_ns(std::uint64_t{r.min_us} * 1'000) + " / " + human_ns(std::uint64_t{r.srtt_us} * 1'000) + " / " +
+               human_ns(std::uint64_t{r.max_us} * 1'000);
+    }
+
+    // What the numbers point at: loss on the path, a receiver that stops
+    // reading, or a server slow to answer compared with the network RTT.
+    static std::vector<std::string> verdict(const FlowDetail& d) {
+        const TcpStats& t       = d.tcp;
+        const auto      resent  = t.dir[0].retrans + t.dir[1].retrans;
+        const auto      loss    = 100.0 * resent / static_cast<double>(std::max<std::uint64_t>(d.flow.packets, 1));
+        std::int64_t    path_ns = t.hs_server_ns && t.hs_client_ns ? t.hs_server_ns + t.hs_client_ns : 0;
+        if (!path_ns && t.dir[0].rtt.n && t.dir[1].rtt.n) {
+            path_ns = std::int64_t{t.dir[0].rtt.min_us + t.dir[1].rtt.min_us} * 1'000;
+        }
+        const std::int64_t resp_ns = std::int64_t{t.response.srtt_us} * 1'000;
+
+        std::vector<std::string> out;
+        if (loss >= 1.0) {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "lossy path: %.1f%% of segments resent", loss);
+            out.emplace_back(buf);
+        }
+        if (t.dir[0].zero_wins + t.dir[1].zero_wins) out.emplace_back("receiver stalled: its window closed");
+        if (t.response.n && path_ns && resp_ns > 4 * path_ns && resp_ns > 10'000'000) {
+            out.push_back("slow server: answers take " + human_ns(resp_ns) + " against a " + human_ns(path_ns) + " round trip");
+        }
+        if (out.empty()) out.emplace_back("nothing stands out");
+        return out;
+    }
+
+    // the reassembled bytes as text, non-printables as '.', wrapped at `w`
+    static int stream_lines(WINDOW* pop, int y, const int y_end, const int w, const std::uint8_t* p, const std::uint32_t n) {
+        std::string line;
+        for (std::uint32_t i = 0; i < n && y < y_end; ++i) {
+            if (p[i] == '\n' || static_cast<int>(line.size()) == w) {
+                mvwprintw(pop, y++, 2, "%s", line.c_str());
+                line.clear();
+                if (p[i] == '\n') continue;
+            }
+            if (p[i] != '\r') line.push_back(std::isprint(p[i]) ? static_cast<char>(p[i]) : '.');
+        }
+        if (!line.empty() && y < y_end) mvwprintw(pop, y++, 2, "%s", line.c_str());
+        return y;
+    }
+
+    static void draw(WINDOW* pop, const int box_h, const int box_w, const DetailState st, const FlowDetail& d) {
+        werase(pop);
+        box(pop, 0, 0);
+        mvwprintw(pop, 0, 2, "Flow detail, updated live (Esc closes)");
+        if (st != DetailState::kFound) {
+            mvwprintw(pop, 2, 2, "%s", st == DetailState::kPending ? "asking the capture threads..."
+                                     : "no longer tracked: the flow went idle or was evicted");
+            wrefresh(pop);
+            return;
+        }
+
+        const FlowEntry& e = d.flow;
+        const TcpStats&  t = d.tcp;
+        const int        c = d.tcp_valid ? t.client : 0;
+        char from[INET6_ADDRSTRLEN + 8], to[INET6_ADDRSTRLEN + 8];
+        endpoint(e, c, from, sizeof(from));
+        endpoint(e, c ^ 1, to, sizeof(to));
+        mvwprintw(pop, 1, 2, "%s -> %s  %s", from, to, proto_name(e.key.proto));
+        mvwprintw(pop, 2, 2, "%llu packets, %s over %s", static_cast<unsigned long long>(e.packets),
+                  human_bytes(e.bytes).c_str(), human_ns(static_cast<std::uint64_t>(e.last_ns - e.first_ns)).c_str());
+        if (!d.tcp_valid) {
+            mvwprintw(pop, 4, 2, "%s", e.key.proto != Proto::kTcp ? "not TCP, nothing more to show"
+                                     : "no TCP analysis: the shard's connection pool was full");
+            wrefresh(pop);
+            return;
+        }
+
+        const TcpDir& cs = t.dir[c];
+        const TcpDir& sc = t.dir[c ^ 1];
+        int y = 3;
+        mvwprintw(pop, y++, 2, "client %s by its SYN, handshake %s to the server and %s to the client",
+                  t.client_known ? "known" : "guessed", t.hs_server_ns ? human_ns(t.hs_server_ns).c_str() : "-",
+                  t.hs_client_ns ? human_ns(t.hs_client_ns).c_str() : "-");
+        mvwprintw(pop, y++, 2, "server response %u answers, min / avg / max %s", t.response.n, rtt(t.response).c_str());
+        ++y;
+        wattron(pop, A_UNDERLINE);
+        mvwprintw(pop, y++, 2, "%-24s %28s %28s", "", "client -> server", "server -> client");
+        wattroff(pop, A_UNDERLINE);
+        mvwprintw(pop, y++, 2, "%-24s %28s %28s", "Data, resends aside", human_bytes(cs.bytes).c_str(), human_bytes(sc.bytes).c_str());
+        mvwprintw(pop, y++, 2, "%-24s %28s %28s", "RTT min / srtt / max", rtt(cs.rtt).c_str(), rtt(sc.rtt).c_str());
+        mvwprintw(pop, y++, 2, "%-24s %28u %28u", "Retransmissions", cs.retrans, sc.retrans);
+        mvwprintw(pop, y++, 2, "%-24s %28u %28u", "Out of order", cs.ooo, sc.ooo);
+        mvwprintw(pop, y++, 2, "%-24s %28u %28u", "Duplicate ACKs sent", cs.dup_acks, sc.dup_acks);
+        mvwprintw(pop, y++, 2, "%-24s %28u %28u", "Zero windows sent", cs.zero_wins, sc.zero_wins);
+        ++y;
+        wattron(pop, A_BOLD);
+        for (const std::string& v : verdict(d)) mvwprintw(pop, y++, 2, "%.*s", box_w - 4, v.c_str());
+        wattroff(pop, A_BOLD);
+
+        if (gCfg.reasm_bytes == 0) {
+            if (y + 1 < box_h - 1) mvwprintw(pop, y + 1, 2, "stream contents need --reassemble");
+        } else {
+            // split what is left between the two directions
+            const int room = (box_h - 1 - y) / 2;
+            for (const int s : {c, c ^ 1}) {
+                if (room < 2) break;
+                const int end = y + room;
+                mvwprintw(pop, y++, 2, "-- %s, %u bytes reassembled --", s == c ? "client -> server" : "server -> client",
+                          d.stream_len[s]);
+                y = std::max(stream_lines(pop, y, end, box_w - 4, d.stream[s], d.stream_len[s]), end);
+            }
+        }
+        wrefresh(pop);
+    }
+
+    // details of the selected row's flow, asked for again every REFRESH_MS
+    void popup() {
+        if (history_size() == 0) return;
+        bool          a_is_src;
+        const FlowKey k = make_flow_key(history_row(gSelected), a_is_src);
+
+        int H, W; getmaxyx(stdscr, H, W);
+        const int box_h = std::max(H - 4, 12), box_w = std::min(W - 4, 96);
+        WINDOW* pop = newwin(box_h, box_w, (H - box_h) / 2, (W - box_w) / 2);
+        keypad(pop, TRUE);
+        wtimeout(pop, REFRESH_MS);
+
+        static FlowDetail d;
+        ask_flow_detail(k);
+        while (true) {
+            const DetailState st = flow_detail(d);
+            draw(pop, box_h, box_w, st, d);
+            if (wgetch(pop) == 27) break;
+            drain_captured();     // keep the queues moving behind the popup
+            ask_flow_detail(k);
+        }
+        delwin(pop);
+    }
+}
+
+namespace dns {
+    constexpr int REFRESH_MS = 500;
+
+    static void row(WINDOW* pop, const int y, const char* name, const std::size_t n, const char* lost,
+                    const HistSnapshot& h) {
+        const auto q = [&h](const double p) { return h.total ? human_ns(h.percentile(p)) : std::string("-"); };
+        mvwprintw(pop, y, 2, "%-26.26s %9zu %7s %9s %9s %9s %9s", name, n, lost, q(0.5).c_str(), q(0.9).c_str(),
+                  q(0.99).c_str(), h.total ? human_ns(h.max).c_str() : "-");
+    }
+
+    // resolver and rcode latency, live until Esc
+    void popup() {
+        int H, W; getmaxyx(stdscr, H, W);
+        const int box_h = std::max(H - 4, 12), box_w = std::min(W - 4, 96);
+        WINDOW* pop = newwin(box_h, box_w, (H - box_h) / 2, (W - box_w) / 2);
+        keypad(pop, TRUE);
+        wtimeout(pop, REFRESH_MS);
+
+        while (true) {
+            const DnsTotals d = dns_totals();
+            werase(pop);
+            box(pop, 0, 0);
+            mvwprintw(pop, 0, 2, "DNS, updated live (Esc closes)");
+            int y = 1;
+            if (!gCfg.dns_slots) {
+                mvwprintw(pop, y, 2, "DNS matching is off (--dns-slots 0)");
+            } else {
+                mvwprintw(pop, y++, 2, "%zu queries, %zu responses, %zu unanswered after %ds, %zu pending, %zu responses "
+                          "to unseen queries", d.queries, d.responses, d.unanswered, gCfg.dns_timeout, d.pending, d.unmatched);
+                if (d.forgotten) mvwprintw(pop, y++, 2, "%zu queries forgotten for lack of room, see --dns-slots", d.forgotten);
+                ++y;
+                wattron(pop, A_UNDERLINE);
+                mvwprintw(pop, y++, 2, "%-26s %9s %7s %9s %9s %9s %9s", "Resolver", "Queries", "Lost", "p50", "p90", "p99",
+                          "max");
+                wattroff(pop, A_UNDERLINE);
+                char name[INET6_ADDRSTRLEN];
+                const int rcode_rows = static_cast<int>(DNS_RCODES) + 3;
+                for (std::size_t i = 0; i < d.resolvers.size() && y < box_h - 1 - rcode_rows; ++i) {
+                    const DnsResolverTotals& r = d.resolvers[i];
+                    if (r.family) format_addr(r.family, r.addr, name, sizeof(name));
+                    else          std::snprintf(name, sizeof(name), "other");
+                    row(pop, y++, name, r.queries, std::to_string(r.unanswered).c_str(), r.latency);
+                }
+                ++y;
+                wattron(pop, A_UNDERLINE);
+                mvwprintw(pop, y++, 2, "%-26s %9s %7s %9s %9s %9s %9s", "Rcode", "Responses", "", "p50", "p90", "p99",
+                          "max");
+                wattroff(pop, A_UNDERLINE);
+                for (std::size_t i = 0; i < DNS_RCODES && y < box_h - 1; ++i) {
+                    if (d.rcodes[i]) row(pop, y++, DNS_RCODE_NAMES[i], d.rcodes[i], "", d.by_rcode[i]);
+                }
+            }
+            wrefresh(pop);
+            if (wgetch(pop) == 27) break;
+            drain_captured();
+        }
+        delwin(pop);
+    }
+}
+
+// the command line's stop condition, set before capture starts
+static void apply_stop_limit() {
+    if (gCfg.stop_packets)      gCapLim.set(LimitKind::kPackets, gCfg.stop_packets);
+    else if (gCfg.stop_bytes)   gCapLim.set(LimitKind::kBytes,   gCfg.stop_bytes);
+    else if (gCfg.stop_seconds) gCapLim.set(LimitKind::kSeconds, gCfg.stop_seconds);
+}
+
+// Opens the selected devices with the command line's filter; false, with the
+// reason in gErr, if they can't be opened or the filter doesn't compile.
+static bool open_live() {
+    if (gCfg.filter) gFilter.expr = gCfg.filter;
+    if (!open_devices()) return false;
+    if (gCfg.filter && gFilter.expr.empty()) {
+        std::snprintf(gErr, PCAP_ERRBUF_SIZE, "filter: %s", gFilter.error.c_str());
+        return false;
+    }
+    return true;
+}
+
+namespace headless {
+    static std::atomic<bool> stop_requested{false};
+    static std::atomic<bool> dump_requested{false};
+
+    static void on_signal(int) { stop_requested = true; }
+    static void on_usr1(int)   { dump_requested = true; }
+
+    // Captures with no UI until a stop condition or a signal. Once per
+    // --interval the metrics are gathered and handed to the HTTP server and
+    // the JSON lines file; the capture threads never see any of it. SIGUSR1
+    // fires the flight recorder.
+    int run() {
+        std::signal(SIGINT,  on_signal);
+        std::signal(SIGTERM, on_signal);
+        std::signal(SIGUSR1, on_usr1);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        MetricsServer server;
+        if (gCfg.metrics && !server.start(gCfg.metrics)) {
+            std::fprintf(stderr, "--metrics: %s\n", gErr);
+            return EXIT_FAILURE;
+        }
+        std::FILE* json = nullptr;
+        if (gCfg.json) {
+            json = std::strcmp(gCfg.json, "-") == 0 ? stdout : std::fopen(gCfg.json, "a");
+            if (!json) {
+                std::fprintf(stderr, "--json %s: %s\n", gCfg.json, std::strerror(errno));
+                return EXIT_FAILURE;
+            }
+        }
+        if (!open_live()) {
+            std::fprintf(stderr, "%s\n", gErr);
+            return EXIT_FAILURE;
+        }
+
+        using clock = std::chrono::steady_clock;
+        const auto      interval  = std::chrono::seconds{gCfg.interval};
+        auto            last_tick = clock::now();
+        bool            more      = true;
+        MetricsSnapshot m;
+        gRates.sample(total_counters(), 0);
+
+        while (more) {
+            drain_captured();
+            gCapLim.tick();
+            more = !stop_requested && !gCapLim.hit() && capture_running();
+            if (dump_requested.exchange(false)) gWriter.trigger("signal");
+
+            const auto now = clock::now();
+            if (now - last_tick >= interval || !more) {
+                gRates.sample(total_counters(), std::chrono::duration<double>(now - last_tick).count());
+                check_rate_triggers();
+                last_tick = now;
+                update_filter_stats();
+                m.take();
+                if (gCfg.metrics) server.publish(prometheus_text(m));
+                if (json) {
+                    std::fputs(json_line(m).c_str(), json);
+                    std::fflush(json);
+                }
+            }
+            if (more) std::this_thread::sleep_for(std::chrono::milliseconds{UI_NAP_MS});
+        }
+
+        close_devices();
+        gWriter.close();
+        server.stop();
+        if (json && json != stdout) std::fclose(json);
+        std::fprintf(stderr, "Capture finished: %zu packets, %zu dropped by the kernel\n",
+                     m.c.all, static_cast<std::size_t>(m.kernel.drop));
+        if (gWriter.recorder()) std::fprintf(stderr, "Recorder: %zu trigger(s)\n", gWriter.triggers());
+        return 0;
+    }
+}
+
+// The memory budgets and table sizes are split evenly over the capture
+// shards, one per worker and interface (just one reading a file); false with
+// a message if a share falls below its minimum.
+static bool check_shares(const std::size_t shards) {
+    if (gCfg.payload_mem && gCfg.payload_mem / shards < PAYLOAD_MEM_MIN) {
+        std::fprintf(stderr, "--payload-mem must be 0 or at least %zuM per worker and interface\n", PAYLOAD_MEM_MIN >> 20);
+        return false;
+    }
+    if (gCfg.record_bytes && gCfg.record_bytes / shards < RECORD_BYTES_MIN) {
+        std::fprintf(stderr, "--record must be at least %zuM per worker and interface\n", RECORD_BYTES_MIN >> 20);
+        return false;
+    }
+    if (gCfg.flow_slots && gCfg.flow_slots / shards < FLOW_SLOTS_MIN) {
+        std::fprintf(stderr, "--flow-slots must be 0 or at least %zu per worker and interface\n", FLOW_SLOTS_MIN);
+        return false;
+    }
+    if (gCfg.dns_slots && gCfg.dns_slots / shards < DNS_SLOTS_MIN) {
+        std::fprintf(stderr, "--dns-slots must be 0 or at least %zu per worker and interface\n", DNS_SLOTS_MIN);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    parse_args(argc, argv);
+
+    const bool offline = gCfg.read_file != nullptr;
+    if (gCfg.spool_bytes && (!offline || gCfg.tui) && !gSpool.open(gCfg.spool_dir, gCfg.spool_bytes)) {
+        std::fprintf(stderr, "%s; scrollback is limited to the last %zu rows\n", gErr, MAX_ROWS);
+    }
+    if (gCfg.match) {
+        Pattern     p;
+        std::string err;
+        if (!Pattern::parse(gCfg.match, p, err)) {
+            std::fprintf(stderr, "--match: %s\n", err.c_str());
+            return EXIT_FAILURE;
+        }
+        search::start(p);
+    }
+    if (offline) {
+        if (!check_shares(1)) return EXIT_FAILURE;
+        if (gCfg.tui) gShowHex = true;
+        apply_stop_limit();
+        print_offline_summary(gCfg.read_file, run_offline(gCfg.read_file));
+        if (!gCfg.tui) return 0;
+    } else {
+        dev::enumerate();
+        for (const char* name : gCfg.devices) {
+            if (!dev::add(name)) {
+                std::fprintf(stderr, "no such device: %s\n", name);
+                return EXIT_FAILURE;
+            }
+        }
+        if (gCapDevs.empty()) gCapDevs.push_back(0);
+        if (gCapDevs.size() * static_cast<std::size_t>(gCfg.workers) > MAX_SHARDS) {
+            std::fprintf(stderr, "at most %zu capture sockets: interfaces times --workers\n", MAX_SHARDS);
+            return EXIT_FAILURE;
+        }
+        if (!check_shares(gCapDevs.size() * static_cast<std::size_t>(gCfg.workers))) return EXIT_FAILURE;
+        RotatePolicy rotate;
+        rotate.max_bytes   = gCfg.rotate_bytes;
+        rotate.max_packets = gCfg.rotate_packets;
+        rotate.max_seconds = gCfg.rotate_seconds;
+        rotate.max_files   = gCfg.max_files;
+        gWriter.configure(gCfg.write_file ? gCfg.write_file : "", rotate);
+        if (gCfg.pcapng) gWriter.configure_pcapng(gCfg.compress_level);
+        if (gCfg.record_bytes) {
+            gWriter.configure_recorder(gCfg.record_seconds, gCfg.post_seconds);
+            gTriggers.pps     = static_cast<double>(gCfg.trigger_pps);
+            gTriggers.rst_pps = static_cast<double>(gCfg.trigger_rst);
+        }
+        apply_stop_limit();
+        if (gCfg.headless) return headless::run();
+    }
 
     initscr();
     cbreak();
@@ -127,20 +801,35 @@ int main() {
     int H, W; getmaxyx(stdscr, H, W);
     init_windows(H, W);
 
-    open_device(gCurDev);
+    if (!offline && !open_live()) {
+        endwin();
+        std::fprintf(stderr, "%s\n", gErr);
+        return EXIT_FAILURE;
+    }
 
-    std::size_t                last_bytes = 0;
-    auto                       last_tick  = std::chrono::steady_clock::now();
-    bool                       running    = true;
+    using clock = std::chrono::steady_clock;
+    auto     last_tick  = clock::now();
+    auto     last_frame = clock::time_point{};
+    auto     last_key   = clock::time_point{};
+    unsigned damage     = DAMAGE_ALL;
+    bool     running    = true;
+    if (!offline) gRates.sample(total_counters(), 0);
 
     while (running) {
-        pcap_dispatch(gHandle, DISPATCH_BULK, packet_cb, nullptr);
+        if (drain_captured() > 0) {
+            // with the newest row selected the hex pane follows it
+            damage |= DAMAGE_STATS | DAMAGE_TABLE | (gSelected == 0 ? DAMAGE_HEX : 0);
+        }
 
-        if (auto now = std::chrono::steady_clock::now(); now - last_tick >= std::chrono::seconds{1}) {
-            const std::size_t cur = gCnt.bytes.load();
-            gBps       = cur - last_bytes;
-            last_bytes = cur;
+        const auto now = clock::now();
+        if (now - last_tick >= std::chrono::seconds{1}) {
+            // popups block this loop, so a tick can span more than a second
+            gRates.sample(total_counters(), std::chrono::duration<double>(now - last_tick).count());
+            check_rate_triggers();
             last_tick  = now;
+            update_filter_stats();
+            if (!offline) dev::hotplug();
+            damage |= DAMAGE_STATS | DAMAGE_SKETCH | DAMAGE_FLOWS | DAMAGE_INSTR | (gShowRates ? DAMAGE_HEX : 0);
         }
 
         int h_tbl, _;
@@ -150,26 +839,62 @@ int main() {
         else if (static_cast<int>(gSelected - gFirstVis) >= visible) gFirstVis = gSelected - visible + 1;
         else if (gSelected < gFirstVis) gFirstVis = gSelected;
 
-        refresh_render();
+        const auto frame = std::chrono::milliseconds{now - last_key < std::chrono::milliseconds{INPUT_BURST_MS}
+                                                         ? FRAME_INPUT_MS : FRAME_LIVE_MS};
+        int wait = UI_NAP_MS;
+        if (damage) {
+            if (now - last_frame >= frame) {
+                refresh_render(damage);
+                gRenderLat.record(static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - now).count()));
+                damage     = 0;
+                last_frame = now;
+            } else {
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(last_frame + frame - now);
+                wait = std::clamp(static_cast<int>(left.count()), 1, UI_NAP_MS);
+            }
+        }
 
-        if (gCapLim.hit(gCnt)) { running = false; continue; }
+        if (!offline) gCapLim.tick();
+        if (!offline && gCapLim.hit()) { running = false; continue; }
 
-        switch (getch()) {
+        // blocks until a key or the timeout, so keys are handled the moment they arrive
+        timeout(wait);
+        const int ch = getch();
+        if (ch == ERR) continue;
+        last_key = clock::now();
+        switch (ch) {
             case 'q': running = false; break;
-            case 'p': gPaused = !gPaused; break;
-            case 'h': gShowHex = !gShowHex; break;
-            case 'd': dev::popup(); break;
-            case 'c': limit::popup(); break;
-            case KEY_UP:   if (gSelected < gRows.size() - 1) ++gSelected; break;
-            case KEY_DOWN: if (gSelected > 0)               --gSelected; break;
+            case 'p': gPaused = !gPaused.load(); break;
+            case 'r': gWriter.trigger("key"); damage |= DAMAGE_STATS; break;
+            case 'h': gShowHex = !gShowHex.load(); damage |= DAMAGE_HEX; break;
+            case 'g': gShowRates = !gShowRates;    damage |= DAMAGE_HEX; break;
+            case 'f': gShowFlows = !gShowFlows; init_windows(H, W); damage |= DAMAGE_ALL; break;
+            case 'i': gShowInstr = !gShowInstr; init_windows(H, W); damage |= DAMAGE_ALL; break;
+            case 'o': gFlowsByRate = !gFlowsByRate; damage |= DAMAGE_FLOWS; break;
+            case 'd': if (!offline) dev::popup();   damage |= DAMAGE_ALL; break;
+            case 'c': if (!offline) limit::popup(); damage |= DAMAGE_ALL; break;
+            case 'b': if (!offline) bpf::popup();   damage |= DAMAGE_ALL; break;
+            case 't': jump::popup();   damage |= DAMAGE_ALL; break;
+            case '/': search::popup(); damage |= DAMAGE_ALL; break;
+            case '\n': flow::popup(); damage |= DAMAGE_ALL; break;
+            case 'D':  dns::popup();  damage |= DAMAGE_ALL; break;
+            case 'n': search::next(true);  damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case 'N': search::next(false); damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_UP:    if (gSelected + 1 < history_size()) ++gSelected; damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_DOWN:  if (gSelected > 0)                   --gSelected; damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_PPAGE: gSelected = std::min(gSelected + std::max(visible, 1), history_size() ? history_size() - 1 : 0);
+                            damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_NPAGE: gSelected -= std::min<std::size_t>(gSelected, std::max(visible, 1)); damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_HOME:  gSelected = history_size() ? history_size() - 1 : 0; damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
+            case KEY_END:   gSelected = 0; damage |= DAMAGE_TABLE | DAMAGE_HEX; break;
             default: break;
         }
-        napms(UI_NAP_MS);
     }
 
     endwin();
-    if (gDumper) { pcap_dump_close(gDumper); gDumper = nullptr; }
-    pcap_close(gHandle);
+    close_devices();
+    gWriter.close();
 
     std::puts("\nCapture finished.");
     return 0;
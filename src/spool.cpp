@@ -0,0 +1,119 @@
+//
+// Created by Shaunik Musukula on 7/19/25.
+//
+
+#include "spool.h"
+#include "state.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+bool Spool::open(const char* dir, const std::size_t bytes) {
+    close();
+    std::string path = std::string(dir) + "/sniffer-spool-XXXXXX";
+    fd_ = mkstemp(path.data());
+    if (fd_ < 0) {
+        std::snprintf(gErr, sizeof(gErr), "spool in %s: %s", dir, std::strerror(errno));
+        return false;
+    }
+    unlink(path.c_str());       // gone from the directory already, and from the disk when we exit
+
+    slots_    = bytes / SPOOL_INDEX_SHARE / sizeof(PacketRecord);
+    data_cap_ = bytes - slots_ * sizeof(PacketRecord);
+    map_len_  = slots_ * sizeof(PacketRecord) + data_cap_;
+    if (const int err = posix_fallocate(fd_, 0, static_cast<off_t>(map_len_)); err != 0) {
+        std::snprintf(gErr, sizeof(gErr), "spool in %s: %s", dir, std::strerror(err));
+        close();
+        return false;
+    }
+    void* m = mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (m == MAP_FAILED) {
+        std::snprintf(gErr, sizeof(gErr), "spool mmap: %s", std::strerror(errno));
+        close();
+        return false;
+    }
+    map_   = static_cast<std::uint8_t*>(m);
+    index_ = reinterpret_cast<PacketRecord*>(map_);
+    data_  = map_ + slots_ * sizeof(PacketRecord);
+    reset();
+    return true;
+}
+
+void Spool::close() {
+    if (map_) munmap(map_, map_len_);
+    if (fd_ >= 0) ::close(fd_);
+    map_   = nullptr;
+    index_ = nullptr;
+    data_  = nullptr;
+    fd_    = -1;
+    reset();
+}
+
+// A payload never wraps: if it doesn't fit before the end of the ring, the
+// tail is skipped and it starts over at the front.
+void Spool::append(const PacketRecord& r, const PayloadRing* src) {
+    PacketRecord& e = index_[count_ % slots_];
+    e = r;
+    ++count_;
+    if (!src || r.pl_len == 0 || r.pl_len > data_cap_) {
+        e.pl_len = 0;
+        return;
+    }
+    const std::size_t at = data_head_ % data_cap_;
+    if (at + r.pl_len > data_cap_) data_head_ += data_cap_ - at;
+    // the head moves on even if the arena copy fails: those bytes were already
+    // overwritten by whatever was written there
+    e.pl_off    = data_head_;
+    data_head_ += r.pl_len;
+    if (!src->copy_out(r.pl_off, r.pl_len, data_ + e.pl_off % data_cap_)) e.pl_len = 0;
+}
+
+bool Spool::payload(const PacketRecord& r, std::uint8_t* out) const {
+    if (r.pl_len == 0 || data_head_ - r.pl_off > data_cap_) return false;
+    std::memcpy(out, data_ + r.pl_off % data_cap_, r.pl_len);
+    return true;
+}
+
+// Spooled rows are numbered like gRows.pushed(): both start over together when
+// the device changes, and every row pushed is also appended.
+std::size_t history_size() {
+    if (!gSpool.enabled()) return gRows.size();
+    return std::max(gRows.size(), std::min(gRows.pushed(), gSpool.retained()));
+}
+
+const PacketRecord& history_row(const std::size_t i) {
+    if (i < gRows.size()) return gRows.recent(i);
+    return gSpool.row(gRows.pushed() - 1 - i);
+}
+
+bool history_payload(const std::size_t i, std::uint8_t* out) {
+    if (i < gRows.size()) {
+        const PacketRecord& r = gRows.recent(i);
+        if (r.shard < gShards.size() && gShards[r.shard]->payload.copy_out(r.pl_off, r.pl_len, out)) return true;
+    }
+    const std::size_t n = gRows.pushed() - 1 - i;
+    return gSpool.enabled() && gSpool.count() - n <= gSpool.retained() && gSpool.payload(gSpool.row(n), out);
+}
+
+// Rows come out of the k-way merge in timestamp order, so the history is
+// sorted newest first and a binary search finds any time at once.
+std::size_t history_find(const timeval& ts) {
+    const auto later = [&](const timeval& t) {
+        return t.tv_sec > ts.tv_sec || (t.tv_sec == ts.tv_sec && t.tv_usec > ts.tv_usec);
+    };
+    std::size_t lo = 0, hi = history_size();
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        if (later(history_row(mid).ts)) lo = mid + 1;
+        else                            hi = mid;
+    }
+    return std::min(lo, history_size() ? history_size() - 1 : 0);
+}
@@ -4,16 +4,23 @@
 
 #include "state.h"
 
-std::vector<Row>           gRows;
-Counters                   gCnt;
-bool                       gPaused   = false;
-bool                       gShowHex  = false;
-std::vector<DeviceMapping> gDevices;
-std::size_t                gCurDev   = 0;
-pcap_t*                    gHandle   = nullptr;
-pcap_dumper_t*             gDumper   = nullptr;
-char                       gErr[PCAP_ERRBUF_SIZE]{};
-std::size_t                gSelected = 0;
-std::size_t                gFirstVis = 0;
-CaptureLimit               gCapLim;
-std::size_t                gBps = 0;
\ No newline at end of file
+PacketRing                                 gRows(MAX_ROWS);
+Spool                                      gSpool;
+std::vector<std::unique_ptr<CaptureShard>> gShards;
+std::atomic<bool>                          gPaused{false};
+std::atomic<bool>                          gShowHex{false};
+std::vector<DeviceMapping>                 gDevices;
+std::vector<std::size_t>                   gCapDevs;
+PcapWriter                                 gWriter;
+char                                       gErr[PCAP_ERRBUF_SIZE]{};
+std::size_t                                gSelected    = 0;
+std::size_t                                gFirstVis    = 0;
+CaptureLimit                               gCapLim;
+RateHistory                                gRates;
+bool                                       gNanoTs      = false;
+bool                                       gShowFlows   = true;
+bool                                       gFlowsByRate = false;
+bool                                       gShowRates   = false;
+bool                                       gShowInstr   = false;
+Histogram                                  gRenderLat;
+FilterState                                gFilter;
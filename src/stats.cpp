@@ -0,0 +1,74 @@
+//
+// Created by Shaunik Musukula on 7/18/25.
+//
+
+#include "stats.h"
+
+void Counters::clear() {
+    for (auto& c : pkts)  c = 0;
+    for (auto& c : bytes) c = 0;
+    for (auto& c : sizes) c = 0;
+    dropped   = 0;
+    delivered = 0;
+    matches   = 0;
+    rsts      = 0;
+    retrans   = 0;
+    ooo       = 0;
+    dup_acks  = 0;
+    zero_wins = 0;
+}
+
+void CounterTotals::add(const Counters& c) {
+    for (std::size_t i = 0; i < N_PROTO; ++i) {
+        const std::size_t p = c.pkts[i].load(std::memory_order_relaxed);
+        const std::size_t b = c.bytes[i].load(std::memory_order_relaxed);
+        pkts[i]     += p;
+        bytes[i]    += b;
+        all         += p;
+        total_bytes += b;
+    }
+    for (std::size_t i = 0; i < SIZE_BUCKETS; ++i) sizes[i] += c.sizes[i].load(std::memory_order_relaxed);
+    dropped   += c.dropped.load(std::memory_order_relaxed);
+    delivered += c.delivered.load(std::memory_order_relaxed);
+    matches   += c.matches.load(std::memory_order_relaxed);
+    rsts      += c.rsts.load(std::memory_order_relaxed);
+    retrans   += c.retrans.load(std::memory_order_relaxed);
+    ooo       += c.ooo.load(std::memory_order_relaxed);
+    dup_acks  += c.dup_acks.load(std::memory_order_relaxed);
+    zero_wins += c.zero_wins.load(std::memory_order_relaxed);
+}
+
+static std::uint64_t delta(const std::size_t now, const std::size_t then) {
+    return now >= then ? now - then : now;
+}
+
+// The first call only records where the counters stand. Shards are rebuilt
+// when the interface changes, so a counter that went backwards started over.
+void RateHistory::sample(const CounterTotals& now, const double secs) {
+    if (!primed_) {
+        last_   = now;
+        primed_ = true;
+        return;
+    }
+    RateSample& s = buf_[head_];
+    s.at        = std::time(nullptr);
+    s.secs      = secs;
+    s.all_pkts  = 0;
+    s.all_bytes = 0;
+    for (std::size_t i = 0; i < N_PROTO; ++i) {
+        s.pkts[i]    = delta(now.pkts[i], last_.pkts[i]);
+        s.bytes[i]   = delta(now.bytes[i], last_.bytes[i]);
+        s.all_pkts  += s.pkts[i];
+        s.all_bytes += s.bytes[i];
+    }
+    s.rsts = delta(now.rsts, last_.rsts);
+    last_  = now;
+    head_ = (head_ + 1) % HISTORY_SECS;
+    if (n_ < HISTORY_SECS) ++n_;
+}
+
+void RateHistory::reset() {
+    head_   = 0;
+    n_      = 0;
+    primed_ = false;
+}
@@ -0,0 +1,230 @@
+//
+// Created by Shaunik Musukula on 7/24/25.
+//
+
+#include "tcp_analysis.h"
+#include "net_types.h"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr std::uint8_t TD_SEQ    = 0x01;   // next_seq is known
+constexpr std::uint8_t TD_ACK    = 0x02;   // last_ack and last_win are known
+constexpr std::uint8_t TD_TIMING = 0x04;   // timed_seq waits for its ACK
+constexpr std::uint8_t TD_ZERO   = 0x08;   // the window is closed
+
+// sequence space comparisons, modulo 2^32
+static bool seq_lt(const std::uint32_t a, const std::uint32_t b) { return static_cast<std::int32_t>(a - b) < 0; }
+static bool seq_le(const std::uint32_t a, const std::uint32_t b) { return static_cast<std::int32_t>(a - b) <= 0; }
+
+void RttStat::add(const std::int64_t ns) {
+    const auto us = static_cast<std::uint32_t>(std::clamp<std::int64_t>(ns / 1'000, 1, UINT32_MAX));
+    if (n == 0 || us < min_us) min_us = us;
+    if (us > max_us) max_us = us;
+    srtt_us = n == 0 ? us : static_cast<std::uint32_t>(srtt_us + (static_cast<std::int64_t>(us) - srtt_us) / 8);
+    ++n;
+}
+
+// calloc keeps untouched entries on the kernel's zero pages; handles are
+// bumped out of the pools in order and reused from the free stacks
+TcpTracker::TcpTracker(const std::size_t max_conns, const std::size_t reasm_bytes)
+    : max_conns_(max_conns),
+      conns_(max_conns ? static_cast<TcpStats*>(std::calloc(max_conns, sizeof(TcpStats))) : nullptr, &std::free),
+      free_conns_(max_conns ? static_cast<std::uint32_t*>(std::calloc(max_conns, sizeof(std::uint32_t))) : nullptr, &std::free),
+      n_free_conns_(0),
+      conns_bumped_(0),
+      max_chunks_(max_conns ? std::min(reasm_bytes / REASM_CHUNK, 2 * max_conns) : 0),
+      chunks_(max_chunks_ ? static_cast<std::uint8_t*>(std::malloc(max_chunks_ * REASM_CHUNK)) : nullptr, &std::free),
+      free_chunks_(max_chunks_ ? static_cast<std::uint32_t*>(std::calloc(max_chunks_, sizeof(std::uint32_t))) : nullptr, &std::free),
+      n_free_chunks_(0),
+      chunks_bumped_(0) {}
+
+std::uint32_t TcpTracker::acquire() {
+    std::uint32_t h;
+    if (n_free_conns_ > 0)              h = free_conns_[--n_free_conns_];
+    else if (conns_bumped_ < max_conns_) h = static_cast<std::uint32_t>(++conns_bumped_);
+    else {
+        ++untracked_;
+        return 0;
+    }
+    std::memset(&stats(h), 0, sizeof(TcpStats));
+    return h;
+}
+
+void TcpTracker::release(const std::uint32_t h) {
+    if (h == 0) return;
+    for (const TcpDir& d : stats(h).dir) {
+        if (d.stream) free_chunks_[n_free_chunks_++] = d.stream;
+    }
+    free_conns_[n_free_conns_++] = h;
+}
+
+std::uint8_t TcpTracker::track(TcpStats& t, const int s, const Decoded& d, const std::uint8_t* pkt,
+                               const std::int64_t now_ns) {
+    TcpDir&            me   = t.dir[s];
+    TcpDir&            peer = t.dir[s ^ 1];
+    const std::uint8_t fl   = d.tcp_flags;
+    const std::uint32_t len = d.tcp_len;
+    std::uint8_t       ev   = 0;
+
+    // who opened the connection, and the two halves of the handshake
+    if ((fl & (TH_SYN | TH_ACK)) == TH_SYN) {
+        if (!t.syn_ns) t.syn_ns = now_ns;
+        t.client       = static_cast<std::uint8_t>(s);
+        t.client_known = true;
+    } else if ((fl & (TH_SYN | TH_ACK)) == (TH_SYN | TH_ACK)) {
+        if (!t.client_known) {
+            t.client       = static_cast<std::uint8_t>(s ^ 1);
+            t.client_known = true;
+        }
+        if (t.syn_ns && !t.synack_ns) {
+            t.synack_ns    = now_ns;
+            t.hs_server_ns = std::max<std::int64_t>(now_ns - t.syn_ns, 1);
+        }
+    } else if ((fl & TH_ACK) && t.synack_ns && !t.hs_client_ns && s == t.client) {
+        t.hs_client_ns = std::max<std::int64_t>(now_ns - t.synack_ns, 1);
+    } else if (!t.client_known && !t.syn_ns) {
+        t.client = static_cast<std::uint8_t>(d.sport > d.dport ? s : s ^ 1);   // ephemeral port opens
+    }
+
+    // sequence space: new data, a retransmission, or a reordered segment
+    const std::uint32_t span = len + ((fl & TH_SYN) ? 1 : 0) + ((fl & TH_FIN) ? 1 : 0);
+    const std::uint32_t end  = d.seq + span;
+    if (span > 0 && !(fl & TH_RST)) {
+        if (!(me.state & TD_SEQ)) {
+            me.state       |= TD_SEQ;
+            me.isn          = (fl & TH_SYN) ? d.seq + 1 : d.seq;
+            me.next_seq     = end;
+            me.last_new_ns  = now_ns;
+            me.bytes       += len;
+        } else if (seq_lt(me.next_seq, end)) {
+            if (seq_lt(d.seq, me.next_seq)) {
+                // resent with new data behind it
+                ++me.retrans;
+                ev |= TCP_EV_RETRANS;
+                me.state &= static_cast<std::uint8_t>(~TD_TIMING);
+            } else if (!(me.state & TD_TIMING)) {
+                me.timed_seq = end;
+                me.timed_ns  = now_ns;
+                me.state    |= TD_TIMING;
+            }
+            std::uint32_t fresh = end - (seq_lt(d.seq, me.next_seq) ? me.next_seq : d.seq);
+            if ((fl & TH_FIN) && fresh) --fresh;
+            me.bytes       += fresh;
+            me.next_seq     = end;
+            me.last_new_ns  = now_ns;
+        } else if (!(len <= 1 && d.seq == me.next_seq - 1 && !(fl & (TH_SYN | TH_FIN)))) {
+            // old data (keep-alives aside): a segment overtaken by a later
+            // one within an RTT was reordered, anything later was resent
+            const std::int64_t window = me.rtt.n ? static_cast<std::int64_t>(me.rtt.srtt_us) * 1'000 : TCP_OOO_WINDOW_NS;
+            if (now_ns - me.last_new_ns < window) {
+                ++me.ooo;
+                ev |= TCP_EV_OOO;
+            } else {
+                ++me.retrans;
+                ev |= TCP_EV_RETRANS;
+                // Karn: an ACK may now be for either copy
+                if ((me.state & TD_TIMING) && seq_lt(d.seq, me.timed_seq)) me.state &= static_cast<std::uint8_t>(~TD_TIMING);
+            }
+        }
+        if (len > 0 && max_chunks_ && d.pl_off < d.pl_end) {
+            reassemble(me, d.seq, pkt + d.pl_off, std::min(len, d.pl_end - d.pl_off));
+        }
+    }
+
+    // this side's ACK: an RTT sample for the peer, or a duplicate
+    if ((fl & TH_ACK) && !(fl & TH_RST)) {
+        if ((peer.state & TD_TIMING) && seq_le(peer.timed_seq, d.ack)) {
+            peer.rtt.add(now_ns - peer.timed_ns);
+            peer.state &= static_cast<std::uint8_t>(~TD_TIMING);
+        }
+        if ((me.state & TD_ACK) && len == 0 && !(fl & (TH_SYN | TH_FIN)) && d.ack == me.last_ack &&
+            d.win == me.last_win && (peer.state & TD_SEQ) && d.ack != peer.next_seq) {
+            ++me.dup_acks;
+            ev |= TCP_EV_DUP_ACK;
+        }
+        me.last_ack  = d.ack;
+        me.last_win  = d.win;
+        me.state    |= TD_ACK;
+    }
+
+    // a closed window counts once, until it opens again
+    if (!(fl & (TH_SYN | TH_FIN | TH_RST))) {
+        if (d.win == 0 && !(me.state & TD_ZERO)) {
+            ++me.zero_wins;
+            ev       |= TCP_EV_ZERO_WIN;
+            me.state |= TD_ZERO;
+        } else if (d.win != 0) {
+            me.state &= static_cast<std::uint8_t>(~TD_ZERO);
+        }
+    }
+
+    // server response time: from client data to the next server data
+    if (len > 0 && !(ev & (TCP_EV_RETRANS | TCP_EV_OOO))) {
+        if (s == t.client) {
+            if (!t.request_ns) t.request_ns = now_ns;
+        } else if (t.request_ns) {
+            t.response.add(now_ns - t.request_ns);
+            t.request_ns = 0;
+        }
+    }
+    return ev;
+}
+
+// Copies a segment into the direction's buffer at its stream offset and
+// records which bytes are there. Segments that would need more than
+// REASM_RANGES holes are written but not recorded; their retransmission or the
+// gap filling up brings them back.
+void TcpTracker::reassemble(TcpDir& dir, const std::uint32_t seq, const std::uint8_t* data, std::uint32_t len) {
+    std::int64_t off = static_cast<std::int32_t>(seq - dir.isn);
+    if (off < 0) {
+        if (-off >= len) return;
+        data += -off;
+        len  -= static_cast<std::uint32_t>(-off);
+        off   = 0;
+    }
+    if (off >= static_cast<std::int64_t>(REASM_CHUNK)) return;
+    len = std::min<std::uint32_t>(len, static_cast<std::uint32_t>(REASM_CHUNK - off));
+
+    if (!dir.stream) {
+        if (n_free_chunks_ > 0)                dir.stream = free_chunks_[--n_free_chunks_];
+        else if (chunks_bumped_ < max_chunks_) dir.stream = static_cast<std::uint32_t>(++chunks_bumped_);
+        else {
+            ++denied_;
+            return;
+        }
+    }
+    std::memcpy(chunks_.get() + (dir.stream - 1) * REASM_CHUNK + off, data, len);
+
+    auto lo = static_cast<std::uint32_t>(off), hi = lo + len;
+    if (lo > dir.contig) {
+        // merge into the sorted list of ranges past the prefix
+        std::uint32_t (*r)[2] = dir.ranges;
+        const std::size_t n   = dir.n_ranges;
+        std::size_t       at  = 0;
+        while (at < n && r[at][1] < lo) ++at;
+        std::size_t last = at;
+        while (last < n && r[last][0] <= hi) {
+            lo = std::min(lo, r[last][0]);
+            hi = std::max(hi, r[last][1]);
+            ++last;
+        }
+        if (last == at && n == REASM_RANGES) return;
+        const std::size_t gone = last - at;
+        if (gone == 0) std::memmove(r + at + 1, r + at, (n - at) * sizeof(r[0]));
+        else           std::memmove(r + at + 1, r + last, (n - last) * sizeof(r[0]));
+        r[at][0]     = lo;
+        r[at][1]     = hi;
+        dir.n_ranges = static_cast<std::uint8_t>(n + 1 - gone);
+        return;
+    }
+
+    dir.contig = std::max(dir.contig, hi);
+    std::size_t used = 0;
+    while (used < dir.n_ranges && dir.ranges[used][0] <= dir.contig) {
+        dir.contig = std::max(dir.contig, dir.ranges[used][1]);
+        ++used;
+    }
+    std::memmove(dir.ranges, dir.ranges + used, (dir.n_ranges - used) * sizeof(dir.ranges[0]));
+    dir.n_ranges = static_cast<std::uint8_t>(dir.n_ranges - used);
+}
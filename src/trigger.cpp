@@ -0,0 +1,30 @@
+//
+// Created by Shaunik Musukula on 7/23/25.
+//
+
+#include "trigger.h"
+#include "filter.h"
+#include "options.h"
+
+Triggers gTriggers;
+
+bool compile_trigger_filter(const int linktype, const int snaplen) {
+    if (gTriggers.filter.bf_insns) pcap_freecode(&gTriggers.filter);
+    gTriggers.filter = {};
+    return !gCfg.trigger_filter || compile_offline_filter(gCfg.trigger_filter, linktype, snaplen, gTriggers.filter);
+}
+
+static void edge(const double rate, const double threshold, bool& over, const char* why) {
+    if (threshold <= 0) return;
+    const bool now = rate >= threshold;
+    if (now && !over) gWriter.trigger(why);
+    over = now;
+}
+
+void check_rate_triggers() {
+    if (!gWriter.recorder() || gRates.empty()) return;
+    const RateSample& s = gRates.recent(0);
+    if (s.secs <= 0) return;
+    edge(s.pps(),                              gTriggers.pps,     gTriggers.over_pps, "packet rate");
+    edge(static_cast<double>(s.rsts) / s.secs, gTriggers.rst_pps, gTriggers.over_rst, "rst burst");
+}
@@ -4,19 +4,55 @@
 
 #include "util.h"
 
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <cstdio>
+#include <ctime>
 #include <iomanip>
 
-using namespace std::chrono;
+const char* proto_name(const Proto p) {
+    switch (p) {
+        case Proto::kTcp:   return "TCP";
+        case Proto::kUdp:   return "UDP";
+        case Proto::kIcmp:  return "ICMP";
+        case Proto::kIcmp6: return "ICMP6";
+        case Proto::kArp:   return "ARP";
+        default:            return "OTH";
+    }
+}
 
-[[nodiscard]] std::string now_string() {
-    const auto tp = system_clock::now();
-    const auto t  = system_clock::to_time_t(tp);
-    const auto ms = duration_cast<milliseconds>(tp.time_since_epoch()) % 1000;
+// Consecutive rows almost always share a second, so the localtime/strftime part
+// is cached and only the fraction is formatted per row.
+void format_ts(const timeval& ts, const bool nano, char* out, const std::size_t n) {
+    thread_local std::time_t cached_sec = -1;
+    thread_local char        prefix[16];
 
-    std::ostringstream os;
-    os << std::put_time(std::localtime(&t), "%H:%M:%S")
-       << '.' << std::setw(3) << std::setfill('0') << ms.count();
-    return os.str();
+    if (ts.tv_sec != cached_sec) {
+        const std::time_t t = ts.tv_sec;
+        std::tm           tm{};
+        localtime_r(&t, &tm);
+        std::strftime(prefix, sizeof(prefix), "%H:%M:%S", &tm);
+        cached_sec = ts.tv_sec;
+    }
+    std::snprintf(out, n, nano ? "%s.%09ld" : "%s.%06ld", prefix, static_cast<long>(ts.tv_usec));
+}
+
+void format_addr(const std::uint8_t family, const IpAddr& a, char* out, const std::size_t n) {
+    if (!inet_ntop(family == AF_INET6 ? AF_INET6 : AF_INET, &a, out, static_cast<socklen_t>(n))) {
+        std::snprintf(out, n, "?");
+    }
+}
+
+void format_endpoint(const FlowEntry& e, const bool src, char* out, const std::size_t n) {
+    const IpAddr&       ip   = (src == e.a_is_src) ? e.key.a : e.key.b;
+    const std::uint16_t port = (src == e.a_is_src) ? e.key.port_a : e.key.port_b;
+    char addr[INET6_ADDRSTRLEN];
+    format_addr(e.key.family, ip, addr, sizeof(addr));
+    const bool ports = e.key.proto == Proto::kTcp || e.key.proto == Proto::kUdp;
+    if (ports && e.key.family == AF_INET6) std::snprintf(out, n, "[%s]:%u", addr, port);
+    else if (ports)                        std::snprintf(out, n, "%s:%u", addr, port);
+    else                                   std::snprintf(out, n, "%s", addr);
 }
 
 [[nodiscard]] std::string human_bytes(std::size_t b) {
@@ -33,17 +69,38 @@ using namespace std::chrono;
     return os.str();
 }
 
-void hex_line(WINDOW* w, const int y, const std::uint8_t* d, const std::size_t len, const std::size_t off) {
-    mvwprintw(w, y, 1, "%04zx  ", off);
-    attr_t save; short pair; wattr_get(w, &save, &pair, nullptr);
-
-    for (int i = 0; i < 16; ++i) {
-        wprintw(w, i < static_cast<int>(len) ? "%02x " : "   ", i < static_cast<int>(len) ? d[i] : 0);
+std::string human_count(double v) {
+    constexpr const char* units[]{"", "k", "M", "G", "T"};
+    std::size_t idx = 0;
+    while (v >= 1000.0 && idx < std::size(units) - 1) {
+        v /= 1000.0;
+        ++idx;
     }
-    wprintw(w, " ");
-    for (int i = 0; i < 16; ++i) {
-        wprintw(w,
-                i < static_cast<int>(len) ? (std::isprint(d[i]) ? "%c" : ".") : " ",
-                d[i]);
+    char out[32];
+    std::snprintf(out, sizeof(out), idx ? "%.1f%s" : "%.0f%s", v, units[idx]);
+    return out;
+}
+
+std::string human_ns(const std::uint64_t ns) {
+    char out[32];
+    if (ns < 1'000)               std::snprintf(out, sizeof(out), "%lluns", static_cast<unsigned long long>(ns));
+    else if (ns < 1'000'000)      std::snprintf(out, sizeof(out), "%.1fus", static_cast<double>(ns) / 1e3);
+    else if (ns < 1'000'000'000)  std::snprintf(out, sizeof(out), "%.1fms", static_cast<double>(ns) / 1e6);
+    else                          std::snprintf(out, sizeof(out), "%.1fs",  static_cast<double>(ns) / 1e9);
+    return out;
+}
+
+// Formats the whole line into one buffer so each line is a single curses call.
+void hex_line(WINDOW* w, const int y, const std::uint8_t* d, const std::size_t len, const std::size_t off) {
+    static constexpr char digits[] = "0123456789abcdef";
+    char line[96];      // offset, 16 * "xx ", gap, 16 chars
+    int  n = std::snprintf(line, 24, "%04zx  ", off);
+    for (std::size_t i = 0; i < 16; ++i) {
+        line[n++] = i < len ? digits[d[i] >> 4]  : ' ';
+        line[n++] = i < len ? digits[d[i] & 0xF] : ' ';
+        line[n++] = ' ';
     }
+    line[n++] = ' ';
+    for (std::size_t i = 0; i < 16; ++i) line[n++] = i < len ? (std::isprint(d[i]) ? static_cast<char>(d[i]) : '.') : ' ';
+    mvwaddnstr(w, y, 1, line, n);
 }